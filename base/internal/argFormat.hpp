@@ -0,0 +1,112 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_ARG_FORMAT__
+#define __YUFC_ARG_FORMAT__
+
+#include "logStream.hpp"
+#include "util.hpp"
+#include <sstream>
+#include <stdlib.h>
+#include <string>
+#include <type_traits>
+
+namespace ffengc_log {
+// {} 风格的格式化
+// 格式化字符串用 LOG_FMT("x={} y={}") 包装，占位符的数量在编译期计算，和参数数量不一致时编译失败
+// 只支持 {}，{{ 和 }} 表示字面的花括号
+namespace fmtDetail {
+    static const size_t FMT_INVALID = (size_t)-1;
+    constexpr size_t countArgs(const char* s, size_t n) {
+        return *s == '\0'                       ? n
+            : (*s == '{' && s[1] == '{')        ? countArgs(s + 2, n)
+            : (*s == '}' && s[1] == '}')        ? countArgs(s + 2, n)
+            : (*s == '{' && s[1] == '}')        ? countArgs(s + 2, n + 1)
+            : (*s == '{' || *s == '}')          ? FMT_INVALID
+                                                : countArgs(s + 1, n);
+    } // 返回占位符数量，花括号不成对时返回 FMT_INVALID
+} // namespace fmtDetail
+template <size_t N>
+class fmtString {
+private:
+    const char* __str; //
+public:
+    explicit constexpr fmtString(const char* str)
+        : __str(str) { }
+    const char* str() const { return __str; }
+};
+#define LOG_FMT(str) ffengc_log::fmtString<ffengc_log::fmtDetail::countArgs(str, 0)>(str)
+
+namespace fmtDetail {
+    // 把下一个占位符之前的字面文本写入 out，返回占位符之后的位置（没有占位符时返回末尾）
+    inline const char* appendLiteral(logStream& out, const char* fmt) {
+        const char* p = fmt;
+        while (true) {
+            if (*p == '\0') {
+                out.append(fmt, p - fmt);
+                return p;
+            }
+            if (*p == '{' || *p == '}') {
+                out.append(fmt, p - fmt);
+                if (p[0] == '{' && p[1] == '}')
+                    return p + 2;
+                out.append(*p); // {{ 或 }}
+                p += 2;
+                fmt = p;
+                continue;
+            }
+            ++p;
+        }
+    }
+    inline void appendValue(logStream& out, const char* s) { out.append(s ? s : "(null)"); }
+    inline void appendValue(logStream& out, char* s) { appendValue(out, (const char*)s); }
+    inline void appendValue(logStream& out, const std::string& s) { out.append(s.data(), s.size()); }
+    inline void appendValue(logStream& out, const util::strView& s) { out.append(s); }
+    inline void appendValue(logStream& out, bool v) { out.append(v ? "true" : "false"); }
+    inline void appendValue(logStream& out, char c) { out.append(c); }
+    inline void appendValue(logStream& out, double v) {
+        // 先用15位有效数字，转回去和原值不一致时再用17位，得到能还原原值的较短表示
+        char* p = out.reserve(32);
+        int n = snprintf(p, 32, "%.15g", v);
+        if (n > 0 && strtod(p, nullptr) != v && v == v)
+            n = snprintf(p, 32, "%.17g", v);
+        out.commit(n > 0 ? n : 0);
+    }
+    inline void appendValue(logStream& out, float v) { appendValue(out, (double)v); }
+    inline void appendValue(logStream& out, long double v) { out.appendf("%Lg", v); }
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    appendValue(logStream& out, T v) {
+        if (v < 0) {
+            out.append('-');
+            out.appendUnsigned(0ULL - (unsigned long long)v);
+        } else
+            out.appendUnsigned(v);
+    }
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    appendValue(logStream& out, T v) { out.appendUnsigned(v); }
+    template <typename T>
+    void appendValue(logStream& out, const T* p) { out.appendf("%p", (const void*)p); }
+    template <typename T>
+    typename std::enable_if<!std::is_arithmetic<T>::value && !std::is_pointer<T>::value>::type
+    appendValue(logStream& out, const T& v) {
+        std::ostringstream oss;
+        oss << v;
+        std::string str = oss.str();
+        out.append(str.data(), str.size());
+    } // 其他类型通过 operator<< 输出，会有堆内存分配
+    inline void formatTo(logStream& out, const char* fmt) { appendLiteral(out, fmt); }
+    template <typename T, typename... Rest>
+    void formatTo(logStream& out, const char* fmt, const T& v, const Rest&... rest) {
+        fmt = appendLiteral(out, fmt);
+        appendValue(out, v);
+        formatTo(out, fmt, rest...);
+    }
+} // namespace fmtDetail
+} // namespace ffengc_log
+
+#endif
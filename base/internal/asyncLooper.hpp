@@ -8,20 +8,57 @@
 #define __YUFC_ASYNC_LOOPER__
 
 #include "buffer.hpp"
+#include "bufferPool.hpp"
+#include "metrics.hpp"
+#include "ringBuffer.hpp"
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 namespace ffengc_log {
 using functor = std::function<void(buffer&)>;
+using batchFunctor = std::function<void(std::vector<buffer*>&)>; // 一次处理消费者本轮取到的所有缓冲块
 enum class asyncType {
     ASYNC_SAFE, // 安全状态，表示哈UN冲功能区满了则阻塞，避免资源耗尽的风险
-    ASYNC_UNSAFE, // 不考虑资源耗尽，用于压力测试
+    ASYNC_UNSAFE, // 不考虑资源耗尽，用于压力测试（设置了内存上限时同样会阻塞）
+    ASYNC_LOCKFREE, // 每个生产线程独占一个SPSC环形缓冲区，push路径上没有共享锁，环满了则自旋等待
+};
+// 缓冲区达到内存上限（ASYNC_LOCKFREE 模式下为本线程的环满了）时生产者的处理方式
+enum class overflowPolicy {
+    BLOCK, // 阻塞等待，默认
+    DROP_NEWEST, // 丢弃正在写的这条日志
+    DROP_OLDEST, // 丢弃最早的还没被取走的一块缓冲区，腾出空间（ASYNC_LOCKFREE 模式下同 DROP_NEWEST）
+    DROP_BELOW_LEVEL, // 低于 __keep_level 的日志丢弃，其他的阻塞等待
+    SPIN_THEN_BLOCK, // 先让出CPU自旋一段时间，还没有空间再阻塞
+};
+#define DEFAULT_OVERFLOW_SPIN 1000
+#define DEFAULT_DROP_REPORT_MS 1000
+struct overflowConfig {
+    overflowPolicy __policy = overflowPolicy::BLOCK;
+    logLevel::value __keep_level = logLevel::value::ERROR; // DROP_BELOW_LEVEL 使用
+    size_t __spin = DEFAULT_OVERFLOW_SPIN; // SPIN_THEN_BLOCK 使用，阻塞之前最多自旋的次数
+    size_t __report_ms = DEFAULT_DROP_REPORT_MS; // 有日志被丢弃时，最多每隔这么久输出一条统计日志，0表示不输出
+};
+class asyncLooper;
+// 多个 looper 共用的异步线程（见 looperPool.hpp），looper 有数据时通知它来处理
+class looperScheduler {
+public:
+    using ptr = std::shared_ptr<looperScheduler>;
+    virtual ~looperScheduler() { }
+    virtual void attach(asyncLooper* looper) = 0;
+    virtual void detach(asyncLooper* looper) = 0; // 返回之后不会再有线程处理这个 looper
+    virtual void schedule(asyncLooper* looper) = 0;
+    virtual chunkCache::ptr chunks() { return nullptr; } // 共用的空闲缓冲块，为空时每个 looper 自己保留
 };
 class asyncLooper {
+    friend class looperPool;
 private:
     asyncType __looper_type;
     std::thread __work_thread; // 异步工作器对应的线程 不要取名为 __thread, __thread 是那个用来指定字段每个线程独占的那个关键字
@@ -29,55 +66,597 @@ private:
     std::mutex __mtx;
     std::condition_variable __producer_condition;
     std::condition_variable __consumer_condition;
-    buffer __producer_buffer; // 生产者缓冲区
-    buffer __consumer_buffer; // 消费者缓冲区
+    // ASYNC_SAFE/ASYNC_UNSAFE 模式使用
+    bufferPool __pool; // 固定大小的缓冲块，受 __mtx 保护
+    buffer* __producer_buffer; // 生产者正在写的缓冲块，为空时下次写入再从池中取
+    std::deque<buffer*> __full_buffers; // 已经写满、等待消费者处理的缓冲块
+    std::deque<size_t> __full_records; // __full_buffers 中每一块的日志条数，丢弃时用来计数
+    size_t __producer_records; // __producer_buffer 中的日志条数
+    // ASYNC_LOCKFREE 模式使用
+    buffer __consumer_buffer; // 消费者缓冲区，使用共享线程池时用工作线程自己的，这个不分配
+    buffer __overflow_buffer; // 超过环容量的日志
+    size_t __looper_id; // 全局唯一，线程本地缓存用它来找到自己的环形缓冲区
+    size_t __ring_size;
+    std::mutex __ring_mtx; // 只在线程第一次写入时注册环形缓冲区，以及消费者回收环形缓冲区时使用
+    std::vector<ringBuffer::ptr> __rings;
+    std::atomic<bool> __consumer_sleeping; // 消费者准备睡眠，生产者看到它才去加锁唤醒
+    bool __wakeup_pending; // 受 __mtx 保护
+    std::atomic<size_t> __overflow_pending; // 超过环容量的日志走 __overflow_buffer，记录还没被消费的条数
+    bool __track_records;
+    overflowConfig __overflow;
+    std::atomic<size_t> __dropped; // 被丢弃的日志条数
+    // 运行时统计，消费者的计数只由异步线程修改
+    std::atomic<uint64_t> __batches;
+    std::atomic<uint64_t> __buffers_done;
+    std::atomic<uint64_t> __bytes_done;
+    std::atomic<uint64_t> __callback_ns;
+    std::atomic<uint64_t> __callback_max_ns;
+    std::atomic<uint64_t> __producer_waits;
+    std::atomic<uint64_t> __producer_wait_ns;
+    // 空闲时定期调用，日志器用它按时间刷新 sink
+    std::function<void()> __idle;
+    size_t __idle_ms;
+    // 使用共享线程池时，没有自己的线程，以下成员由线程池使用
+    looperScheduler::ptr __scheduler;
+    enum schedState {
+        STATE_IDLE, // 没有待处理的数据
+        STATE_QUEUED, // 在线程池的就绪队列中
+        STATE_RUNNING, // 某个工作线程正在处理
+        STATE_RUNNING_NOTIFIED, // 处理期间又有了新数据，处理完重新排队
+    };
+    std::atomic<int> __sched_state;
+    std::atomic<bool> __tick_pending; // 到了定期检查的时间，下次处理时先执行一次 idleTick
+    bool __attached; // 以下成员受线程池的锁保护
+    int64_t __next_tick_ns;
+    std::vector<buffer*> __shared_batch; // 只在处理这个 looper 的工作线程中使用
+    std::vector<buffer*> __lent; // 只在调用回调的线程中使用，本轮借出去的块，不在本轮结束时回收
+    std::vector<int> __worker_cpus; // 不为空时异步线程只在这些CPU上运行
+    bool __node_local; // ASYNC_LOCKFREE 模式下生产者的环形缓冲区分配在生产者所在的NUMA节点
 public:
     using ptr = std::shared_ptr<asyncLooper>;
-    asyncLooper(const functor& callback, const asyncType& looper_type = asyncType::ASYNC_SAFE)
+    asyncLooper(const functor& callback,
+        const asyncType& looper_type = asyncType::ASYNC_SAFE,
+        size_t ring_size = DEFAULT_RING_SIZE,
+        const bufferPoolConfig& pool_config = bufferPoolConfig(),
+        bool track_records = false,
+        const overflowConfig& overflow = overflowConfig(),
+        const std::function<void()>& idle = nullptr,
+        size_t idle_ms = 0,
+        const looperScheduler::ptr& scheduler = nullptr,
+        const std::vector<int>& worker_cpus = std::vector<int>())
+        : asyncLooper(batchFunctor([callback](std::vector<buffer*>& buffers) {
+            for (auto e : buffers)
+                callback(*e);
+        }),
+            looper_type, ring_size, pool_config, track_records, overflow, idle, idle_ms, scheduler, worker_cpus) { }
+    asyncLooper(const batchFunctor& callback,
+        const asyncType& looper_type = asyncType::ASYNC_SAFE,
+        size_t ring_size = DEFAULT_RING_SIZE,
+        const bufferPoolConfig& pool_config = bufferPoolConfig(),
+        bool track_records = false, // 为每条日志记录位置和元数据，交给回调的缓冲块中 __records 有效
+        const overflowConfig& overflow = overflowConfig(),
+        const std::function<void()>& idle = nullptr, // 没有数据时至少每 idle_ms 毫秒在异步线程中调用一次
+        size_t idle_ms = 0,
+        const looperScheduler::ptr& scheduler = nullptr, // 不为空时不创建自己的线程，由共享的线程池处理
+        const std::vector<int>& worker_cpus = std::vector<int>()) // 使用共享线程池时由线程池的配置决定
         : __stop_signal(false)
         , __looper_type(looper_type)
-        , __callBack(callback)
-        , __work_thread(std::thread(&asyncLooper::threadEntry, this)) { }
+        , __pool(pool_config.__chunk_size, defaultMaxBytes(looper_type, pool_config), pool_config.__idle_ms, scheduler ? scheduler->chunks() : nullptr)
+        , __producer_buffer(nullptr)
+        , __producer_records(0)
+        , __consumer_buffer(0) // ASYNC_LOCKFREE 模式在异步线程中分配，见 threadEntry
+        , __overflow_buffer(0)
+        , __looper_id(nextLooperId())
+        , __ring_size(ring_size)
+        , __consumer_sleeping(false)
+        , __wakeup_pending(false)
+        , __overflow_pending(0)
+        , __track_records(track_records)
+        , __overflow(overflow)
+        , __dropped(0)
+        , __batches(0)
+        , __buffers_done(0)
+        , __bytes_done(0)
+        , __callback_ns(0)
+        , __callback_max_ns(0)
+        , __producer_waits(0)
+        , __producer_wait_ns(0)
+        , __idle(idle)
+        , __idle_ms(idle ? idle_ms : 0)
+        , __scheduler(scheduler)
+        , __sched_state(STATE_IDLE)
+        , __tick_pending(false)
+        , __attached(false)
+        , __next_tick_ns(0)
+        , __worker_cpus(worker_cpus)
+        , __node_local(pool_config.__node_local && util::Numa::nodeCount() > 1)
+        , __callBack(callback) {
+        // 线程必须在所有成员初始化完成之后再启动
+        if (__scheduler)
+            __scheduler->attach(this);
+        else
+            __work_thread = std::thread(&asyncLooper::threadEntry, this);
+    }
     ~asyncLooper() {
         stop();
+        if (__producer_buffer)
+            __pool.release(__producer_buffer);
     }
     void stop() {
-        __stop_signal = true;
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            __stop_signal = true;
+        }
         __consumer_condition.notify_all();
-        __work_thread.join();
-    }
+        if (__work_thread.joinable())
+            __work_thread.join();
+        if (__scheduler) {
+            // 等线程池放手之后，在当前线程中把剩下的数据处理完
+            __scheduler->detach(this);
+            buffer scratch(0);
+            while (runOnce(scratch))
+                ;
+        }
+    } // 环形缓冲区在looper析构时释放，线程本地缓存只持有弱引用
     void push(const char* data, size_t len) {
-        // 1. 无限扩容（非安全，用于压力测试）
-        // 2. 固定大小 满了之后需要阻塞
+        push(data, len, logLevel::value::UNKNOW, 0);
+    }
+    void push(const char* data, size_t len, logLevel::value level, int64_t time_ns) {
+        if (__looper_type == asyncType::ASYNC_LOCKFREE) {
+            pushLockFree(data, len, level, time_ns);
+            return;
+        }
+        // 当前块写满了就换一块新的，达到内存上限时按 __overflow 处理
+        std::unique_lock<std::mutex> lock(__mtx);
+        size_t spin = 0;
+        int64_t wait_start = 0; // 开始等待的时间，0表示没有等待
+        while (true) {
+            if (__producer_buffer != nullptr) {
+                if (__producer_buffer->writeableSize() >= len || __producer_buffer->empty())
+                    break; // 超过块大小的日志单独放在一个空块中，让它自己扩容
+                __full_buffers.push_back(__producer_buffer);
+                __full_records.push_back(__producer_records);
+                __producer_buffer = nullptr;
+                __producer_records = 0;
+                notifyConsumer();
+            }
+            __producer_buffer = __pool.acquire();
+            if (__producer_buffer != nullptr)
+                continue;
+            if (wait_start == 0)
+                wait_start = util::Date::monotonicNs();
+            switch (overflowAction(level, spin)) {
+            case overflowPolicy::DROP_NEWEST:
+                __dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            case overflowPolicy::DROP_OLDEST:
+                if (dropOldest())
+                    continue;
+                __dropped.fetch_add(1, std::memory_order_relaxed); // 所有块都在消费者手里，只能丢弃这一条
+                return;
+            case overflowPolicy::SPIN_THEN_BLOCK:
+                lock.unlock();
+                std::this_thread::yield();
+                lock.lock();
+                continue;
+            default:
+                __producer_condition.wait(lock, [&]() { return __pool.available(); });
+            }
+        }
+        if (__track_records)
+            __producer_buffer->pushRecord(data, len, level, time_ns);
+        else
+            __producer_buffer->push(data, len);
+        __producer_records++;
+        notifyConsumer(); // 唤醒消费者
+        if (wait_start != 0)
+            producerWaited(wait_start);
+    }
+    // 在回调中调用：把本轮的一个块借给其他线程，最后一个引用释放时还给内存池，借出的块仍然计入内存上限
+    // ASYNC_LOCKFREE 模式交给回调的是消费缓冲区，不属于内存池，返回 nullptr
+    // 借出的块必须在 looper 析构之前全部还回来
+    std::shared_ptr<buffer> lend(buffer* buf) {
+        if (__looper_type == asyncType::ASYNC_LOCKFREE)
+            return nullptr;
+        __lent.push_back(buf);
+        return std::shared_ptr<buffer>(buf, [this](buffer* b) { giveBack(b); });
+    }
+    size_t droppedCount() const { return __dropped.load(std::memory_order_relaxed); } // 因为缓冲区满了而被丢弃的日志条数
+    looperMetrics metrics() {
+        looperMetrics m;
+        m.__batches = __batches.load(std::memory_order_relaxed);
+        m.__buffers = __buffers_done.load(std::memory_order_relaxed);
+        m.__bytes = __bytes_done.load(std::memory_order_relaxed);
+        m.__callback_ns = __callback_ns.load(std::memory_order_relaxed);
+        m.__callback_max_ns = __callback_max_ns.load(std::memory_order_relaxed);
+        m.__producer_waits = __producer_waits.load(std::memory_order_relaxed);
+        m.__producer_wait_ns = __producer_wait_ns.load(std::memory_order_relaxed);
+        m.__dropped = droppedCount();
+        if (__looper_type == asyncType::ASYNC_LOCKFREE) {
+            {
+                std::unique_lock<std::mutex> lock(__ring_mtx);
+                for (const auto& e : __rings)
+                    m.__pending_bytes += e->size();
+                m.__allocated_bytes = __rings.size() * __ring_size;
+            }
+            std::unique_lock<std::mutex> lock(__mtx);
+            m.__pending_bytes += __overflow_buffer.readableSize();
+        } else {
+            std::unique_lock<std::mutex> lock(__mtx);
+            for (auto e : __full_buffers)
+                m.__pending_bytes += e->readableSize();
+            if (__producer_buffer != nullptr)
+                m.__pending_bytes += __producer_buffer->readableSize();
+            m.__allocated_bytes = __pool.allocatedBytes();
+        }
+        return m;
+    } // 读取时汇总，不影响写日志的路径
+    size_t allocatedBytes() {
         std::unique_lock<std::mutex> lock(__mtx);
-        if (__looper_type == asyncType::ASYNC_SAFE)
-            __producer_condition.wait(lock, [&]() { return __producer_buffer.writeableSize() >= len; });
-        __producer_buffer.push(data, len);
-        __consumer_condition.notify_one(); // 唤醒消费者
-    } //
+        return __pool.allocatedBytes();
+    } // 缓冲块占用的内存
 private:
+    static size_t defaultMaxBytes(asyncType looper_type, const bufferPoolConfig& config) {
+        if (config.__max_bytes > 0 || looper_type != asyncType::ASYNC_SAFE)
+            return config.__max_bytes;
+        return config.__chunk_size * 2; // 和原来的双缓冲区一样
+    }
+    // 没有空间时这条日志应该怎么处理，返回 BLOCK 表示阻塞等待
+    overflowPolicy overflowAction(logLevel::value level, size_t& spin) {
+        switch (__overflow.__policy) {
+        case overflowPolicy::DROP_BELOW_LEVEL:
+            return level < __overflow.__keep_level ? overflowPolicy::DROP_NEWEST : overflowPolicy::BLOCK;
+        case overflowPolicy::SPIN_THEN_BLOCK:
+            return spin++ < __overflow.__spin ? overflowPolicy::SPIN_THEN_BLOCK : overflowPolicy::BLOCK;
+        default:
+            return __overflow.__policy;
+        }
+    }
+    bool dropOldest() {
+        // 丢弃最早写满的块，直接拿来给生产者用；没有写满的块时清空生产者正在写的块
+        if (!__full_buffers.empty()) {
+            __producer_buffer = __full_buffers.front();
+            __dropped.fetch_add(__full_records.front(), std::memory_order_relaxed);
+            __full_buffers.pop_front();
+            __full_records.pop_front();
+            __producer_buffer->reset();
+            return true;
+        }
+        return false;
+    } // 调用时持有 __mtx
+    void notifyConsumer() {
+        if (!__scheduler)
+            __consumer_condition.notify_one();
+        else if (markPending())
+            __scheduler->schedule(this);
+    } // ASYNC_SAFE/ASYNC_UNSAFE 模式，调用时持有 __mtx
+    // 标记有待处理的数据，返回 true 表示需要放入线程池的就绪队列
+    // 正在被处理时只做标记，处理完之后由工作线程重新排队，保证同一时刻只有一个线程处理这个 looper
+    bool markPending() {
+        int state = __sched_state.load(std::memory_order_seq_cst);
+        while (state == STATE_IDLE || state == STATE_RUNNING) {
+            int next = state == STATE_IDLE ? STATE_QUEUED : STATE_RUNNING_NOTIFIED;
+            if (__sched_state.compare_exchange_weak(state, next, std::memory_order_seq_cst))
+                return next == STATE_QUEUED;
+        }
+        return false;
+    }
+    // 工作线程处理完一轮，返回 true 表示可以回到空闲状态，否则需要重新排队
+    bool finishRun(bool more) {
+        int state = STATE_RUNNING;
+        if (!more && __sched_state.compare_exchange_strong(state, STATE_IDLE, std::memory_order_seq_cst))
+            return true;
+        __sched_state.store(STATE_QUEUED, std::memory_order_seq_cst);
+        return false;
+    }
+    void idleTick() {
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            __pool.trim(); // 长时间没有日志，释放空闲的块
+        }
+        if (__idle_ms > 0)
+            __idle();
+    }
+    // 使用共享线程池时处理一轮数据，不阻塞，返回这一轮是否处理了数据
+    // scratch 是调用线程自己的消费缓冲区，ASYNC_LOCKFREE 模式把环形缓冲区中的数据搬到这里
+    bool runOnce(buffer& scratch) {
+        if (__tick_pending.exchange(false))
+            idleTick();
+        if (__looper_type == asyncType::ASYNC_LOCKFREE) {
+            if (!drainRings(scratch))
+                return false;
+            __shared_batch.assign(1, &scratch);
+            runCallback(__shared_batch);
+            scratch.reset();
+            return true;
+        }
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            takeBuffers(__shared_batch);
+        }
+        if (__shared_batch.empty())
+            return false;
+        runCallback(__shared_batch);
+        releaseBuffers(__shared_batch);
+        return true;
+    }
+    // 取走所有写满的块，以及生产者正在写的块，调用时持有 __mtx
+    void takeBuffers(std::vector<buffer*>& buffers) {
+        buffers.assign(__full_buffers.begin(), __full_buffers.end());
+        __full_buffers.clear();
+        __full_records.clear();
+        if (__producer_buffer && !__producer_buffer->empty()) {
+            buffers.push_back(__producer_buffer);
+            __producer_buffer = nullptr; // 生产者下次写入时再取新的块
+            __producer_records = 0;
+        }
+    }
+    // 把块还给内存池，唤醒生产者；借出去的块由 giveBack 归还
+    void releaseBuffers(std::vector<buffer*>& buffers) {
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            for (auto e : buffers)
+                if (std::find(__lent.begin(), __lent.end(), e) == __lent.end())
+                    __pool.release(e);
+            __pool.trim();
+        }
+        __lent.clear();
+        __producer_condition.notify_all();
+    }
+    void giveBack(buffer* buf) {
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            __pool.release(buf);
+        }
+        __producer_condition.notify_all();
+    } // 借出去的块的最后一个引用释放，可能在其他线程中调用
+    void producerWaited(int64_t wait_start) {
+        __producer_waits.fetch_add(1, std::memory_order_relaxed);
+        __producer_wait_ns.fetch_add(util::Date::monotonicNs() - wait_start, std::memory_order_relaxed);
+    }
+    void runCallback(std::vector<buffer*>& buffers) {
+        uint64_t bytes = 0;
+        for (auto e : buffers)
+            bytes += e->readableSize();
+        int64_t start = util::Date::monotonicNs();
+        __callBack(buffers);
+        uint64_t cost = util::Date::monotonicNs() - start;
+        __batches.fetch_add(1, std::memory_order_relaxed);
+        __buffers_done.fetch_add(buffers.size(), std::memory_order_relaxed);
+        __bytes_done.fetch_add(bytes, std::memory_order_relaxed);
+        __callback_ns.fetch_add(cost, std::memory_order_relaxed);
+        updateMax(__callback_max_ns, cost);
+    } // 调用回调并统计
+    std::chrono::milliseconds waitTimeout() {
+        std::chrono::milliseconds trim = __pool.idleTimeout();
+        if (__idle_ms > 0 && (trim.count() == 0 || std::chrono::milliseconds(__idle_ms) < trim))
+            return std::chrono::milliseconds(__idle_ms);
+        return trim;
+    } // 消费者没有数据时每次最多等待多久，0表示没有需要定期做的事，一直等到有数据
+    static size_t nextLooperId() {
+        static std::atomic<size_t> id(0);
+        return ++id; // 从1开始，0表示线程本地缓存为空
+    }
+    struct ringCache {
+        size_t __last_id = 0;
+        ringBuffer* __last_ring = nullptr;
+        std::vector<std::pair<size_t, std::weak_ptr<ringBuffer>>> __rings; // 环形缓冲区由looper持有，looper析构时立即释放
+        ~ringCache() {
+            for (auto& e : __rings) {
+                ringBuffer::ptr ring = e.second.lock();
+                if (ring)
+                    ring->close(); // 线程退出，消费者取完数据后会回收
+            }
+        }
+    };
+    ringBuffer* localRing() {
+        static thread_local ringCache cache;
+        if (cache.__last_id == __looper_id)
+            return cache.__last_ring;
+        ringBuffer::ptr ring;
+        for (size_t i = 0; i < cache.__rings.size();) {
+            if (cache.__rings[i].second.expired()) {
+                // 对应的looper已经析构
+                cache.__rings.erase(cache.__rings.begin() + i);
+                continue;
+            }
+            if (cache.__rings[i].first == __looper_id)
+                ring = cache.__rings[i].second.lock();
+            ++i;
+        }
+        if (ring == nullptr) {
+            // 本线程第一次向这个looper写日志
+            ring = std::make_shared<ringBuffer>(__ring_size, __node_local ? util::Numa::currentNode() : -1);
+            {
+                std::unique_lock<std::mutex> lock(__ring_mtx);
+                __rings.push_back(ring);
+            }
+            cache.__rings.push_back({ __looper_id, ring });
+        }
+        cache.__last_id = __looper_id;
+        cache.__last_ring = ring.get();
+        return ring.get();
+    }
+    void wakeConsumer() {
+        // 生产者先发布数据再读睡眠标志，消费者先设置睡眠标志再检查数据，两边都需要全序屏障
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (__scheduler) {
+            if (markPending())
+                __scheduler->schedule(this);
+            return;
+        }
+        if (__consumer_sleeping.load(std::memory_order_relaxed) == false)
+            return;
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            __wakeup_pending = true;
+        }
+        __consumer_condition.notify_one();
+    }
+    // 记录元数据时，环中每条日志前面带一个帧头，消费者取出后再去掉
+    struct frameHeader {
+        uint64_t __size;
+        int64_t __time_ns;
+        int64_t __level;
+    };
+    void pushLockFree(const char* data, size_t len, logLevel::value level, int64_t time_ns) {
+        ringBuffer* ring = localRing();
+        frameHeader hdr = { len, time_ns, (int64_t)level };
+        size_t hdr_len = __track_records ? sizeof(hdr) : 0;
+        if (len + hdr_len > ring->capacity()) {
+            // 超大的日志：等本线程环中的数据被取走，再走加锁的缓冲区，并等它也被取走，保证本线程日志的顺序
+            while (!ring->empty()) {
+                wakeConsumer();
+                std::this_thread::yield();
+            }
+            {
+                std::unique_lock<std::mutex> lock(__mtx);
+                __overflow_buffer.push((const char*)&hdr, hdr_len);
+                __overflow_buffer.push(data, len);
+                __overflow_pending++;
+            }
+            while (__overflow_pending > 0) {
+                wakeConsumer();
+                std::this_thread::yield();
+            }
+            return;
+        }
+        size_t spin = 0;
+        int64_t wait_start = 0;
+        while (!ring->push((const char*)&hdr, hdr_len, data, len)) {
+            // 环满了，等消费者取走；环形缓冲区只能由消费者取数据，DROP_OLDEST 只能丢弃这一条
+            wakeConsumer();
+            overflowPolicy action = overflowAction(level, spin);
+            if (action == overflowPolicy::DROP_NEWEST || action == overflowPolicy::DROP_OLDEST) {
+                __dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            if (wait_start == 0)
+                wait_start = util::Date::monotonicNs();
+            std::this_thread::yield();
+        }
+        wakeConsumer();
+        if (wait_start != 0)
+            producerWaited(wait_start);
+    }
+    static void unframe(buffer& buf) {
+        // 去掉帧头，把日志向前紧凑排列，同时生成元数据
+        char* base = &buf.__buffer[buf.__read_idx];
+        size_t total = buf.readableSize(), r = 0, w = 0;
+        frameHeader hdr;
+        while (r + sizeof(hdr) <= total) {
+            memcpy(&hdr, base + r, sizeof(hdr));
+            r += sizeof(hdr);
+            memmove(base + w, base + r, hdr.__size);
+            buf.__records.push_back({ w, (size_t)hdr.__size, (logLevel::value)hdr.__level, hdr.__time_ns });
+            w += hdr.__size;
+            r += hdr.__size;
+        }
+        buf.__write_idx = buf.__read_idx + w;
+    }
+    bool drainRings(buffer& out) {
+        bool has_data = false;
+        if (__overflow_pending > 0) {
+            std::unique_lock<std::mutex> lock(__mtx);
+            out.push(__overflow_buffer.begin(), __overflow_buffer.readableSize());
+            __overflow_buffer.shrink(0); // 超大日志很少见，不保留它的内存
+            __overflow_pending = 0;
+            has_data = true;
+        }
+        std::unique_lock<std::mutex> lock(__ring_mtx);
+        for (size_t i = 0; i < __rings.size();) {
+            bool closed = __rings[i]->closed(); // 先读关闭标志，再取数据，避免漏掉最后一批
+            if (__rings[i]->popTo(out) > 0)
+                has_data = true;
+            else if (closed) {
+                __rings.erase(__rings.begin() + i);
+                continue;
+            }
+            ++i;
+        }
+        if (has_data && __track_records)
+            unframe(out);
+        return has_data;
+    }
+    bool ringsEmpty() {
+        std::unique_lock<std::mutex> lock(__ring_mtx);
+        for (const auto& e : __rings)
+            if (!e->empty())
+                return false;
+        return __overflow_pending == 0;
+    }
+    void lockFreeEntry() {
+        std::vector<buffer*> buffers(1, &__consumer_buffer);
+        while (true) {
+            // 1. 把所有环形缓冲区中的数据搬到消费缓冲区
+            if (drainRings(__consumer_buffer)) {
+                runCallback(buffers);
+                __consumer_buffer.reset();
+                continue;
+            }
+            // 空闲时把被撑大的缓冲区恢复成默认大小
+            __consumer_buffer.shrink(DEFAULT_BUFFER_SIZE);
+            if (__stop_signal)
+                break; // 所有数据都已经落地
+            // 2. 没有数据，准备睡眠
+            std::unique_lock<std::mutex> lock(__mtx);
+            __consumer_sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto wakeup = [&]() { return __stop_signal || __wakeup_pending; };
+            if (ringsEmpty()) {
+                if (__idle_ms > 0)
+                    __consumer_condition.wait_for(lock, std::chrono::milliseconds(__idle_ms), wakeup);
+                else
+                    __consumer_condition.wait(lock, wakeup);
+            }
+            __wakeup_pending = false;
+            __consumer_sleeping.store(false, std::memory_order_relaxed);
+            lock.unlock();
+            if (__idle_ms > 0)
+                __idle();
+        }
+    }
     void threadEntry() {
+        if (!__worker_cpus.empty())
+            util::Numa::setAffinity(pthread_self(), __worker_cpus);
+        if (__looper_type == asyncType::ASYNC_LOCKFREE) {
+            buffer(DEFAULT_BUFFER_SIZE).swap(__consumer_buffer); // 在异步线程中分配并第一次访问，绑定了CPU时内存就在它所在的节点
+            lockFreeEntry();
+            return;
+        }
+        std::vector<buffer*> buffers;
         while (true) {
-            // 1. 判断生产缓冲区是否有数据，有则交换
+            // 1. 取走所有写满的块，以及生产者正在写的块
             {
                 std::unique_lock<std::mutex> lock(__mtx);
-                __consumer_condition.wait(lock, [&]() { return __stop_signal || !__producer_buffer.empty(); });
-                if (__stop_signal && __producer_buffer.empty())
+                auto ready = [&]() { return __stop_signal || !__full_buffers.empty() || (__producer_buffer && !__producer_buffer->empty()); };
+                while (!ready()) {
+                    if (waitTimeout().count() == 0) {
+                        __consumer_condition.wait(lock, ready);
+                        break;
+                    }
+                    if (__consumer_condition.wait_for(lock, waitTimeout(), ready))
+                        break;
+                    __pool.trim(); // 长时间没有日志，释放空闲的块
+                    if (__idle_ms > 0) {
+                        lock.unlock();
+                        __idle();
+                        lock.lock();
+                    }
+                }
+                takeBuffers(buffers);
+                if (__stop_signal && buffers.empty())
                     break; // 如果生产缓冲区还有数据，那就先不要退出
-                __consumer_buffer.swap(__producer_buffer);
-                // 4. 唤醒生产者
-                if (__looper_type == asyncType::ASYNC_SAFE) // 如果是非安全状态，producer不会阻塞
-                    __producer_condition.notify_all();
             }
-            // 2. 被唤醒后，对消费缓冲区进行处理
-            __callBack(__consumer_buffer);
-            // 3. 初始化消费缓冲区
-            __consumer_buffer.reset();
+            // 2. 取到的块一起交给回调，方便 sink 合并成一次写入
+            runCallback(buffers);
+            // 3. 把块还给内存池，唤醒生产者
+            releaseBuffers(buffers);
         }
     } // 线程的入口函数
 private:
-    functor __callBack; // 具体对缓冲区数据进行处理的cb函数
+    batchFunctor __callBack; // 具体对缓冲区数据进行处理的cb函数
 };
 } // namespace ffengc_log
 
-#endif
\ No newline at end of file
+#endif
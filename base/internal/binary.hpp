@@ -0,0 +1,489 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_BINARY__
+#define __YUFC_BINARY__
+
+#include "format.hpp"
+#include "level.hpp"
+#include "logStream.hpp"
+#include "message.hpp"
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <wchar.h>
+
+namespace ffengc_log {
+namespace binary {
+    // printf 格式说明符对应的参数类型
+    enum class argType {
+        NONE, // %% 或者无法识别的说明符，没有参数
+        INT,
+        LONG,
+        LLONG,
+        INTMAX,
+        SIZE,
+        PTRDIFF,
+        DOUBLE,
+        LDOUBLE,
+        STR,
+        WSTR,
+        WINT,
+        PTR,
+        COUNT, // %n，只消耗参数，不输出
+    };
+    struct spec {
+        const char* __begin; // 指向 %
+        const char* __end; // 指向说明符之后
+        int __stars; // 宽度/精度中 * 的个数，每个 * 对应一个 int 参数
+        argType __type;
+    };
+    // 解析 p 处（p 指向 %）的格式说明符
+    inline void parseSpec(const char* p, spec& sp) {
+        sp.__begin = p++;
+        sp.__stars = 0;
+        sp.__type = argType::NONE;
+        if (*p == '%') {
+            sp.__end = p + 1;
+            return;
+        }
+        while (*p && strchr("-+ #0'", *p))
+            ++p; // 标志位
+        for (int i = 0; i < 2; ++i) {
+            // 宽度和精度
+            if (*p == '*')
+                ++sp.__stars, ++p;
+            else
+                while (*p >= '0' && *p <= '9')
+                    ++p;
+            if (i == 0 && *p == '.')
+                ++p;
+            else
+                break;
+        }
+        int lng = 0; // 0: 无, 1: l, 2: ll, 3: j, 4: z, 5: t, 6: L
+        while (*p && strchr("hlLqjzt", *p)) {
+            switch (*p) {
+            case 'l':
+                lng = lng == 1 ? 2 : 1;
+                break;
+            case 'q':
+                lng = 2;
+                break;
+            case 'j':
+                lng = 3;
+                break;
+            case 'z':
+                lng = 4;
+                break;
+            case 't':
+                lng = 5;
+                break;
+            case 'L':
+                lng = 6;
+                break;
+            default:
+                break; // h, hh 会被提升为 int
+            }
+            ++p;
+        }
+        static const argType ints[] = { argType::INT, argType::LONG, argType::LLONG, argType::INTMAX, argType::SIZE, argType::PTRDIFF, argType::LLONG };
+        switch (*p) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            sp.__type = ints[lng];
+            break;
+        case 'c':
+            sp.__type = lng == 1 ? argType::WINT : argType::INT;
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            sp.__type = lng == 6 ? argType::LDOUBLE : argType::DOUBLE;
+            break;
+        case 's':
+            sp.__type = lng == 1 ? argType::WSTR : argType::STR;
+            break;
+        case 'p':
+            sp.__type = argType::PTR;
+            break;
+        case 'n':
+            sp.__type = argType::COUNT;
+            break;
+        default:
+            sp.__end = p; // 无法识别，原样输出
+            sp.__stars = 0;
+            return;
+        }
+        sp.__end = p + 1;
+    }
+    template <typename T>
+    inline void put(logStream& out, const T& value) { out.append((const char*)&value, sizeof(T)); }
+    template <typename T>
+    inline bool get(const char*& p, const char* end, T& value) {
+        if ((size_t)(end - p) < sizeof(T))
+            return false;
+        memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+    // 生产者调用：按照格式化字符串把参数的原始字节写入 out，字符串参数会被拷贝
+    inline void encodeArgs(logStream& out, const char* fmt, va_list ap) {
+        spec sp;
+        for (const char* p = strchr(fmt, '%'); p != nullptr; p = strchr(p, '%')) {
+            parseSpec(p, sp);
+            p = sp.__end;
+            for (int i = 0; i < sp.__stars; ++i)
+                put(out, va_arg(ap, int));
+            switch (sp.__type) {
+            case argType::INT:
+                put(out, va_arg(ap, int));
+                break;
+            case argType::LONG:
+                put(out, va_arg(ap, long));
+                break;
+            case argType::LLONG:
+                put(out, va_arg(ap, long long));
+                break;
+            case argType::INTMAX:
+                put(out, va_arg(ap, intmax_t));
+                break;
+            case argType::SIZE:
+                put(out, va_arg(ap, size_t));
+                break;
+            case argType::PTRDIFF:
+                put(out, va_arg(ap, ptrdiff_t));
+                break;
+            case argType::DOUBLE:
+                put(out, va_arg(ap, double));
+                break;
+            case argType::LDOUBLE:
+                put(out, va_arg(ap, long double));
+                break;
+            case argType::WINT:
+                put(out, va_arg(ap, wint_t));
+                break;
+            case argType::PTR:
+                put(out, va_arg(ap, void*));
+                break;
+            case argType::COUNT:
+                va_arg(ap, void*);
+                break;
+            case argType::STR: {
+                const char* str = va_arg(ap, const char*);
+                if (str == nullptr)
+                    str = "(null)";
+                uint32_t len = strlen(str);
+                put(out, len);
+                out.append(str, len);
+                break;
+            }
+            case argType::WSTR: {
+                const wchar_t* str = va_arg(ap, const wchar_t*);
+                if (str == nullptr)
+                    str = L"(null)";
+                uint32_t len = wcslen(str) * sizeof(wchar_t);
+                put(out, len);
+                out.append((const char*)str, len);
+                break;
+            }
+            default:
+                break;
+            }
+        }
+    }
+    template <typename T>
+    inline void appendSpec(logStream& out, const char* sp, int stars, const int* star_args, T value) {
+        if (stars == 0)
+            out.appendf(sp, value);
+        else if (stars == 1)
+            out.appendf(sp, star_args[0], value);
+        else
+            out.appendf(sp, star_args[0], star_args[1], value);
+    }
+    template <typename T>
+    inline bool decodeOne(logStream& out, const char* sp, int stars, const int* star_args, const char*& args, const char* end) {
+        T value;
+        if (!get(args, end, value))
+            return false;
+        appendSpec(out, sp, stars, star_args, value);
+        return true;
+    }
+    // 消费者调用：按照格式化字符串从 args 中取出参数，逐个说明符格式化到 out 中
+    inline bool decodeArgs(logStream& out, const char* fmt, const char* args, const char* end) {
+        static thread_local std::string str; // 复用容量
+        static thread_local std::wstring wstr;
+        spec sp;
+        char sp_buf[64];
+        const char* p = fmt;
+        while (*p) {
+            const char* next = strchr(p, '%');
+            if (next == nullptr) {
+                out.append(p);
+                break;
+            }
+            out.append(p, next - p);
+            parseSpec(next, sp);
+            p = sp.__end;
+            size_t sp_len = sp.__end - sp.__begin;
+            if (sp.__type == argType::NONE) {
+                if (sp_len == 2 && sp.__begin[1] == '%')
+                    out.append('%');
+                else
+                    out.append(sp.__begin, sp_len);
+                continue;
+            }
+            int star_args[2] = { 0, 0 };
+            for (int i = 0; i < sp.__stars; ++i)
+                if (!get(args, end, star_args[i]))
+                    return false;
+            if (sp_len >= sizeof(sp_buf))
+                return false;
+            memcpy(sp_buf, sp.__begin, sp_len);
+            sp_buf[sp_len] = '\0';
+            bool ok = true;
+            switch (sp.__type) {
+            case argType::INT:
+                ok = decodeOne<int>(out, sp_buf, sp.__stars, star_args, args, end);
+                break;
+            case argType::LONG:
+                ok = decodeOne<long>(out, sp_buf, sp.__stars, star_args, args, end);
+                break;
+            case argType::LLONG:
+                ok = decodeOne<long long>(out, sp_buf, sp.__stars, star_args, args, end);
+                break;
+            case argType::INTMAX:
+                ok = decodeOne<intmax_t>(out, sp_buf, sp.__stars, star_args, args, end);
+                break;
+            case argType::SIZE:
+                ok = decodeOne<size_t>(out, sp_buf, sp.__stars, star_args, args, end);
+                break;
+            case argType::PTRDIFF:
+                ok = decodeOne<ptrdiff_t>(out, sp_buf, sp.__stars, star_args, args, end);
+                break;
+            case argType::DOUBLE:
+                ok = decodeOne<double>(out, sp_buf, sp.__stars, star_args, args, end);
+                break;
+            case argType::LDOUBLE:
+                ok = decodeOne<long double>(out, sp_buf, sp.__stars, star_args, args, end);
+                break;
+            case argType::WINT:
+                ok = decodeOne<wint_t>(out, sp_buf, sp.__stars, star_args, args, end);
+                break;
+            case argType::PTR:
+                ok = decodeOne<void*>(out, sp_buf, sp.__stars, star_args, args, end);
+                break;
+            case argType::STR: {
+                uint32_t len;
+                if (!get(args, end, len) || (size_t)(end - args) < len)
+                    return false;
+                str.assign(args, len);
+                args += len;
+                appendSpec(out, sp_buf, sp.__stars, star_args, str.c_str());
+                break;
+            }
+            case argType::WSTR: {
+                uint32_t len;
+                if (!get(args, end, len) || (size_t)(end - args) < len)
+                    return false;
+                wstr.resize(len / sizeof(wchar_t));
+                memcpy(&wstr[0], args, len);
+                args += len;
+                appendSpec(out, sp_buf, sp.__stars, star_args, wstr.c_str());
+                break;
+            }
+            default:
+                break; // %n
+            }
+            if (!ok)
+                return false;
+        }
+        return true;
+    }
+
+    // 进程内放入异步缓冲区的记录头，后面紧跟参数的原始字节
+    // 格式化字符串和文件名只保存指针，因此必须是字符串常量（通过宏调用时总是满足）
+    struct recordHeader {
+        uint32_t __size; // 整条记录的长度（包含记录头）
+        uint32_t __line;
+        int64_t __time_ns;
+        const char* __fmt;
+        const char* __file;
+        pid_t __tid;
+        uint32_t __name_id; // 只在进程内使用，不写入文件
+        logLevel::value __level;
+    };
+
+    // 二进制日志文件格式
+    // 文件头: "FFLOGBIN" | u32 版本号 | u32 日志器名称长度 | 日志器名称
+    // 调用点: u8 FRAME_SITE | u32 调用点ID | u32 行号 | u32 文件名长度 | 文件名 | u32 格式长度 | 格式
+    // 记录:   u8 FRAME_RECORD | u32 调用点ID | u8 等级 | i64 时间戳(纳秒) | u32 线程ID长度 | 内核线程ID | u32 参数长度 | 参数
+    // 调用点在第一次出现时写入，之后的记录只引用它的ID
+    // 每个文件（滚动文件的每个分段）以文件头开始；追加写入已有的文件时中间会再出现文件头，之后的调用点ID重新从0开始
+    static const char FILE_MAGIC[] = "FFLOGBIN";
+    static const uint32_t FILE_VERSION = 2; // 2: 线程ID为4字节的内核线程ID
+    enum frameType : uint8_t {
+        FRAME_SITE = 1,
+        FRAME_RECORD = 2,
+    };
+    inline void putString(logStream& out, const char* data, uint32_t len) {
+        put(out, len);
+        out.append(data, len);
+    }
+    // 把进程内的记录转换成文件格式，由异步线程调用
+    class encoder {
+    private:
+        struct siteKey {
+            const char* __fmt;
+            const char* __file;
+            uint32_t __line;
+            bool operator==(const siteKey& o) const { return __fmt == o.__fmt && __file == o.__file && __line == o.__line; }
+        };
+        struct siteHash {
+            size_t operator()(const siteKey& k) const {
+                return std::hash<const void*>()(k.__fmt) ^ (std::hash<const void*>()(k.__file) << 1) ^ k.__line;
+            }
+        };
+        std::unordered_map<siteKey, uint32_t, siteHash> __sites;
+        std::string __logger_name;
+        bool __header_written; //
+    public:
+        encoder(const std::string& logger_name)
+            : __logger_name(logger_name)
+            , __header_written(false) { }
+        void reset() {
+            __sites.clear();
+            __header_written = false;
+        } // 接下来的数据写到一个新文件的开头，重新写文件头和调用点
+        void encode(logStream& out, const recordHeader& hdr, const char* args, size_t args_len) {
+            if (!__header_written) {
+                out.append(FILE_MAGIC, 8);
+                put(out, FILE_VERSION);
+                putString(out, __logger_name.c_str(), __logger_name.size());
+                __header_written = true;
+            }
+            siteKey key = { hdr.__fmt, hdr.__file, hdr.__line };
+            auto it = __sites.find(key);
+            if (it == __sites.end()) {
+                uint32_t id = __sites.size();
+                it = __sites.insert({ key, id }).first;
+                put(out, (uint8_t)FRAME_SITE);
+                put(out, id);
+                put(out, hdr.__line);
+                putString(out, hdr.__file, strlen(hdr.__file));
+                putString(out, hdr.__fmt, strlen(hdr.__fmt));
+            }
+            put(out, (uint8_t)FRAME_RECORD);
+            put(out, it->second);
+            put(out, (uint8_t)hdr.__level);
+            put(out, hdr.__time_ns);
+            putString(out, (const char*)&hdr.__tid, sizeof(hdr.__tid));
+            putString(out, args, args_len);
+        }
+    };
+    // 把二进制日志文件转换成文本，离线解码工具使用
+    class decoder {
+    private:
+        struct site {
+            uint32_t __line;
+            std::string __file;
+            std::string __fmt;
+        };
+        std::vector<site> __sites;
+        std::string __logger_name;
+        bool __header_read = false;
+        logStream __payload; //
+    public:
+        // 解码 [data, data + len)，返回成功解码的字节数；末尾不完整的帧留给下一次调用
+        // 数据损坏时返回 (size_t)-1
+        size_t decode(const char* data, size_t len, formatter& fmt, logStream& out) {
+            const char* p = data;
+            const char* end = data + len;
+            while (p < end) {
+                const char* q = p;
+                if (*q == FILE_MAGIC[0]) {
+                    // 文件头，和帧类型不会冲突
+                    uint32_t version, name_len;
+                    if ((size_t)(end - q) < 8)
+                        break;
+                    if (memcmp(q, FILE_MAGIC, 8) != 0)
+                        return (size_t)-1;
+                    q += 8;
+                    if (!get(q, end, version) || !get(q, end, name_len) || (size_t)(end - q) < name_len)
+                        break;
+                    if (version != FILE_VERSION)
+                        return (size_t)-1;
+                    __logger_name.assign(q, name_len);
+                    __sites.clear(); // 新的一段数据，调用点ID重新编号
+                    __header_read = true;
+                    p = q + name_len;
+                    continue;
+                }
+                if (!__header_read)
+                    return (size_t)-1;
+                uint8_t type;
+                get(q, end, type);
+                if (type == FRAME_SITE) {
+                    uint32_t id, line, file_len, fmt_len;
+                    if (!get(q, end, id) || !get(q, end, line) || !get(q, end, file_len) || (size_t)(end - q) < file_len)
+                        break;
+                    const char* file = q;
+                    q += file_len;
+                    if (!get(q, end, fmt_len) || (size_t)(end - q) < fmt_len)
+                        break;
+                    if (id != __sites.size())
+                        return (size_t)-1;
+                    __sites.push_back({ line, std::string(file, file_len), std::string(q, fmt_len) });
+                    q += fmt_len;
+                } else if (type == FRAME_RECORD) {
+                    uint32_t id, tid_len, args_len;
+                    uint8_t level;
+                    int64_t time_ns;
+                    if (!get(q, end, id) || !get(q, end, level) || !get(q, end, time_ns) || !get(q, end, tid_len) || (size_t)(end - q) < tid_len)
+                        break;
+                    pid_t tid = 0;
+                    if (tid_len == sizeof(tid))
+                        memcpy(&tid, q, sizeof(tid));
+                    q += tid_len;
+                    if (!get(q, end, args_len) || (size_t)(end - q) < args_len)
+                        break;
+                    if (id >= __sites.size())
+                        return (size_t)-1;
+                    const site& st = __sites[id];
+                    __payload.clear();
+                    if (!decodeArgs(__payload, st.__fmt.c_str(), q, q + args_len))
+                        return (size_t)-1;
+                    q += args_len;
+                    logMessage msg((logLevel::value)level, st.__line, st.__file, __logger_name, __payload.view());
+                    msg.__ctime = (time_t)(time_ns / util::Date::NS_PER_SEC);
+                    msg.__cnsec = (long)(time_ns % util::Date::NS_PER_SEC);
+                    msg.__tid = tid;
+                    msg.__name_id = 0; // 文件中只有线程ID
+                    fmt.format(out, msg);
+                } else
+                    return (size_t)-1;
+                p = q;
+            }
+            return p - data;
+        }
+    };
+} // namespace binary
+} // namespace ffengc_log
+
+#endif
@@ -7,23 +7,33 @@
 #ifndef __YUFC_BUFFER__
 #define __YUFC_BUFFER__
 
+#include "level.hpp"
 #include "util.hpp"
 #include <algorithm>
 #include <assert.h>
+#include <stdint.h>
 #include <vector>
 
 namespace ffengc_log {
 #define DEFAULT_BUFFER_SIZE (1 * 1024 * 1024)
 #define THRESHOLD_BUFFER_SIZE (8 * 1024 * 1024)
 #define LINEAR_INCREMENT_BUFFER_SIZE (1 * 1024 * 1024)
+// 缓冲区中一条日志的位置和元数据
+struct recordMeta {
+    size_t __offset; // 相对于可读数据的起始位置
+    size_t __size;
+    logLevel::value __level;
+    int64_t __time_ns;
+};
 class buffer {
 public:
     std::vector<char> __buffer;
     size_t __read_idx;
-    size_t __write_idx; //
+    size_t __write_idx;
+    std::vector<recordMeta> __records; // 只有 sink 需要逐条处理日志时才会记录 //
 public:
-    buffer()
-        : __buffer(DEFAULT_BUFFER_SIZE)
+    buffer(size_t size = DEFAULT_BUFFER_SIZE)
+        : __buffer(size)
         , __write_idx(0)
         , __read_idx(0) { }
     void push(const char* data, size_t len) {
@@ -36,6 +46,10 @@ public:
         // 2. 将写入位置向后偏移
         moveWriter(len);
     } // 向缓冲区写入数据
+    void pushRecord(const char* data, size_t len, logLevel::value level, int64_t time_ns) {
+        __records.push_back({ readableSize(), len, level, time_ns });
+        push(data, len);
+    } // 写入一条日志，同时记录它的位置和元数据
     size_t writeableSize() {
         // 对于扩容思路来说，这个接口没啥用，因为总是可写的，因此这个接口仅仅针对只有固定大小buffer提供的
         return (__buffer.size() - __write_idx);
@@ -56,16 +70,29 @@ public:
     }
     void reset() {
         __read_idx = __write_idx = 0;
+        __records.clear();
         // 不需要释放空间
     } // 重置读写位置
     void swap(buffer& bf) {
         __buffer.swap(bf.__buffer);
         std::swap(__read_idx, bf.__read_idx);
         std::swap(__write_idx, bf.__write_idx);
+        __records.swap(bf.__records);
     }
     bool empty() {
         return __read_idx == __write_idx;
-    } //
+    }
+    size_t capacity() {
+        return __buffer.size();
+    }
+    void shrink(size_t size) {
+        if (__buffer.size() <= size)
+            return;
+        std::vector<char>(size).swap(__buffer); // 真正释放多余的内存
+        std::vector<recordMeta>().swap(__records);
+        reset();
+    } // 只在缓冲区为空时调用
+
 private:
     // 扩容
     void alloc(size_t len) {
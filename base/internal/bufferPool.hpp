@@ -0,0 +1,162 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_BUFFER_POOL__
+#define __YUFC_BUFFER_POOL__
+
+#include "buffer.hpp"
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace ffengc_log {
+#define DEFAULT_BUFFER_IDLE_MS 5000
+struct bufferPoolConfig {
+    size_t __chunk_size = DEFAULT_BUFFER_SIZE; // 每个缓冲块的大小
+    size_t __max_bytes = 0; // 缓冲块总内存上限，0表示使用工作模式的默认值（ASYNC_SAFE 为两块，ASYNC_UNSAFE 不限制）
+    size_t __idle_ms = DEFAULT_BUFFER_IDLE_MS; // 空闲超过这个时间的缓冲块还给操作系统，0表示不释放
+    bool __node_local = false; // ASYNC_LOCKFREE 模式下生产者的环形缓冲区分配在生产者所在的NUMA节点，其他模式不起作用
+};
+struct freeChunk {
+    buffer* __buf;
+    std::chrono::steady_clock::time_point __since; // 开始空闲的时间
+};
+// 多个内存池共用的空闲块，由共享线程池持有
+// 日志器用完的块放回这里，不再各自保留，空闲的内存不随日志器的数量增长
+class chunkCache {
+private:
+    using clock = std::chrono::steady_clock;
+    std::mutex __mtx;
+    size_t __chunk_size;
+    std::chrono::milliseconds __idle;
+    std::deque<freeChunk> __free; // 后进先出，队头是空闲最久的
+public:
+    using ptr = std::shared_ptr<chunkCache>;
+    chunkCache(size_t chunk_size, size_t idle_ms)
+        : __chunk_size(chunk_size)
+        , __idle(idle_ms) { }
+    ~chunkCache() {
+        for (auto& e : __free)
+            delete e.__buf;
+    }
+    buffer* take() {
+        std::unique_lock<std::mutex> lock(__mtx);
+        if (__free.empty())
+            return nullptr;
+        buffer* buf = __free.back().__buf;
+        __free.pop_back();
+        return buf;
+    } // 没有空闲的块时返回 nullptr
+    void give(buffer* buf) {
+        std::unique_lock<std::mutex> lock(__mtx);
+        __free.push_back({ buf, clock::now() });
+    } // 调用者已经把块恢复成固定大小
+    void trim() {
+        if (__idle.count() == 0)
+            return;
+        clock::time_point now = clock::now();
+        std::unique_lock<std::mutex> lock(__mtx);
+        bool freed = false;
+        while (!__free.empty() && now - __free.front().__since >= __idle) {
+            delete __free.front().__buf;
+            __free.pop_front();
+            freed = true;
+        }
+#ifdef __GLIBC__
+        if (freed)
+            malloc_trim(0);
+#endif
+    } // 释放空闲太久的块
+    size_t chunkSize() { return __chunk_size; }
+    size_t cachedBytes() {
+        std::unique_lock<std::mutex> lock(__mtx);
+        return __free.size() * __chunk_size;
+    } // 空闲的块占用的内存
+};
+// 固定大小缓冲块的内存池
+// 生产者写满一块就换一块新的，不再扩容拷贝；空闲的块超过一段时间后释放
+// 不加锁，由 asyncLooper 在自己的锁内调用
+// 有共用的 chunkCache 时，用完的块直接放回共用的缓存，自己只持有正在使用的块
+class bufferPool {
+private:
+    using clock = std::chrono::steady_clock;
+    size_t __chunk_size;
+    size_t __max_chunks; // 0表示不限制
+    std::chrono::milliseconds __idle;
+    size_t __allocated; // 已经分配的块数（包括正在使用的）
+    std::deque<freeChunk> __free; // 后进先出，队头是空闲最久的
+    chunkCache::ptr __shared; // 为空时空闲的块留在 __free 中
+public:
+    bufferPool(size_t chunk_size, size_t max_bytes, size_t idle_ms, const chunkCache::ptr& shared = nullptr)
+        : __chunk_size(chunk_size == 0 ? DEFAULT_BUFFER_SIZE : chunk_size)
+        , __max_chunks(0)
+        , __idle(idle_ms)
+        , __allocated(0) {
+        if (max_bytes > 0)
+            __max_chunks = std::max((size_t)2, max_bytes / __chunk_size); // 至少两块，生产者和消费者各一块
+        if (shared && shared->chunkSize() == __chunk_size)
+            __shared = shared; // 块大小不同时不共用
+    }
+    ~bufferPool() {
+        for (auto& e : __free)
+            delete e.__buf;
+    }
+    bool available() { return !__free.empty() || __max_chunks == 0 || __allocated < __max_chunks; }
+    buffer* acquire() {
+        if (!__free.empty()) {
+            buffer* buf = __free.back().__buf;
+            __free.pop_back();
+            return buf;
+        }
+        if (__max_chunks != 0 && __allocated >= __max_chunks)
+            return nullptr; // 达到内存上限
+        __allocated++;
+        if (__shared) {
+            buffer* buf = __shared->take();
+            if (buf != nullptr)
+                return buf;
+        }
+        return new buffer(__chunk_size);
+    }
+    void release(buffer* buf) {
+        buf->reset();
+        buf->shrink(__chunk_size); // 超大日志把块撑大了，恢复成固定大小
+        if (__shared) {
+            __shared->give(buf);
+            __allocated--;
+            return;
+        }
+        __free.push_back({ buf, clock::now() });
+    }
+    void trim() {
+        if (__shared)
+            __shared->trim();
+        if (__idle.count() == 0)
+            return; // 不释放空闲的块
+        clock::time_point now = clock::now();
+        bool freed = false;
+        while (!__free.empty() && now - __free.front().__since >= __idle) {
+            delete __free.front().__buf;
+            __free.pop_front();
+            __allocated--;
+            freed = true;
+        }
+#ifdef __GLIBC__
+        if (freed)
+            malloc_trim(0); // glibc 不一定会把大块内存立刻还给操作系统
+#endif
+    } // 释放空闲太久的块
+    size_t chunkSize() { return __chunk_size; }
+    size_t allocatedBytes() { return __allocated * __chunk_size; } // 共用缓存时只包括正在使用的块
+    std::chrono::milliseconds idleTimeout() { return __idle; }
+};
+} // namespace ffengc_log
+
+#endif
@@ -0,0 +1,305 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_FIELD__
+#define __YUFC_FIELD__
+
+#include "logStream.hpp"
+#include "util.hpp"
+#include <initializer_list>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace ffengc_log {
+// 附加在一条日志上的键值对，字符串只引用不拷贝，只在写日志的调用期间有效
+// 例如 obj.info(__FILE__, __LINE__, { { "user", 42 }, { "ip", ip } }, "login")
+struct logField {
+    enum class type {
+        STRING,
+        INT,
+        UINT,
+        DOUBLE,
+        BOOL,
+    };
+    util::strView __key;
+    type __type;
+    util::strView __str;
+    union {
+        long long __int;
+        unsigned long long __uint;
+        double __double;
+        bool __bool;
+    };
+    logField(util::strView key, const char* value)
+        : __key(key)
+        , __type(type::STRING)
+        , __str(value)
+        , __uint(0) { }
+    logField(util::strView key, const std::string& value)
+        : __key(key)
+        , __type(type::STRING)
+        , __str(value)
+        , __uint(0) { }
+    logField(util::strView key, util::strView value)
+        : __key(key)
+        , __type(type::STRING)
+        , __str(value)
+        , __uint(0) { }
+    logField(util::strView key, int value)
+        : logField(key, (long long)value) { }
+    logField(util::strView key, long value)
+        : logField(key, (long long)value) { }
+    logField(util::strView key, long long value)
+        : __key(key)
+        , __type(type::INT)
+        , __int(value) { }
+    logField(util::strView key, unsigned value)
+        : logField(key, (unsigned long long)value) { }
+    logField(util::strView key, unsigned long value)
+        : logField(key, (unsigned long long)value) { }
+    logField(util::strView key, unsigned long long value)
+        : __key(key)
+        , __type(type::UINT)
+        , __uint(value) { }
+    logField(util::strView key, double value)
+        : __key(key)
+        , __type(type::DOUBLE)
+        , __double(value) { }
+    logField(util::strView key, bool value)
+        : __key(key)
+        , __type(type::BOOL)
+        , __uint(0) { __bool = value; }
+};
+using logFields = std::initializer_list<logField>;
+
+// 结构化输出（JSON / logfmt）用到的转义和编码
+namespace structured {
+    inline bool needsEscape(unsigned char c) { return c < 0x20 || c == '"' || c == '\\'; }
+    // 逐字节查找第一个需要转义的字符
+    inline const char* findEscapeScalar(const char* p, const char* end) {
+        while (p < end && !needsEscape(*p))
+            ++p;
+        return p;
+    }
+    // 一次比较16个字节，日志主体通常没有需要转义的字符，整段直接拷贝
+    inline const char* findEscape(const char* p, const char* end) {
+#if defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i slash = _mm_set1_epi8('\\');
+        const __m128i ctrl = _mm_set1_epi8(0x1F);
+        while (end - p >= 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)p);
+            // 无符号比较 v <= 0x1F 等价于 min(v, 0x1F) == v
+            __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)),
+                _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));
+            int mask = _mm_movemask_epi8(hit);
+            if (mask != 0)
+                return p + __builtin_ctz(mask);
+            p += 16;
+        }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+        const uint8x16_t quote = vdupq_n_u8('"');
+        const uint8x16_t slash = vdupq_n_u8('\\');
+        const uint8x16_t ctrl = vdupq_n_u8(0x1F);
+        while (end - p >= 16) {
+            uint8x16_t v = vld1q_u8((const uint8_t*)p);
+            uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, slash)), vcleq_u8(v, ctrl));
+            if (vmaxvq_u8(hit) != 0)
+                return findEscapeScalar(p, p + 16);
+            p += 16;
+        }
+#endif
+        return findEscapeScalar(p, end);
+    }
+    // 按 JSON 字符串的规则转义（不加引号），非 ASCII 字节原样输出
+    inline void appendEscaped(logStream& out, util::strView str) {
+        static const char hex[] = "0123456789abcdef";
+        const char* p = str.data();
+        const char* end = p + str.size();
+        while (p < end) {
+            const char* q = findEscape(p, end);
+            out.append(p, q - p);
+            if (q == end)
+                break;
+            unsigned char c = *q;
+            switch (c) {
+            case '"':
+                out.append("\\\"", 2);
+                break;
+            case '\\':
+                out.append("\\\\", 2);
+                break;
+            case '\n':
+                out.append("\\n", 2);
+                break;
+            case '\r':
+                out.append("\\r", 2);
+                break;
+            case '\t':
+                out.append("\\t", 2);
+                break;
+            default: {
+                char u[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+                out.append(u, sizeof(u));
+            }
+            }
+            p = q + 1;
+        }
+    }
+    inline void appendQuoted(logStream& out, util::strView str) {
+        out.append('"');
+        appendEscaped(out, str);
+        out.append('"');
+    }
+    // 最多6位小数、能精确还原的值（大多数耗时、比例之类的值）直接按整数拼出来，不调用 snprintf
+    // 其他值先用15位有效数字，不能精确还原时才用17位（0.1 输出 0.1 而不是 0.10000000000000001）
+    inline void appendDouble(logStream& out, double value) {
+        double scaled = value * 1e6;
+        if (fabs(value) < 1e9 && scaled == (double)(long long)scaled && (double)(long long)scaled / 1e6 == value) {
+            long long n = (long long)scaled;
+            unsigned long long u = n < 0 ? 0ULL - (unsigned long long)n : (unsigned long long)n;
+            if (n < 0 || signbit(value))
+                out.append('-');
+            out.appendUnsigned(u / 1000000);
+            unsigned frac = u % 1000000;
+            if (frac != 0) {
+                char digits[7] = { '.' };
+                int len = 7;
+                for (int i = 6; i >= 1; --i, frac /= 10)
+                    digits[i] = '0' + frac % 10;
+                while (digits[len - 1] == '0')
+                    --len; // 去掉末尾的0
+                out.append(digits, len);
+            }
+            return;
+        }
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.15g", value);
+        if (strtod(buf, nullptr) != value)
+            snprintf(buf, sizeof(buf), "%.17g", value);
+        out.append(buf);
+    }
+    inline void appendNumber(logStream& out, const logField& f) {
+        switch (f.__type) {
+        case logField::type::INT:
+            if (f.__int < 0) {
+                out.append('-');
+                out.appendUnsigned(0ULL - (unsigned long long)f.__int);
+            } else
+                out.appendUnsigned(f.__int);
+            break;
+        case logField::type::UINT:
+            out.appendUnsigned(f.__uint);
+            break;
+        case logField::type::DOUBLE:
+            if (isfinite(f.__double))
+                appendDouble(out, f.__double);
+            else
+                out.append("null", 4); // JSON 没有 nan 和 inf
+            break;
+        case logField::type::BOOL:
+            if (f.__bool)
+                out.append("true", 4);
+            else
+                out.append("false", 5);
+            break;
+        default:
+            break;
+        }
+    }
+    inline void appendJsonValue(logStream& out, const logField& f) {
+        if (f.__type == logField::type::STRING)
+            appendQuoted(out, f.__str);
+        else
+            appendNumber(out, f);
+    }
+    // logfmt 的值只有包含空格、等号、引号或控制字符（或者为空）时才加引号
+    inline void appendLogfmtString(logStream& out, util::strView str) {
+        bool quote = str.empty();
+        for (size_t i = 0; i < str.size() && !quote; ++i)
+            quote = str.data()[i] == ' ' || str.data()[i] == '=' || needsEscape(str.data()[i]);
+        if (quote)
+            appendQuoted(out, str);
+        else
+            out.append(str);
+    }
+    inline void appendLogfmtValue(logStream& out, const logField& f) {
+        if (f.__type == logField::type::STRING)
+            appendLogfmtString(out, f.__str);
+        else
+            appendNumber(out, f);
+    }
+    // 每个键值对输出成 " key=value"
+    inline void appendLogfmtFields(logStream& out, const logField* fields, size_t cnt) {
+        for (size_t i = 0; i < cnt; ++i) {
+            out.append(' ');
+            out.append(fields[i].__key);
+            out.append('=');
+            appendLogfmtValue(out, fields[i]);
+        }
+    }
+    // 延迟格式化时把键值对连同字符串一起拷贝进缓冲区: 个数 | (类型 键长度 键 值)...
+    // 字符串的值为 长度 | 内容，其他类型的值固定8字节
+    inline void encodeFields(logStream& out, const logField* fields, size_t cnt) {
+        uint32_t n = cnt;
+        out.append((const char*)&n, sizeof(n));
+        for (size_t i = 0; i < cnt; ++i) {
+            const logField& f = fields[i];
+            uint8_t type = (uint8_t)f.__type;
+            uint32_t key_len = f.__key.size();
+            out.append((const char*)&type, sizeof(type));
+            out.append((const char*)&key_len, sizeof(key_len));
+            out.append(f.__key);
+            if (f.__type == logField::type::STRING) {
+                uint32_t len = f.__str.size();
+                out.append((const char*)&len, sizeof(len));
+                out.append(f.__str);
+            } else
+                out.append((const char*)&f.__uint, sizeof(f.__uint));
+        }
+    }
+    // 解码出的键值对引用缓冲区中的数据
+    inline void decodeFields(const char* p, std::vector<logField>& fields) {
+        fields.clear();
+        uint32_t n = 0;
+        memcpy(&n, p, sizeof(n));
+        p += sizeof(n);
+        for (uint32_t i = 0; i < n; ++i) {
+            uint8_t type = 0;
+            uint32_t key_len = 0;
+            memcpy(&type, p, sizeof(type));
+            p += sizeof(type);
+            memcpy(&key_len, p, sizeof(key_len));
+            p += sizeof(key_len);
+            util::strView key(p, key_len);
+            p += key_len;
+            if ((logField::type)type == logField::type::STRING) {
+                uint32_t len = 0;
+                memcpy(&len, p, sizeof(len));
+                p += sizeof(len);
+                fields.push_back(logField(key, util::strView(p, len)));
+                p += len;
+            } else {
+                logField f(key, 0ULL);
+                f.__type = (logField::type)type;
+                memcpy(&f.__uint, p, sizeof(f.__uint));
+                p += sizeof(f.__uint);
+                fields.push_back(f);
+            }
+        }
+    }
+} // namespace structured
+} // namespace ffengc_log
+
+#endif
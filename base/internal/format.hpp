@@ -8,8 +8,11 @@
 #define __YUFC_FORMAT__
 
 #include "level.hpp"
+#include "logStream.hpp"
 #include "message.hpp"
 #include <assert.h>
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <sstream>
 #include <time.h>
@@ -21,71 +24,185 @@ namespace ffengc_log {
 class formatItem {
 public:
     using ptr = std::shared_ptr<formatItem>;
-    virtual void format(std::ostream& out, const logMessage& msg) = 0;
+    virtual ~formatItem() { }
+    virtual void format(logStream& out, const logMessage& msg) = 0;
 };
 // 派生格式化子项子类 -- 消息、等级、时间、文件名、行号、线程id、日志器名称、制表符、换行、其他
 class messageFormatItem : public formatItem {
 public:
     messageFormatItem(const std::string& str = "") { }
-    void format(std::ostream& out, const logMessage& msg) { out << msg.__payload; }
+    void format(logStream& out, const logMessage& msg) override { out.append(msg.__payload); }
 };
 class levelFormatItem : public formatItem {
 public:
     levelFormatItem(const std::string& str = "") { }
-    void format(std::ostream& out, const logMessage& msg) override { out << logLevel::toString(msg.__level); }
+    void format(logStream& out, const logMessage& msg) override { out.append(logLevel::toString(msg.__level)); }
 };
+// %d 的子格式除了 strftime 支持的格式，还支持亚秒级格式: %3N 毫秒，%6N 微秒，%9N 或 %N 纳秒
+// 同一秒内 strftime 的结果是不变的，因此每个线程缓存上一次的输出，只重新计算亚秒部分
 class timeFormatItem : public formatItem {
+private:
+    static const size_t MAX_FRAC = 4; // 一个子格式里最多支持的亚秒格式数量
+    static const size_t CACHE_SLOTS = 8; // 每个线程的缓存槽位数量
+    struct timeCache {
+        size_t __owner = 0; // 缓存属于哪个格式化子项
+        time_t __sec = 0;
+        struct tm __tm;
+        char __buf[128];
+        size_t __len = 0;
+        size_t __frac_pos[MAX_FRAC]; // 亚秒部分在 __buf 中的位置
+    };
+    std::string __time_fmt; // %H:%M:%S
+    std::vector<std::string> __parts; // 以亚秒格式分割后的 strftime 格式，比 __fracs 多一个
+    std::vector<int> __fracs; // 每个亚秒格式的位数
+    size_t __id; //
 public:
     timeFormatItem(const std::string& fmt = "%H:%M:%S")
-        : __time_fmt(fmt) {
+        : __time_fmt(fmt)
+        , __id(nextId()) {
         if (fmt.empty())
             __time_fmt = "%H:%M:%S";
+        parseFrac();
     }
-    void format(std::ostream& out, const logMessage& msg) override {
-        struct tm t;
-        localtime_r(&msg.__ctime, &t);
-        char tmp[128] = { 0 };
-        strftime(tmp, 31, __time_fmt.c_str(), &t);
-        out << tmp;
+    void format(logStream& out, const logMessage& msg) override {
+        static thread_local timeCache caches[CACHE_SLOTS];
+        timeCache& cache = caches[__id % CACHE_SLOTS];
+        if (cache.__owner != __id || cache.__sec != msg.__ctime)
+            render(cache, msg.__ctime);
+        char* p = out.reserve(cache.__len);
+        memcpy(p, cache.__buf, cache.__len);
+        for (size_t i = 0; i < __fracs.size(); ++i)
+            fillFrac(p + cache.__frac_pos[i], __fracs[i], msg.__cnsec);
+        out.commit(cache.__len);
     } //
 private:
-    std::string __time_fmt; // %H:%M:%S
+    static size_t nextId() {
+        static std::atomic<size_t> id(0);
+        return ++id; // 从1开始，0表示缓存槽位为空
+    }
+    void parseFrac() {
+        std::string part;
+        for (size_t i = 0; i < __time_fmt.size(); ++i) {
+            if (__time_fmt[i] != '%' || i + 1 == __time_fmt.size()) {
+                part.push_back(__time_fmt[i]);
+                continue;
+            }
+            int digits = 0;
+            size_t skip = 0;
+            char c = __time_fmt[i + 1];
+            if (c == 'N')
+                digits = 9, skip = 1;
+            else if ((c == '3' || c == '6' || c == '9') && i + 2 < __time_fmt.size() && __time_fmt[i + 2] == 'N')
+                digits = c - '0', skip = 2;
+            if (digits == 0 || __fracs.size() == MAX_FRAC) {
+                // 交给 strftime 处理，%% 也原样保留
+                part.push_back('%');
+                part.push_back(c);
+                i += 1;
+                continue;
+            }
+            __parts.push_back(part);
+            __fracs.push_back(digits);
+            part.clear();
+            i += skip;
+        }
+        __parts.push_back(part);
+    }
+    void render(timeCache& cache, time_t sec) {
+        // 同一分钟内只需要调整秒数，不需要调用 localtime_r（它在多线程下会争抢时区锁）
+        if (cache.__owner == __id && sec > cache.__sec && cache.__tm.tm_sec + (sec - cache.__sec) < 60)
+            cache.__tm.tm_sec += (int)(sec - cache.__sec);
+        else
+            localtime_r(&sec, &cache.__tm);
+        cache.__owner = __id;
+        cache.__sec = sec;
+        size_t len = 0;
+        for (size_t i = 0; i < __parts.size(); ++i) {
+            if (!__parts[i].empty())
+                len += strftime(cache.__buf + len, sizeof(cache.__buf) - len, __parts[i].c_str(), &cache.__tm);
+            if (i < __fracs.size() && len + __fracs[i] <= sizeof(cache.__buf)) {
+                cache.__frac_pos[i] = len;
+                len += __fracs[i]; // 占位，输出时填充
+            } else if (i < __fracs.size())
+                cache.__frac_pos[i] = len - __fracs[i]; // 缓冲区满了，直接覆盖末尾
+        }
+        cache.__len = len;
+    }
+    static void fillFrac(char* p, int digits, long nsec) {
+        for (int i = 9; i > digits; --i)
+            nsec /= 10;
+        for (int i = digits - 1; i >= 0; --i) {
+            p[i] = '0' + nsec % 10;
+            nsec /= 10;
+        }
+    }
 };
 class fileFormatItem : public formatItem {
 public:
     fileFormatItem(const std::string& str = "") { }
-    void format(std::ostream& out, const logMessage& msg) override { out << msg.__file; }
+    void format(logStream& out, const logMessage& msg) override { out.append(msg.__file); }
 };
 class lineFormatItem : public formatItem {
 public:
     lineFormatItem(const std::string& str = "") { }
-    void format(std::ostream& out, const logMessage& msg) override { out << msg.__line; }
+    void format(logStream& out, const logMessage& msg) override { out.appendUnsigned(msg.__line); }
 };
+// 查询日志产生时线程注册的名字，没有注册时返回 nullptr
+// 编号对应的名字不会改变，每个格式化线程缓存查询结果，每个编号只加锁查询一次
+inline const std::string* threadName(const logMessage& msg) {
+    if (msg.__name_id == 0)
+        return nullptr;
+    static thread_local std::vector<const std::string*> cache;
+    if (msg.__name_id >= cache.size())
+        cache.resize(msg.__name_id + 1, nullptr);
+    if (cache[msg.__name_id] == nullptr)
+        cache[msg.__name_id] = util::Thread::nameOf(msg.__name_id);
+    return cache[msg.__name_id];
+}
+// %t 输出内核线程ID，%t{name} 输出 util::Thread::setName 注册的线程名，没有注册时输出线程ID
 class threadIdFormatItem : public formatItem {
+private:
+    bool __name; //
 public:
-    threadIdFormatItem(const std::string& str = "") { }
-    void format(std::ostream& out, const logMessage& msg) override { out << msg.__tid; }
+    threadIdFormatItem(const std::string& str = "")
+        : __name(str == "name") { }
+    void format(logStream& out, const logMessage& msg) override {
+        if (__name) {
+            const std::string* name = threadName(msg);
+            if (name != nullptr) {
+                out.append(name->data(), name->size());
+                return;
+            }
+        }
+        out.appendUnsigned((unsigned)msg.__tid);
+    }
 };
 class loggerFormatItem : public formatItem {
 public:
     loggerFormatItem(const std::string& str = "") { }
-    void format(std::ostream& out, const logMessage& msg) override { out << msg.__logger; }
+    void format(logStream& out, const logMessage& msg) override { out.append(msg.__logger); }
 };
 class tabFormatItem : public formatItem {
 public:
     tabFormatItem(const std::string& str = "") { }
-    void format(std::ostream& out, const logMessage& msg) override { out << "\t"; }
+    void format(logStream& out, const logMessage& msg) override { out.append('\t'); }
 };
 class newLineFormatItem : public formatItem {
 public:
     newLineFormatItem(const std::string& str = "") { }
-    void format(std::ostream& out, const  logMessage& msg) override { out << "\n"; }
+    void format(logStream& out, const logMessage& msg) override { out.append('\n'); }
+};
+// 附加的键值对，输出成 logfmt 风格的 " key=value"
+class fieldsFormatItem : public formatItem {
+public:
+    fieldsFormatItem(const std::string& str = "") { }
+    void format(logStream& out, const logMessage& msg) override { structured::appendLogfmtFields(out, msg.__fields, msg.__field_cnt); }
 };
 class otherFormatItem : public formatItem {
 public:
     otherFormatItem(const std::string& str)
         : __str(str) { }
-    void format(std::ostream& out, const logMessage& msg) override { out << __str; } //
+    void format(logStream& out, const logMessage& msg) override { out.append(__str.c_str(), __str.size()); } //
 private:
     std::string __str;
 };
@@ -99,27 +216,39 @@ private:
  * %p 表示日志级别
  * %T 表示制表符缩进
  * %m 表示主体消息
+ * %k 表示附加的键值对
  * %n 标识换行
  */
 class formatter {
 private:
     std::string __pattern; // 格式化规则字符串
     std::vector<formatItem::ptr> __items; //
+protected:
+    struct noParse { };
+    formatter(const std::string& pattern, noParse)
+        : __pattern(pattern) { } // 派生类自己完成格式化，不需要解析
 public:
     using ptr = std::shared_ptr<formatter>;
     formatter(const std::string& pattern = "[%d{%H:%M:%S}][%t][%c][%f:%l][%p] %m%n")
         : __pattern(pattern) {
         assert(parsePattern());
     }
-    // 对msg进行格式化
-    void format(std::ostream& out, const logMessage& msg) {
+    virtual ~formatter() { }
+    const std::string& pattern() const { return __pattern; }
+    // 对msg进行格式化，直接写入字符缓冲区
+    virtual void format(logStream& out, const logMessage& msg) {
         for (const auto& item : __items)
             item->format(out, msg);
     }
+    void format(std::ostream& out, const logMessage& msg) {
+        logStream ls;
+        format(ls, msg);
+        out.write(ls.data(), ls.size());
+    }
     std::string format(const logMessage& msg) {
-        std::stringstream ss;
-        format(ss, msg);
-        return ss.str();
+        logStream ls;
+        format(ls, msg);
+        return std::string(ls.data(), ls.size());
     } //
 private:
     // 对格式化规则字符串进行解析
@@ -197,6 +326,8 @@ private:
             return formatItem::ptr(new messageFormatItem(val));
         if (key == "n")
             return formatItem::ptr(new newLineFormatItem(val));
+        if (key == "k")
+            return formatItem::ptr(new fieldsFormatItem(val));
         if (key == "")
             return formatItem::ptr(new otherFormatItem(val));
         std::cerr << "this is not a valid fmt char: %" << key << std::endl;
@@ -204,6 +335,175 @@ private:
     }
 };
 
+// 编译期解析的格式化器
+// 格式化规则在编译期解析成一串非虚函数调用，每条日志只有 format 这一次虚函数调用
+// 模板参数必须是命名空间作用域的字符数组，例如：
+//   constexpr char pattern[] = "[%d{%H:%M:%S}][%p] %m%n";
+//   builder->buildFormatter<pattern>();
+namespace detail {
+    enum tokenKind {
+        TOKEN_END, // 规则字符串结束
+        TOKEN_LITERAL, // 原始字符串
+        TOKEN_PERCENT, // %%
+        TOKEN_ITEM, // %x 或者 %x{...}
+        TOKEN_ERROR, // %后面没有格式化字符，或者{没有闭合
+    };
+    constexpr size_t literalEnd(const char* p, size_t i) {
+        return (p[i] == '\0' || p[i] == '%') ? i : literalEnd(p, i + 1);
+    }
+    constexpr size_t braceEnd(const char* p, size_t i) {
+        return (p[i] == '\0' || p[i] == '}') ? i : braceEnd(p, i + 1);
+    }
+    constexpr bool hasSub(const char* p, size_t i) { return p[i + 2] == '{'; }
+    constexpr int kindOf(const char* p, size_t i) {
+        return p[i] == '\0'         ? TOKEN_END
+            : p[i] != '%'           ? TOKEN_LITERAL
+            : p[i + 1] == '%'       ? TOKEN_PERCENT
+            : p[i + 1] == '\0'      ? TOKEN_ERROR
+            : !hasSub(p, i)         ? TOKEN_ITEM
+            : p[braceEnd(p, i + 3)] == '}' ? TOKEN_ITEM
+                                    : TOKEN_ERROR;
+    }
+    constexpr size_t subBegin(const char* p, size_t i) { return hasSub(p, i) ? i + 3 : i + 2; }
+    constexpr size_t subEnd(const char* p, size_t i) { return hasSub(p, i) ? braceEnd(p, i + 3) : i + 2; }
+    constexpr size_t itemEnd(const char* p, size_t i) { return hasSub(p, i) ? braceEnd(p, i + 3) + 1 : i + 2; }
+    // 格式化字符到格式化子项的映射
+    template <char Key>
+    struct itemOf {
+        static_assert(Key != Key, "this is not a valid fmt char");
+    };
+    template <> struct itemOf<'d'> { using type = timeFormatItem; };
+    template <> struct itemOf<'t'> { using type = threadIdFormatItem; };
+    template <> struct itemOf<'c'> { using type = loggerFormatItem; };
+    template <> struct itemOf<'f'> { using type = fileFormatItem; };
+    template <> struct itemOf<'l'> { using type = lineFormatItem; };
+    template <> struct itemOf<'p'> { using type = levelFormatItem; };
+    template <> struct itemOf<'T'> { using type = tabFormatItem; };
+    template <> struct itemOf<'m'> { using type = messageFormatItem; };
+    template <> struct itemOf<'n'> { using type = newLineFormatItem; };
+    template <> struct itemOf<'k'> { using type = fieldsFormatItem; };
+
+    template <const char* P, size_t I, int Kind = kindOf(P, I)>
+    struct staticItems;
+    template <const char* P, size_t I>
+    struct staticItems<P, I, TOKEN_END> {
+        static void format(logStream& /*out*/, const logMessage& /*msg*/) { }
+    };
+    template <const char* P, size_t I>
+    struct staticItems<P, I, TOKEN_LITERAL> {
+        static void format(logStream& out, const logMessage& msg) {
+            out.append(P + I, literalEnd(P, I) - I);
+            staticItems<P, literalEnd(P, I)>::format(out, msg);
+        }
+    };
+    template <const char* P, size_t I>
+    struct staticItems<P, I, TOKEN_PERCENT> {
+        static void format(logStream& out, const logMessage& msg) {
+            out.append('%');
+            staticItems<P, I + 2>::format(out, msg);
+        }
+    };
+    template <const char* P, size_t I>
+    struct staticItems<P, I, TOKEN_ITEM> {
+        using item = typename itemOf<P[I + 1]>::type;
+        static void format(logStream& out, const logMessage& msg) {
+            // 通过对象直接调用，编译器可以去掉虚函数调用并内联
+            static item it(std::string(P + subBegin(P, I), subEnd(P, I) - subBegin(P, I)));
+            it.item::format(out, msg);
+            staticItems<P, itemEnd(P, I)>::format(out, msg);
+        }
+    };
+    template <const char* P, size_t I>
+    struct staticItems<P, I, TOKEN_ERROR> {
+        static_assert(I != I, "fmt error: no fmt char after the %, or substr '{}' is not closed");
+        static void format(logStream& out, const logMessage& msg) { }
+    };
+} // namespace detail
+template <const char* Pattern>
+class staticFormatter : public formatter {
+public:
+    staticFormatter()
+        : formatter(Pattern, noParse()) { }
+    using formatter::format;
+    void format(logStream& out, const logMessage& msg) override {
+        detail::staticItems<Pattern, 0>::format(out, msg);
+    }
+};
+// 结构化格式化器，每条日志输出一行 JSON 或 logfmt，附加的键值对跟在固定字段后面
+// 日志主体和字符串值按 JSON 的规则转义，键值对的键不做检查，不要和固定字段重名
+// tid 是内核线程ID，线程通过 util::Thread::setName 注册了名字时再输出 thread
+#define DEFAULT_STRUCTURED_TIME_FMT "%Y-%m-%dT%H:%M:%S.%6N%z"
+class jsonFormatter : public formatter {
+private:
+    timeFormatItem __time; //
+public:
+    jsonFormatter(const std::string& time_fmt = DEFAULT_STRUCTURED_TIME_FMT)
+        : formatter("json", noParse())
+        , __time(time_fmt) { }
+    using formatter::format;
+    // {"time":"...","level":"INFO","logger":"root","file":"a.cc","line":12,"tid":1234,"thread":"...","msg":"...","key":value}
+    void format(logStream& out, const logMessage& msg) override {
+        out.append("{\"time\":\"", 9);
+        __time.format(out, msg);
+        out.append("\",\"level\":\"", 11);
+        out.append(logLevel::toString(msg.__level));
+        out.append("\",\"logger\":", 11);
+        structured::appendQuoted(out, msg.__logger);
+        out.append(",\"file\":", 8);
+        structured::appendQuoted(out, msg.__file);
+        out.append(",\"line\":", 8);
+        out.appendUnsigned(msg.__line);
+        out.append(",\"tid\":", 7);
+        out.appendUnsigned((unsigned)msg.__tid);
+        const std::string* name = threadName(msg);
+        if (name != nullptr) {
+            out.append(",\"thread\":", 10);
+            structured::appendQuoted(out, *name);
+        }
+        out.append(",\"msg\":", 7);
+        structured::appendQuoted(out, msg.__payload);
+        for (size_t i = 0; i < msg.__field_cnt; ++i) {
+            out.append(',');
+            structured::appendQuoted(out, msg.__fields[i].__key);
+            out.append(':');
+            structured::appendJsonValue(out, msg.__fields[i]);
+        }
+        out.append("}\n", 2);
+    }
+};
+class logfmtFormatter : public formatter {
+private:
+    timeFormatItem __time; //
+public:
+    logfmtFormatter(const std::string& time_fmt = DEFAULT_STRUCTURED_TIME_FMT)
+        : formatter("logfmt", noParse())
+        , __time(time_fmt) { }
+    using formatter::format;
+    // time=... level=INFO logger=root file=a.cc line=12 tid=1234 thread=... msg="..." key=value
+    void format(logStream& out, const logMessage& msg) override {
+        out.append("time=", 5);
+        __time.format(out, msg);
+        out.append(" level=", 7);
+        out.append(logLevel::toString(msg.__level));
+        out.append(" logger=", 8);
+        structured::appendLogfmtString(out, msg.__logger);
+        out.append(" file=", 6);
+        structured::appendLogfmtString(out, msg.__file);
+        out.append(" line=", 6);
+        out.appendUnsigned(msg.__line);
+        out.append(" tid=", 5);
+        out.appendUnsigned((unsigned)msg.__tid);
+        const std::string* name = threadName(msg);
+        if (name != nullptr) {
+            out.append(" thread=", 8);
+            structured::appendLogfmtString(out, *name);
+        }
+        out.append(" msg=", 5);
+        structured::appendQuoted(out, msg.__payload); // 主体总是加引号
+        structured::appendLogfmtFields(out, msg.__fields, msg.__field_cnt);
+        out.append('\n');
+    }
+};
 } // namespace ffengc_log
 
 #endif
\ No newline at end of file
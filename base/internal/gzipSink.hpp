@@ -0,0 +1,202 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_GZIP_SINK__
+#define __YUFC_GZIP_SINK__
+
+// 压缩的滚动文件，依赖 zlib，需要单独包含这个头文件并链接 -lz
+// #include "internal/gzipSink.hpp"
+
+#include "sink.hpp"
+#include <chrono>
+#include <deque>
+#include <stdio.h>
+#include <zlib.h>
+
+namespace ffengc_log {
+#define DEFAULT_GZIP_LEVEL 6
+#define GZIP_CHUNK_SIZE (64 * 1024)
+// 压缩的统计信息
+struct compressStats {
+    size_t __files = 0; // 已经压缩完成的文件数
+    size_t __raw_bytes = 0; // 压缩前的总大小
+    size_t __compressed_bytes = 0; // 压缩后的总大小
+    double __seconds = 0; // 压缩所用的总时间
+    double ratio() const { return __compressed_bytes ? (double)__raw_bytes / __compressed_bytes : 0; }
+};
+// 滚动方式和 rollSink 相同，文件写满后交给后台线程压缩成 xxx.log.gz 并删除原文件
+// 写日志的线程只负责把文件名放进队列，不会被压缩阻塞
+// 压缩先写到 xxx.log.gz.tmp，完成后再改名，目录中出现的 .gz 文件都是完整的
+class gzipRollSink : public logSink {
+private:
+    std::string __base_name; // {./log/base-}xxx.log
+    std::ofstream __ofs;
+    std::string __cur_name; // 当前正在写的文件
+    size_t __max_size; // 滚动的大小阈值
+    size_t __cur_fsize;
+    size_t __name_cnt; // 文件名计数器
+    int __level; // 压缩等级 1~9
+    fileSyncer __syncer;
+    // 以下成员受 __mtx 保护
+    std::mutex __mtx;
+    std::condition_variable __cond;
+    std::deque<std::string> __pending; // 等待压缩的文件
+    compressStats __stats;
+    bool __busy; // 后台线程正在压缩文件
+    bool __stop;
+    std::thread __compress_thread; //
+public:
+    gzipRollSink(const std::string& base_name, size_t max_size, int level = DEFAULT_GZIP_LEVEL)
+        : __base_name(base_name)
+        , __max_size(max_size)
+        , __cur_fsize(0)
+        , __name_cnt(0)
+        , __level(level)
+        , __busy(false)
+        , __stop(false) {
+        assert(__level >= 1 && __level <= 9);
+        util::File::createDirectory(util::File::path(base_name));
+        openFile();
+        __compress_thread = std::thread(&gzipRollSink::threadEntry, this);
+    }
+    ~gzipRollSink() {
+        // 最后一个文件也压缩掉，后台线程处理完队列中所有文件后退出
+        __ofs.close();
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            if (__cur_fsize > 0)
+                __pending.push_back(__cur_name);
+            else
+                remove(__cur_name.c_str());
+            __stop = true;
+        }
+        __cond.notify_all();
+        if (__compress_thread.joinable())
+            __compress_thread.join();
+    }
+    void log(const char* data, size_t len) {
+        if (__cur_fsize >= __max_size) {
+            __ofs.close();
+            if (__flush_policy.__sync)
+                __syncer.sync();
+            {
+                std::unique_lock<std::mutex> lock(__mtx);
+                __pending.push_back(__cur_name);
+            }
+            __cond.notify_all();
+            openFile();
+            __rolls.fetch_add(1, std::memory_order_relaxed);
+        }
+        __ofs.write(data, len);
+        assert(__ofs.good());
+        __cur_fsize += len;
+    }
+    void flush() { __ofs.flush(); }
+    void sync() { __syncer.sync(); } // 只对正在写的文件，压缩后的文件由后台线程写出
+    bool nextWriteStartsFile() const { return __cur_fsize >= __max_size; }
+    compressStats stats() {
+        std::unique_lock<std::mutex> lock(__mtx);
+        return __stats;
+    }
+    // 等待已经滚动出去的文件全部压缩完成（不包括正在写的文件）
+    void waitCompressed() {
+        std::unique_lock<std::mutex> lock(__mtx);
+        __cond.wait(lock, [&]() { return __pending.empty() && !__busy; });
+    } //
+private:
+    std::string createNewFile() {
+        // 获取系统时间，以时间来构造文件名扩展名
+        time_t t = util::Date::now();
+        struct tm lt;
+        localtime_r(&t, &lt);
+        std::stringstream file_name;
+        file_name << __base_name;
+        file_name << lt.tm_year + 1900;
+        file_name << lt.tm_mon + 1;
+        file_name << lt.tm_mday;
+        file_name << lt.tm_hour;
+        file_name << lt.tm_min;
+        file_name << lt.tm_sec;
+        file_name << "-";
+        file_name << __name_cnt++;
+        file_name << ".log";
+        return file_name.str();
+    }
+    void openFile() {
+        __cur_name = createNewFile();
+        __ofs.open(__cur_name, std::ios::binary | std::ios::trunc);
+        assert(__ofs.is_open());
+        __syncer.reset(__cur_name);
+        __cur_fsize = 0;
+    }
+    // 把 src 压缩成 src.gz，成功后删除 src
+    bool compressFile(const std::string& src, size_t& raw_bytes, size_t& compressed_bytes) {
+        FILE* in = fopen(src.c_str(), "rb");
+        if (in == nullptr)
+            return false;
+        std::string dst = src + ".gz", tmp = dst + ".tmp";
+        char mode[] = { 'w', 'b', (char)('0' + __level), '\0' };
+        gzFile out = gzopen(tmp.c_str(), mode);
+        if (out == nullptr) {
+            fclose(in);
+            return false;
+        }
+        std::vector<char> chunk(GZIP_CHUNK_SIZE);
+        bool ok = true;
+        raw_bytes = 0;
+        size_t n = 0;
+        while ((n = fread(chunk.data(), 1, chunk.size(), in)) > 0) {
+            if (gzwrite(out, chunk.data(), (unsigned)n) != (int)n) {
+                ok = false;
+                break;
+            }
+            raw_bytes += n;
+        }
+        fclose(in);
+        if (gzclose(out) != Z_OK || !ok) {
+            remove(tmp.c_str());
+            return false;
+        }
+        struct stat st;
+        compressed_bytes = stat(tmp.c_str(), &st) == 0 ? st.st_size : 0;
+        if (rename(tmp.c_str(), dst.c_str()) != 0) {
+            remove(tmp.c_str());
+            return false;
+        }
+        remove(src.c_str());
+        return true;
+    } // 失败时保留原文件
+    void threadEntry() {
+        while (true) {
+            std::string src;
+            {
+                std::unique_lock<std::mutex> lock(__mtx);
+                __cond.wait(lock, [&]() { return __stop || !__pending.empty(); });
+                if (__pending.empty())
+                    break; // __stop 并且队列已空
+                src = __pending.front();
+                __pending.pop_front();
+                __busy = true;
+            }
+            size_t raw_bytes = 0, compressed_bytes = 0;
+            auto start = std::chrono::steady_clock::now();
+            bool ok = compressFile(src, raw_bytes, compressed_bytes);
+            std::chrono::duration<double> cost = std::chrono::steady_clock::now() - start;
+            std::unique_lock<std::mutex> lock(__mtx);
+            if (ok) {
+                __stats.__files++;
+                __stats.__raw_bytes += raw_bytes;
+                __stats.__compressed_bytes += compressed_bytes;
+                __stats.__seconds += cost.count();
+            }
+            __busy = false;
+            __cond.notify_all();
+        }
+    }
+};
+} // namespace ffengc_log
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_LOG_STREAM__
+#define __YUFC_LOG_STREAM__
+
+#include "util.hpp"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace ffengc_log {
+#define LOG_STREAM_SIZE (4 * 1024)
+// 格式化用的字符缓冲区
+// 先使用内置的固定数组，放不下时才切换到 __overflow，__overflow 的容量会保留下来复用
+// 因此作为线程本地变量反复使用时，稳态下不会有堆内存分配
+class logStream {
+private:
+    char __fixed[LOG_STREAM_SIZE];
+    std::string __overflow;
+    char* __data;
+    size_t __size;
+    size_t __cap; //
+public:
+    logStream()
+        : __data(__fixed)
+        , __size(0)
+        , __cap(LOG_STREAM_SIZE) { }
+    logStream(const logStream&) = delete;
+    logStream& operator=(const logStream&) = delete;
+    char* data() { return __data; }
+    const char* data() const { return __data; }
+    size_t size() const { return __size; }
+    bool empty() const { return __size == 0; }
+    util::strView view() const { return util::strView(__data, __size); }
+    void clear() {
+        __data = __fixed;
+        __size = 0;
+        __cap = LOG_STREAM_SIZE;
+    } // 回到固定数组，__overflow 的容量不释放
+    char* reserve(size_t len) {
+        if (__size + len > __cap)
+            grow(__size + len);
+        return __data + __size;
+    } // 返回至少可写 len 字节的位置，写完后调用 commit
+    void commit(size_t len) { __size += len; }
+    void append(const char* data, size_t len) {
+        memcpy(reserve(len), data, len);
+        __size += len;
+    }
+    void append(const util::strView& sv) { append(sv.data(), sv.size()); }
+    void append(const char* str) { append(str, strlen(str)); }
+    void append(char c) {
+        *reserve(1) = c;
+        __size += 1;
+    }
+    void appendUnsigned(unsigned long long value) {
+        static const char digits[] = "00010203040506070809"
+                                     "10111213141516171819"
+                                     "20212223242526272829"
+                                     "30313233343536373839"
+                                     "40414243444546474849"
+                                     "50515253545556575859"
+                                     "60616263646566676869"
+                                     "70717273747576777879"
+                                     "80818283848586878889"
+                                     "90919293949596979899";
+        char tmp[24];
+        char* end = tmp + sizeof(tmp);
+        char* p = end;
+        // 每次处理两位数字，除法次数减半
+        while (value >= 100) {
+            unsigned idx = (value % 100) * 2;
+            value /= 100;
+            *--p = digits[idx + 1];
+            *--p = digits[idx];
+        }
+        if (value >= 10) {
+            *--p = digits[value * 2 + 1];
+            *--p = digits[value * 2];
+        } else
+            *--p = '0' + value;
+        append(p, end - p);
+    } // 整数转字符串，不经过 iostream
+    void appendv(const char* fmt, va_list ap) {
+        va_list cp;
+        va_copy(cp, ap);
+        size_t avail = __cap - __size;
+        int ret = vsnprintf(__data + __size, avail, fmt, cp);
+        va_end(cp);
+        if (ret < 0)
+            return;
+        if ((size_t)ret >= avail) {
+            // 放不下，扩容后重新格式化一次
+            reserve(ret + 1);
+            vsnprintf(__data + __size, ret + 1, fmt, ap);
+        }
+        __size += ret;
+    } // printf风格格式化
+    void appendf(const char* fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        appendv(fmt, ap);
+        va_end(ap);
+    } //
+private:
+    void grow(size_t need) {
+        size_t new_cap = __cap * 2;
+        while (new_cap < need)
+            new_cap *= 2;
+        if (__data == __fixed) {
+            if (__overflow.size() < new_cap)
+                __overflow.resize(new_cap);
+            memcpy(&__overflow[0], __fixed, __size);
+        } else
+            __overflow.resize(new_cap);
+        __data = &__overflow[0];
+        __cap = __overflow.size();
+    }
+};
+} // namespace ffengc_log
+
+#endif
@@ -7,12 +7,21 @@
 #ifndef __YUFC_LOGGER__
 #define __YUFC_LOGGER__
 
+#include "argFormat.hpp"
 #include "asyncLooper.hpp"
+#include "binary.hpp"
 #include "format.hpp"
 #include "level.hpp"
+#include "looperPool.hpp"
+#include "metrics.hpp"
+#include "rateLimit.hpp"
 #include "sink.hpp"
+#include "sinkWorker.hpp"
+#include "socketSink.hpp"
 #include "util.hpp"
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <mutex>
 #include <stdarg.h>
 
@@ -23,7 +32,9 @@ protected:
     std::atomic<logLevel::value> __limit_level; // 因为需要多次访问，所以用原子类型
     formatter::ptr __formatter; // 格式化器
     std::vector<logSink::ptr> __sinks; // 落地方向，可能有个
-    std::mutex __mtx; //
+    std::mutex __mtx;
+    shardedCounter __records; // 通过了等级过滤的日志条数
+    limiterRegistry::ptr __limiters; // 向这个日志器输出的限流调用点 //
 public:
     using ptr = std::shared_ptr<logger>;
     logger(const std::string& logger_name,
@@ -33,134 +44,243 @@ public:
         : __logger_name(logger_name)
         , __limit_level(level)
         , __formatter(ft)
-        , __sinks(sinks.begin(), sinks.end()) { }
-    void debug(const std::string& file, size_t line, const std::string& fmt, ...) {
-        auto function_log_level = logLevel::value::DEBUG;
-        // 通过传入的参数，构造一个日志消息对象
-        // 1. 判断当前日志是否达到了输出等级
-        if (function_log_level < __limit_level)
+        , __sinks(sinks.begin(), sinks.end())
+        , __limiters(std::make_shared<limiterRegistry>()) { }
+    bool shouldLog(logLevel::value level) const {
+        return level >= __limit_level.load(std::memory_order_relaxed);
+    } // 宏在计算参数之前先调用它，被过滤的日志只需要一次原子读
+    logLevel::value level() const { return __limit_level.load(std::memory_order_relaxed); }
+    void setLevel(logLevel::value level) { __limit_level.store(level, std::memory_order_relaxed); } // 运行时调整输出等级
+    void debug(const char* file, size_t line, const char* fmt, ...) {
+        if (!shouldLog(logLevel::value::DEBUG))
             return;
-        // 2. 对不定参消息组织成一个字符串
         va_list ap;
         va_start(ap, fmt);
-        char* res;
-        int ret = vasprintf(&res, fmt.c_str(), ap);
-        if (ret == -1) {
-            std::cerr << "vasprintf failed!" << std::endl;
+        logv(logLevel::value::DEBUG, file, line, fmt, ap);
+        va_end(ap);
+    }
+    void info(const char* file, size_t line, const char* fmt, ...) {
+        if (!shouldLog(logLevel::value::INFO))
             return;
-        }
+        va_list ap;
+        va_start(ap, fmt);
+        logv(logLevel::value::INFO, file, line, fmt, ap);
         va_end(ap);
-        // 3. 构造logMessage对象
-        logMessage msg(function_log_level, line, file, __logger_name, res);
-        // 4. 通过格式化工具对 logMessage 进行格式化，得到格式化后的日志字符串
-        std::stringstream ss;
-        __formatter->format(ss, msg);
-        // 5. 落地
-        log(ss.str().c_str(), ss.str().size());
-        free(res); // 不要忘记了
     }
-    void info(const std::string& file, size_t line, const std::string& fmt, ...) {
-        auto function_log_level = logLevel::value::INFO;
-        // 通过传入的参数，构造一个日志消息对象
-        // 1. 判断当前日志是否达到了输出等级
-        if (function_log_level < __limit_level)
+    void warning(const char* file, size_t line, const char* fmt, ...) {
+        if (!shouldLog(logLevel::value::WARNING))
             return;
-        // 2. 对不定参消息组织成一个字符串
         va_list ap;
         va_start(ap, fmt);
-        char* res;
-        int ret = vasprintf(&res, fmt.c_str(), ap);
-        if (ret == -1) {
-            std::cerr << "vasprintf failed!" << std::endl;
+        logv(logLevel::value::WARNING, file, line, fmt, ap);
+        va_end(ap);
+    }
+    void error(const char* file, size_t line, const char* fmt, ...) {
+        if (!shouldLog(logLevel::value::ERROR))
             return;
-        }
+        va_list ap;
+        va_start(ap, fmt);
+        logv(logLevel::value::ERROR, file, line, fmt, ap);
         va_end(ap);
-        // 3. 构造logMessage对象
-        logMessage msg(function_log_level, line, file, __logger_name, res);
-        // 4. 通过格式化工具对 logMessage 进行格式化，得到格式化后的日志字符串
-        std::stringstream ss;
-        __formatter->format(ss, msg);
-        // 5. 落地
-        log(ss.str().c_str(), ss.str().size());
-        free(res); // 不要忘记了
     }
-    void warning(const std::string& file, size_t line, const std::string& fmt, ...) {
-        auto function_log_level = logLevel::value::WARNING;
-        // 通过传入的参数，构造一个日志消息对象
-        // 1. 判断当前日志是否达到了输出等级
-        if (function_log_level < __limit_level)
+    void fatal(const char* file, size_t line, const char* fmt, ...) {
+        if (!shouldLog(logLevel::value::FATAL))
             return;
-        // 2. 对不定参消息组织成一个字符串
         va_list ap;
         va_start(ap, fmt);
-        char* res;
-        int ret = vasprintf(&res, fmt.c_str(), ap);
-        if (ret == -1) {
-            std::cerr << "vasprintf failed!" << std::endl;
+        logv(logLevel::value::FATAL, file, line, fmt, ap);
+        va_end(ap);
+    }
+    // 带键值对的接口，例如 info(__FILE__, __LINE__, { { "user", 42 }, { "ip", ip } }, "login %s", name)
+    // 键值对由结构化格式化器（jsonFormatter / logfmtFormatter）或者模式中的 %k 输出
+    void debug(const char* file, size_t line, logFields fields, const char* fmt, ...) {
+        if (!shouldLog(logLevel::value::DEBUG))
             return;
-        }
+        va_list ap;
+        va_start(ap, fmt);
+        logvFields(logLevel::value::DEBUG, file, line, fields, fmt, ap);
         va_end(ap);
-        // 3. 构造logMessage对象
-        logMessage msg(function_log_level, line, file, __logger_name, res);
-        // 4. 通过格式化工具对 logMessage 进行格式化，得到格式化后的日志字符串
-        std::stringstream ss;
-        __formatter->format(ss, msg);
-        // 5. 落地
-        log(ss.str().c_str(), ss.str().size());
-        free(res); // 不要忘记了
     }
-    void error(const std::string& file, size_t line, const std::string& fmt, ...) {
-        auto function_log_level = logLevel::value::ERROR;
-        // 通过传入的参数，构造一个日志消息对象
-        // 1. 判断当前日志是否达到了输出等级
-        if (function_log_level < __limit_level)
+    void info(const char* file, size_t line, logFields fields, const char* fmt, ...) {
+        if (!shouldLog(logLevel::value::INFO))
             return;
-        // 2. 对不定参消息组织成一个字符串
         va_list ap;
         va_start(ap, fmt);
-        char* res;
-        int ret = vasprintf(&res, fmt.c_str(), ap);
-        if (ret == -1) {
-            std::cerr << "vasprintf failed!" << std::endl;
+        logvFields(logLevel::value::INFO, file, line, fields, fmt, ap);
+        va_end(ap);
+    }
+    void warning(const char* file, size_t line, logFields fields, const char* fmt, ...) {
+        if (!shouldLog(logLevel::value::WARNING))
             return;
-        }
+        va_list ap;
+        va_start(ap, fmt);
+        logvFields(logLevel::value::WARNING, file, line, fields, fmt, ap);
         va_end(ap);
-        // 3. 构造logMessage对象
-        logMessage msg(function_log_level, line, file, __logger_name, res);
-        // 4. 通过格式化工具对 logMessage 进行格式化，得到格式化后的日志字符串
-        std::stringstream ss;
-        __formatter->format(ss, msg);
-        // 5. 落地
-        log(ss.str().c_str(), ss.str().size());
-        free(res); // 不要忘记了
     }
-    void fatal(const std::string& file, size_t line, const std::string& fmt, ...) {
-        auto function_log_level = logLevel::value::FATAL;
-        // 通过传入的参数，构造一个日志消息对象
-        // 1. 判断当前日志是否达到了输出等级
-        if (function_log_level < __limit_level)
+    void error(const char* file, size_t line, logFields fields, const char* fmt, ...) {
+        if (!shouldLog(logLevel::value::ERROR))
             return;
-        // 2. 对不定参消息组织成一个字符串
         va_list ap;
         va_start(ap, fmt);
-        char* res;
-        int ret = vasprintf(&res, fmt.c_str(), ap);
-        if (ret == -1) {
-            std::cerr << "vasprintf failed!" << std::endl;
+        logvFields(logLevel::value::ERROR, file, line, fields, fmt, ap);
+        va_end(ap);
+    }
+    void fatal(const char* file, size_t line, logFields fields, const char* fmt, ...) {
+        if (!shouldLog(logLevel::value::FATAL))
             return;
-        }
+        va_list ap;
+        va_start(ap, fmt);
+        logvFields(logLevel::value::FATAL, file, line, fields, fmt, ap);
         va_end(ap);
-        // 3. 构造logMessage对象
-        logMessage msg(function_log_level, line, file, __logger_name, res);
+    }
+    // {} 风格的接口，格式化字符串需要用 LOG_FMT 包装，例如 info(__FILE__, __LINE__, LOG_FMT("x={}"), x)
+    template <size_t N, typename... Args>
+    void debug(const char* file, size_t line, const fmtString<N>& fmt, const Args&... args) {
+        checkArgs<N, sizeof...(Args)>();
+        if (shouldLog(logLevel::value::DEBUG))
+            logt(logLevel::value::DEBUG, file, line, fmt.str(), args...);
+    }
+    template <size_t N, typename... Args>
+    void info(const char* file, size_t line, const fmtString<N>& fmt, const Args&... args) {
+        checkArgs<N, sizeof...(Args)>();
+        if (shouldLog(logLevel::value::INFO))
+            logt(logLevel::value::INFO, file, line, fmt.str(), args...);
+    }
+    template <size_t N, typename... Args>
+    void warning(const char* file, size_t line, const fmtString<N>& fmt, const Args&... args) {
+        checkArgs<N, sizeof...(Args)>();
+        if (shouldLog(logLevel::value::WARNING))
+            logt(logLevel::value::WARNING, file, line, fmt.str(), args...);
+    }
+    template <size_t N, typename... Args>
+    void error(const char* file, size_t line, const fmtString<N>& fmt, const Args&... args) {
+        checkArgs<N, sizeof...(Args)>();
+        if (shouldLog(logLevel::value::ERROR))
+            logt(logLevel::value::ERROR, file, line, fmt.str(), args...);
+    }
+    template <size_t N, typename... Args>
+    void fatal(const char* file, size_t line, const fmtString<N>& fmt, const Args&... args) {
+        checkArgs<N, sizeof...(Args)>();
+        if (shouldLog(logLevel::value::FATAL))
+            logt(logLevel::value::FATAL, file, line, fmt.str(), args...);
+    }
+protected:
+    // 每个线程复用的格式化缓冲区
+    struct formatContext {
+        logStream __payload; // 日志主体
+        logStream __out; // 格式化后的整条日志
+        const logField* __fields = nullptr; // 本条日志附加的键值对
+        size_t __field_cnt = 0;
+        bool __busy = false; // sink 中又写日志（嵌套调用）时不能复用
+    };
+    // 优先使用线程本地的格式化缓冲区，sink 中又写日志（嵌套调用）时临时申请一个
+    class contextGuard {
+    private:
+        std::unique_ptr<formatContext> __heap;
+        formatContext* __ctx; //
+    public:
+        contextGuard() {
+            static thread_local formatContext tls_ctx;
+            __ctx = &tls_ctx;
+            if (tls_ctx.__busy) {
+                __heap.reset(new formatContext());
+                __ctx = __heap.get();
+            }
+            __ctx->__busy = true;
+            __ctx->__fields = nullptr;
+            __ctx->__field_cnt = 0;
+        }
+        ~contextGuard() { __ctx->__busy = false; }
+        formatContext& get() { return *__ctx; }
+    };
+    template <size_t N, size_t ArgCount>
+    static void checkArgs() {
+        static_assert(N != fmtDetail::FMT_INVALID, "invalid format string: unmatched '{' or '}'");
+        static_assert(N == ArgCount, "the number of {} placeholders does not match the number of arguments");
+    }
+    virtual void logv(logLevel::value level, const char* file, size_t line, const char* fmt, va_list ap) {
+        // 1. 判断当前日志是否达到了输出等级
+        if (level < __limit_level)
+            return;
+        // 2. 对不定参消息直接格式化到缓冲区中，不再使用 vasprintf 申请内存
+        __records.add();
+        contextGuard guard;
+        formatContext& ctx = guard.get();
+        ctx.__payload.clear();
+        ctx.__payload.appendv(fmt, ap);
+        logPayload(ctx, level, file, line);
+    }
+    void logvFields(logLevel::value level, const char* file, size_t line, logFields fields, const char* fmt, va_list ap) {
+        __records.add();
+        contextGuard guard;
+        formatContext& ctx = guard.get();
+        ctx.__payload.clear();
+        ctx.__payload.appendv(fmt, ap);
+        ctx.__fields = fields.begin();
+        ctx.__field_cnt = fields.size();
+        logPayload(ctx, level, file, line);
+    }
+    template <typename... Args>
+    void logt(logLevel::value level, const char* file, size_t line, const char* fmt, const Args&... args) {
+        __records.add();
+        contextGuard guard;
+        formatContext& ctx = guard.get();
+        ctx.__payload.clear();
+        fmtDetail::formatTo(ctx.__payload, fmt, args...);
+        logPayload(ctx, level, file, line);
+    }
+    virtual void logPayload(formatContext& ctx, logLevel::value level, const char* file, size_t line) {
+        // 3. 构造logMessage对象，只引用字符串，不拷贝
+        logMessage msg(level, line, file, __logger_name, ctx.__payload.view());
+        msg.__fields = ctx.__fields;
+        msg.__field_cnt = ctx.__field_cnt;
         // 4. 通过格式化工具对 logMessage 进行格式化，得到格式化后的日志字符串
-        std::stringstream ss;
-        __formatter->format(ss, msg);
+        ctx.__out.clear();
+        __formatter->format(ctx.__out, msg);
         // 5. 落地
-        log(ss.str().c_str(), ss.str().size());
-        free(res); // 不要忘记了
+        logRecord(msg, ctx.__out.data(), ctx.__out.size());
+    }
+    virtual void logRecord(const logMessage& /*msg*/, const char* data, size_t len) { log(data, len); } // 需要日志元数据的日志器重写它
+    bool sinksWantRecords() const {
+        for (const auto& e : __sinks)
+            if (e->wantsRecords() || e->getFlushPolicy().__level != logLevel::value::OFF)
+                return true;
+        return false;
+    } // 按等级刷新的 sink 也需要知道每条日志的等级
+    size_t flushTickMs() const {
+        size_t ms = 0;
+        for (const auto& e : __sinks) {
+            size_t interval = e->getFlushPolicy().__interval_ms;
+            if (interval > 0 && (ms == 0 || interval < ms))
+                ms = interval;
+        }
+        return ms;
+    } // 异步线程空闲时检查按时间刷新的间隔，0表示不需要
+    void flushIdleSinks() {
+        for (const auto& e : __sinks)
+            e->flushIfDue();
+    }
+    static size_t idleTickMs(size_t flush_ms) {
+        return flush_ms > 0 && flush_ms < DEFAULT_SUPPRESS_REPORT_MS ? flush_ms : DEFAULT_SUPPRESS_REPORT_MS;
+    } // 异步线程空闲时至少每 DEFAULT_SUPPRESS_REPORT_MS 检查一次限流汇总
+    void logFormat(logLevel::value level, const char* file, size_t line, const char* fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        logv(level, file, line, fmt, ap);
+        va_end(ap);
     } //
 public:
-    const std::string& name() { return __logger_name; } //
+    const std::string& name() { return __logger_name; }
+    const limiterRegistry::ptr& limiters() { return __limiters; } // 限流宏把调用点注册到这里
+    virtual loggerMetrics metrics() {
+        loggerMetrics m;
+        m.__name = __logger_name;
+        m.__type = "sync";
+        m.__records = __records.value();
+        for (const auto& e : __sinks)
+            m.__sinks.push_back(e->metrics());
+        return m;
+    } // 运行时统计的快照 //
 protected:
     virtual void log(const char* data, size_t len) = 0; // 实际的落地由它来完成
 };
@@ -172,7 +292,17 @@ private:
         if (__sinks.empty())
             return;
         for (const auto& e : __sinks)
-            e->log(data, len);
+            e->write(data, len);
+    }
+    void logRecord(const logMessage& msg, const char* data, size_t len) override {
+        std::unique_lock<std::mutex> lock(__mtx);
+        recordView view = { data, len, msg.__level, msg.timeNs() };
+        for (const auto& e : __sinks) {
+            if (e->wantsRecords())
+                e->writeRecords(&view, 1);
+            else
+                e->write(data, len, msg.__level);
+        }
     } //
 public:
     syncLogger(const std::string& logger_name,
@@ -180,34 +310,447 @@ public:
         formatter::ptr& ft,
         const std::vector<logSink::ptr>& sinks)
         : logger(logger_name, level, ft, sinks) { }
+    ~syncLogger() {
+        // 同步日志器没有空闲的线程，调用点之后不再输出时，剩下的汇总在析构时输出
+        std::vector<suppressedReport> reports;
+        __limiters->collect(true, reports);
+        for (const auto& e : reports)
+            logFormat(e.__level, e.__file, e.__line, SUPPRESS_REPORT_FMT, (unsigned long long)e.__count);
+    }
 };
 /* 异步日志器 */
 class asyncLogger : public logger {
 private:
+    // 每个 sink 独立的落地线程（可选），声明在 __looper 之前，保证 looper 先停止
+    // sink 线程持有 looper 借出的块，析构函数中先停止 sink 线程，再析构 looper
+    bufferRecycler::ptr __recycler;
+    std::vector<sinkWorker::ptr> __sink_workers;
+    std::vector<struct iovec> __iov; // 只在异步线程中使用
+    std::vector<recordView> __views; // 只在异步线程中使用
+    bool __track_records; // 有 sink 需要逐条处理日志
+    bool __lazy_format; // 生产者只写入日志主体和元数据，格式化在异步线程中完成
+    logStream __text; // 只在异步线程中使用
+    buffer __rendered; // 只在异步线程中使用，延迟格式化的结果
+    std::vector<logField> __lazy_fields; // 只在异步线程中使用，解码出的键值对
+    std::vector<buffer*> __batch; // 只在异步线程中使用，本轮交给 sink 的缓冲块
+    overflowConfig __overflow;
+    size_t __reported_drops; // 以下成员只在异步线程中使用，已经输出过统计的丢弃条数
+    std::chrono::steady_clock::time_point __last_report;
+    logStream __report_text;
+    buffer __report;
+    std::vector<suppressedReport> __suppressed_reports; //
     asyncLooper::ptr __looper; //
 private:
+    // 延迟格式化模式下写入缓冲区的记录: lazyHeader | 日志主体 | 键值对（可选）
+    struct lazyHeader {
+        uint32_t __size; // 日志主体的长度
+        uint32_t __fields_size; // 编码后的键值对的长度，0表示没有
+        uint32_t __line;
+        int64_t __time_ns;
+        const char* __file; // 必须是字符串常量（__FILE__）
+        pid_t __tid;
+        uint32_t __name_id; // 写日志的线程可能在格式化之前退出，名字按编号保存
+        logLevel::value __level;
+    };
     void log(const char* data, size_t len) {
         __looper->push(data, len);
     } // 将数据写入缓冲区
-    void logSink(buffer& buf) {
+    void logRecord(const logMessage& msg, const char* data, size_t len) override {
+        __looper->push(data, len, msg.__level, msg.timeNs());
+    }
+    void logPayload(formatContext& ctx, logLevel::value level, const char* file, size_t line) override {
+        if (!__lazy_format) {
+            logger::logPayload(ctx, level, file, line);
+            return;
+        }
+        // 生产者只拷贝日志主体，不运行格式化器
+        lazyHeader hdr;
+        hdr.__size = ctx.__payload.size();
+        hdr.__fields_size = 0;
+        hdr.__line = line;
+        hdr.__time_ns = util::Date::nowNs();
+        hdr.__file = file;
+        hdr.__tid = util::Thread::id();
+        hdr.__name_id = util::Thread::nameId();
+        hdr.__level = level;
+        ctx.__out.clear();
+        ctx.__out.append((const char*)&hdr, sizeof(hdr));
+        ctx.__out.append(ctx.__payload.data(), ctx.__payload.size());
+        if (ctx.__field_cnt > 0) {
+            structured::encodeFields(ctx.__out, ctx.__fields, ctx.__field_cnt); // 字符串拷贝进缓冲区
+            hdr.__fields_size = ctx.__out.size() - sizeof(hdr) - hdr.__size;
+            memcpy(ctx.__out.data(), &hdr, sizeof(hdr));
+        }
+        __looper->push(ctx.__out.data(), ctx.__out.size(), level, hdr.__time_ns);
+    }
+    void renderLazy(std::vector<buffer*>& buffers) {
+        __text.clear();
+        __rendered.reset();
+        for (auto buf : buffers) {
+            const char* p = buf->begin();
+            const char* end = p + buf->readableSize();
+            lazyHeader hdr;
+            while ((size_t)(end - p) >= sizeof(hdr)) {
+                memcpy(&hdr, p, sizeof(hdr));
+                util::strView payload(p + sizeof(hdr), hdr.__size);
+                const char* fields = p + sizeof(hdr) + hdr.__size;
+                p = fields + hdr.__fields_size;
+                logMessage msg(hdr.__level, hdr.__line, hdr.__file, __logger_name, payload);
+                if (hdr.__fields_size > 0) {
+                    structured::decodeFields(fields, __lazy_fields);
+                    msg.__fields = __lazy_fields.data();
+                    msg.__field_cnt = __lazy_fields.size();
+                }
+                msg.__ctime = (time_t)(hdr.__time_ns / util::Date::NS_PER_SEC);
+                msg.__cnsec = (long)(hdr.__time_ns % util::Date::NS_PER_SEC);
+                msg.__tid = hdr.__tid;
+                msg.__name_id = hdr.__name_id;
+                size_t offset = __text.size();
+                __formatter->format(__text, msg);
+                if (__track_records)
+                    __rendered.__records.push_back({ offset, __text.size() - offset, hdr.__level, hdr.__time_ns });
+            }
+        }
+        __rendered.push(__text.data(), __text.size());
+    } // 在异步线程中把本轮所有记录格式化到 __rendered 中
+    void logSink(std::vector<buffer*>& buffers) {
         if (__sinks.empty())
             return;
-        for (const auto& e : __sinks)
-            e->log(buf.begin(), buf.readableSize());
+        if (__lazy_format) {
+            renderLazy(buffers);
+            __batch.assign(1, &__rendered);
+        } else
+            __batch.assign(buffers.begin(), buffers.end());
+        __report.reset();
+        if (reportDrops())
+            __batch.push_back(&__report);
+        deliver(__batch);
+    }
+    void idleTick() {
+        if (__sink_workers.empty())
+            flushIdleSinks(); // 有独立的 sink 线程时由它们自己检查
+        __report.reset();
+        if (!__sinks.empty() && reportSuppressed(false)) {
+            __batch.assign(1, &__report);
+            deliver(__batch);
+        }
+    } // 异步线程空闲时调用
+    bool reportDrops(bool final = false) {
+        // 有日志被丢弃时，在日志中输出一条统计，最多每 __report_ms 毫秒一条，final 为 true 时不限频
+        if (__overflow.__report_ms == 0)
+            return false;
+        size_t dropped = __looper->droppedCount();
+        if (dropped == __reported_drops)
+            return false;
+        auto now = std::chrono::steady_clock::now();
+        if (!final && __reported_drops > 0 && now - __last_report < std::chrono::milliseconds(__overflow.__report_ms))
+            return false;
+        logStream payload;
+        payload.appendf("%zu log records dropped because the async buffer is full (%zu in total)", dropped - __reported_drops, dropped);
+        appendReport(payload, logLevel::value::WARNING, __FILE__, __LINE__);
+        __reported_drops = dropped;
+        __last_report = now;
+        return true;
+    }
+    bool reportSuppressed(bool final) {
+        // 限流调用点之后不再输出时，由异步线程输出剩下的汇总；不经过 looper，缓冲区满时也不会等待自己
+        __suppressed_reports.clear();
+        __limiters->collect(final, __suppressed_reports);
+        logStream payload;
+        for (const auto& e : __suppressed_reports) {
+            payload.clear();
+            payload.appendf(SUPPRESS_REPORT_FMT, (unsigned long long)e.__count);
+            appendReport(payload, e.__level, e.__file, e.__line);
+        }
+        return !__suppressed_reports.empty();
+    }
+    void appendReport(const logStream& payload, logLevel::value level, const char* file, size_t line) {
+        logMessage msg(level, line, file, __logger_name, payload.view());
+        __report_text.clear();
+        __formatter->format(__report_text, msg);
+        if (__track_records)
+            __report.pushRecord(__report_text.data(), __report_text.size(), msg.__level, msg.timeNs());
+        else
+            __report.push(__report_text.data(), __report_text.size());
+    } // 调用者先清空 __report
+    void deliver(std::vector<buffer*>& buffers) {
+        if (!__sink_workers.empty()) {
+            // 内存池的块直接借给 sink 线程，落地之前一直计入内存上限；其他缓冲区交换到回收器的缓冲区中
+            // 所有 sink 线程引用同一份数据，不拷贝
+            for (auto buf : buffers) {
+                std::shared_ptr<buffer> shared;
+                if (buf != &__rendered && buf != &__report)
+                    shared = __looper->lend(buf);
+                if (shared == nullptr) {
+                    shared = __recycler->acquire();
+                    shared->swap(*buf);
+                }
+                for (const auto& e : __sink_workers)
+                    e->push(shared);
+            }
+            return;
+        }
+        // 本轮取到的所有缓冲块一起交给 sink
+        __iov.clear();
+        __views.clear();
+        for (auto buf : buffers) {
+            if (!buf->empty())
+                __iov.push_back({ (void*)buf->begin(), buf->readableSize() });
+            if (__track_records)
+                appendRecordViews(__views, *buf);
+        }
+        logLevel::value level = logLevel::value::UNKNOW;
+        for (const auto& e : __views)
+            level = std::max(level, e.__level);
+        for (const auto& e : __sinks) {
+            if (e->wantsRecords())
+                e->writeRecords(__views.data(), __views.size());
+            else
+                e->writeChunks(__iov.data(), __iov.size(), level);
+        }
     } // 把缓冲区中的数据实际落地
+    static bufferPoolConfig workerPoolConfig(asyncType looper_type, const bufferPoolConfig& config, size_t sink_queue_depth) {
+        if (sink_queue_depth == 0 || config.__max_bytes > 0 || looper_type != asyncType::ASYNC_SAFE)
+            return config;
+        // sink 线程持有的块也计入上限：队列中最多积压 sink_queue_depth 块，正在写入的一批最多也有这么多
+        // 默认上限再加上生产者和异步线程各一块，慢的 sink 不会让生产者等待其他 sink
+        bufferPoolConfig c = config;
+        c.__max_bytes = (2 * sink_queue_depth + 2) * (c.__chunk_size == 0 ? DEFAULT_BUFFER_SIZE : c.__chunk_size);
+        return c;
+    }
 public:
     asyncLogger(const std::string& logger_name,
         logLevel::value level,
         formatter::ptr& ft,
         const std::vector<logSink::ptr>& sinks,
-        asyncType looper_type)
+        asyncType looper_type,
+        size_t sink_queue_depth = 0, // 大于0表示每个 sink 使用独立的线程，队列最多积压这么多个缓冲区
+        const bufferPoolConfig& pool_config = bufferPoolConfig(),
+        bool lazy_format = false,
+        const overflowConfig& overflow = overflowConfig(),
+        const looperScheduler::ptr& scheduler = nullptr, // 不为空时使用共享的工作线程，不创建自己的线程
+        const std::vector<int>& worker_cpus = std::vector<int>()) // 不为空时异步线程只在这些CPU上运行
         : logger(logger_name, level, ft, sinks)
-        , __looper(std::make_shared<asyncLooper>(std::bind(&asyncLogger::logSink, this, std::placeholders::_1), looper_type)) { }
+        , __track_records(sinksWantRecords())
+        , __lazy_format(lazy_format)
+        , __rendered(0)
+        , __overflow(overflow)
+        , __reported_drops(0)
+        , __report(0) {
+        if (sink_queue_depth > 0) {
+            __recycler = std::make_shared<bufferRecycler>(sink_queue_depth + 2, pool_config.__chunk_size);
+            for (const auto& e : __sinks)
+                __sink_workers.push_back(std::make_shared<sinkWorker>(e, sink_queue_depth));
+        }
+        // 有独立的 sink 线程时，按时间刷新由 sink 线程自己检查
+        size_t tick_ms = idleTickMs(__sink_workers.empty() ? flushTickMs() : 0);
+        __looper = std::make_shared<asyncLooper>(batchFunctor(std::bind(&asyncLogger::logSink, this, std::placeholders::_1)), looper_type, DEFAULT_RING_SIZE, workerPoolConfig(looper_type, pool_config, sink_queue_depth), __track_records && !__lazy_format, __overflow,
+            std::bind(&asyncLogger::idleTick, this), tick_ms, scheduler, worker_cpus);
+    }
+    ~asyncLogger() {
+        __looper->stop(); // 先让异步线程把数据处理完，此后只有当前线程访问下面的成员
+        __report.reset();
+        bool reported = reportDrops(true); // 最后一次统计之后丢弃的日志
+        reported = reportSuppressed(true) || reported;
+        if (!__sinks.empty() && reported) {
+            __batch.assign(1, &__report);
+            deliver(__batch);
+        }
+        for (const auto& e : __sink_workers)
+            e->stop(); // 落地完之后借出的块都已经还给 looper
+    }
+    std::vector<size_t> sinkQueueDepths() {
+        std::vector<size_t> depths;
+        for (const auto& e : __sink_workers)
+            depths.push_back(e->depth());
+        return depths;
+    } // 每个 sink 线程当前积压的缓冲区数量，没有开启时为空
+    size_t droppedCount() { return __looper->droppedCount(); } // 因为缓冲区满了而被丢弃的日志条数
+    loggerMetrics metrics() override {
+        loggerMetrics m = logger::metrics();
+        m.__type = "async";
+        m.__has_looper = true;
+        m.__looper = __looper->metrics();
+        if (__recycler)
+            m.__looper.__allocated_bytes += __recycler->allocatedBytes(); // 交给 sink 线程的非内存池缓冲区
+        return m;
+    }
+};
+/* 二进制日志器
+ * 生产者只拷贝格式化字符串指针、文件名指针、时间戳和参数的原始字节，printf风格的格式化在异步线程中完成
+ * 格式化字符串和文件名必须是字符串常量
+ * dump 模式下不做格式化，直接把二进制数据交给 sink，之后用 tools/binlog_decode 转成文本
+ */
+class binaryLogger : public logger {
+private:
+    asyncLooper::ptr __looper;
+    bool __dump;
+    // 以下成员只在异步线程中使用
+    binary::encoder __encoder;
+    logStream __payload;
+    logStream __text;
+    std::vector<recordMeta> __metas; // __text 中每条日志的位置，__text 可能扩容，最后再转换成视图
+    std::vector<recordView> __views;
+    logLevel::value __batch_level; // 本轮日志中最高的等级
+    logStream __summary; // 限流汇总编码成的记录
+    std::vector<suppressedReport> __suppressed_reports; //
+private:
+    void logv(logLevel::value level, const char* file, size_t line, const char* fmt, va_list ap) override {
+        if (level < __limit_level)
+            return;
+        __records.add();
+        pushRecord(level, file, line, fmt, ap);
+    }
+    void pushRecord(logLevel::value level, const char* file, size_t line, const char* fmt, va_list ap) {
+        static thread_local logStream record;
+        record.clear();
+        encodeRecord(record, level, file, line, fmt, ap);
+        __looper->push(record.data(), record.size());
+    }
+    static void encodeRecord(logStream& record, logLevel::value level, const char* file, size_t line, const char* fmt, va_list ap) {
+        size_t start = record.size();
+        binary::recordHeader hdr;
+        record.reserve(sizeof(hdr));
+        record.commit(sizeof(hdr)); // 先占位，参数写完后再填记录头
+        binary::encodeArgs(record, fmt, ap);
+        hdr.__size = record.size() - start;
+        hdr.__line = line;
+        hdr.__time_ns = util::Date::nowNs();
+        hdr.__fmt = fmt;
+        hdr.__file = file;
+        hdr.__tid = util::Thread::id();
+        hdr.__name_id = util::Thread::nameId();
+        hdr.__level = level;
+        memcpy(record.data() + start, &hdr, sizeof(hdr));
+    } // 追加到 record 末尾
+    static void encodeRecordf(logStream& record, logLevel::value level, const char* file, size_t line, const char* fmt, ...) {
+        va_list ap;
+        va_start(ap, fmt);
+        encodeRecord(record, level, file, line, fmt, ap);
+        va_end(ap);
+    }
+    void logPayload(formatContext& ctx, logLevel::value level, const char* file, size_t line) override {
+        // {} 风格的接口在生产者线程中已经格式化好，作为一个字符串参数记录下来
+        // 二进制记录中只有格式化参数，附加的键值对以 " key=value" 的形式拼在主体后面
+        structured::appendLogfmtFields(ctx.__payload, ctx.__fields, ctx.__field_cnt);
+        ctx.__payload.append('\0');
+        logf(level, file, line, "%s", ctx.__payload.data());
+    }
+    void logf(logLevel::value level, const char* file, size_t line, const char* fmt, ...) {
+        // 调用者已经计过数，这里不再经过 logv
+        va_list ap;
+        va_start(ap, fmt);
+        pushRecord(level, file, line, fmt, ap);
+        va_end(ap);
+    }
+    void log(const char* /*data*/, size_t /*len*/) override { } // 二进制日志器不会产生格式化好的日志
+    void logSink(std::vector<buffer*>& buffers) {
+        beginBatch();
+        for (auto buf : buffers)
+            render(buf->begin(), buf->begin() + buf->readableSize());
+        writeBatch();
+    } // 在异步线程中格式化（或编码）并落地，本轮所有缓冲块只写一次
+    void idleTick() {
+        flushIdleSinks();
+        writeSuppressed(false);
+    } // 异步线程空闲时调用
+    void writeSuppressed(bool final) {
+        // 限流调用点之后不再输出时，由异步线程把剩下的汇总编码成记录，和普通日志一样格式化（或 dump）
+        __suppressed_reports.clear();
+        __limiters->collect(final, __suppressed_reports);
+        if (__suppressed_reports.empty() || __sinks.empty())
+            return;
+        __summary.clear();
+        for (const auto& e : __suppressed_reports)
+            encodeRecordf(__summary, e.__level, e.__file, e.__line, SUPPRESS_REPORT_FMT, (unsigned long long)e.__count);
+        beginBatch();
+        render(__summary.data(), __summary.data() + __summary.size());
+        writeBatch();
+    }
+    void beginBatch() {
+        __text.clear();
+        __metas.clear();
+        __batch_level = logLevel::value::UNKNOW;
+        if (__dump) {
+            for (const auto& e : __sinks)
+                if (e->nextWriteStartsFile())
+                    __encoder.reset(); // 滚动出的新文件也要能单独解码
+        }
+    }
+    void writeBatch() {
+        __views.clear();
+        for (const auto& e : __metas)
+            __views.push_back({ __text.data() + e.__offset, e.__size, e.__level, e.__time_ns });
+        struct iovec text = { (void*)__text.data(), __text.size() };
+        for (const auto& e : __sinks) {
+            if (e->wantsRecords() && !__dump)
+                e->writeRecords(__views.data(), __views.size());
+            else
+                e->writeChunks(&text, 1, __batch_level);
+        }
+    }
+    void render(const char* p, const char* end) {
+        binary::recordHeader hdr;
+        while ((size_t)(end - p) >= sizeof(hdr)) {
+            memcpy(&hdr, p, sizeof(hdr));
+            const char* args = p + sizeof(hdr);
+            p += hdr.__size;
+            __batch_level = std::max(__batch_level, hdr.__level);
+            if (__dump) {
+                __encoder.encode(__text, hdr, args, p - args);
+                continue;
+            }
+            __payload.clear();
+            binary::decodeArgs(__payload, hdr.__fmt, args, p);
+            logMessage msg(hdr.__level, hdr.__line, hdr.__file, __logger_name, __payload.view());
+            msg.__ctime = (time_t)(hdr.__time_ns / util::Date::NS_PER_SEC);
+            msg.__cnsec = (long)(hdr.__time_ns % util::Date::NS_PER_SEC);
+            msg.__tid = hdr.__tid;
+            msg.__name_id = hdr.__name_id;
+            size_t offset = __text.size();
+            __formatter->format(__text, msg);
+            __metas.push_back({ offset, __text.size() - offset, hdr.__level, hdr.__time_ns });
+        }
+    }
+public:
+    binaryLogger(const std::string& logger_name,
+        logLevel::value level,
+        formatter::ptr& ft,
+        const std::vector<logSink::ptr>& sinks,
+        asyncType looper_type,
+        bool dump = false,
+        const bufferPoolConfig& pool_config = bufferPoolConfig(),
+        const looperScheduler::ptr& scheduler = nullptr,
+        const std::vector<int>& worker_cpus = std::vector<int>())
+        : logger(logger_name, level, ft, sinks)
+        , __dump(dump)
+        , __encoder(logger_name)
+        , __batch_level(logLevel::value::UNKNOW) {
+        if (__dump) {
+            for (const auto& e : __sinks)
+                e->keepWritesWhole(); // 每个分段都从完整的帧开始
+        }
+        // looper 最后创建，保证异步线程启动时其他成员都已经初始化
+        __looper = std::make_shared<asyncLooper>(batchFunctor(std::bind(&binaryLogger::logSink, this, std::placeholders::_1)), looper_type, DEFAULT_RING_SIZE, pool_config,
+            false, overflowConfig(), std::bind(&binaryLogger::idleTick, this), idleTickMs(flushTickMs()), scheduler, worker_cpus);
+    }
+    ~binaryLogger() {
+        __looper->stop(); // 先让异步线程把数据处理完，再析构其他成员
+        writeSuppressed(true);
+    }
+    loggerMetrics metrics() override {
+        loggerMetrics m = logger::metrics();
+        m.__type = "binary";
+        m.__has_looper = true;
+        m.__looper = __looper->metrics();
+        return m;
+    }
 };
 // 1. 抽象一个建造者类
 enum class loggerType {
     LOGGER_SYNC,
-    LOGGER_ASYNC
+    LOGGER_ASYNC,
+    LOGGER_BINARY, // 延迟格式化的二进制日志器
 };
 class loggerBuilder {
 protected:
@@ -217,21 +760,58 @@ protected:
     formatter::ptr __formatter;
     std::vector<logSink::ptr> __sinks;
     asyncType __looper_type; // 异步工作模式
+    bool __binary_dump; // 二进制日志器直接输出二进制数据
+    bool __lazy_format; // 异步日志器在异步线程中格式化
+    overflowConfig __overflow; // 异步缓冲区满了时的处理方式
+    size_t __sink_queue_depth; // 大于0表示每个 sink 使用独立的落地线程
+    bufferPoolConfig __pool_config; // 异步缓冲块的大小、内存上限和空闲释放时间
+    looperScheduler::ptr __worker_pool; // 不为空时使用共享的工作线程
+    std::vector<int> __worker_cpus; // 不为空时异步线程只在这些CPU上运行
 public:
     loggerBuilder()
         : __logger_type(loggerType::LOGGER_SYNC)
         , __limit_value(logLevel::value::DEBUG)
-        , __looper_type(asyncType::ASYNC_SAFE) { }
+        , __looper_type(asyncType::ASYNC_SAFE)
+        , __binary_dump(false)
+        , __lazy_format(false)
+        , __sink_queue_depth(0) { }
     void buildLoggerType(loggerType type) { __logger_type = type; }
     void buildEnableUnsafeLoop() { __looper_type = asyncType::ASYNC_UNSAFE; }
+    void buildEnableLockFreeLoop() { __looper_type = asyncType::ASYNC_LOCKFREE; } // 每个生产线程独占环形缓冲区
+    void buildMemoryLimit(size_t max_bytes) { __pool_config.__max_bytes = max_bytes; } // 异步缓冲区的内存上限，达到上限时写日志会阻塞
+    void buildBufferChunkSize(size_t chunk_size) { __pool_config.__chunk_size = chunk_size; }
+    void buildBufferIdleTimeout(size_t idle_ms) { __pool_config.__idle_ms = idle_ms; } // 空闲的缓冲块超过这个时间还给操作系统，0表示不释放
+    void buildEnableSinkWorkers(size_t queue_depth = DEFAULT_SINK_QUEUE_DEPTH) { __sink_queue_depth = queue_depth; } // 仅对 LOGGER_ASYNC 有效
+    void buildSharedWorkers(const looperPool::ptr& pool = looperPool::global()) { __worker_pool = pool; } // 不创建自己的异步线程，由线程池处理，默认使用进程内共享的线程池
+    void buildWorkerAffinity(const std::vector<int>& cpus) { __worker_cpus = cpus; } // 异步线程只在这些CPU上运行，使用共享线程池时由线程池的配置决定
+    void buildWorkerNode(int node) { __worker_cpus = util::Numa::cpusOfNode(node); } // 异步线程绑定到这个NUMA节点的所有CPU
+    void buildNodeLocalBuffers() { __pool_config.__node_local = true; } // ASYNC_LOCKFREE 模式下生产者的环形缓冲区分配在生产者所在的NUMA节点，只有一个节点时不起作用
+    void buildEnableBinaryDump() { __binary_dump = true; } // 仅对 LOGGER_BINARY 有效
+    void buildEnableLazyFormat() { __lazy_format = true; } // 仅对 LOGGER_ASYNC 有效，文件名必须是字符串常量
+    void buildOverflowPolicy(overflowPolicy policy, logLevel::value keep_level = logLevel::value::ERROR) {
+        __overflow.__policy = policy;
+        __overflow.__keep_level = keep_level;
+    } // 仅对 LOGGER_ASYNC 有效，keep_level 只用于 DROP_BELOW_LEVEL
+    void buildOverflowSpin(size_t spin) { __overflow.__spin = spin; } // SPIN_THEN_BLOCK 阻塞之前最多自旋的次数
+    void buildDropReportInterval(size_t report_ms) { __overflow.__report_ms = report_ms; } // 丢弃统计日志的输出间隔，0表示不输出
     void buildLoggerName(const std::string& name) { __logger_name = name; }
     void buildLoggerLevel(logLevel::value level) { __limit_value = level; }
     void buildFormatter(const std::string& pattern) { __formatter = std::make_shared<formatter>(pattern); }
+    template <const char* Pattern>
+    void buildFormatter() { __formatter = std::make_shared<staticFormatter<Pattern>>(); } // 编译期解析的格式化规则
+    void buildFormatter(const formatter::ptr& ft) { __formatter = ft; }
+    void buildJsonFormatter(const std::string& time_fmt = DEFAULT_STRUCTURED_TIME_FMT) { __formatter = std::make_shared<jsonFormatter>(time_fmt); } // 每条日志一行 JSON
+    void buildLogfmtFormatter(const std::string& time_fmt = DEFAULT_STRUCTURED_TIME_FMT) { __formatter = std::make_shared<logfmtFormatter>(time_fmt); } // 每条日志一行 logfmt
     template <typename sinkType, typename... Args>
     void buildSink(Args&&... args) {
         logSink::ptr psink = sinkFactory::create<sinkType>(std::forward<Args>(args)...);
         __sinks.push_back(psink);
     }
+    void buildSink(const logSink::ptr& psink) { __sinks.push_back(psink); } // 使用已经创建好的 sink，可以在多个日志器之间共享
+    void buildSinkFlushPolicy(const flushPolicy& policy) {
+        assert(!__sinks.empty());
+        __sinks.back()->setFlushPolicy(policy);
+    } // 设置最近一次添加的 sink 的刷新策略
     virtual logger::ptr build() = 0; // 这个是虚函数
 };
 // 2. 派生一个具体的建造者类
@@ -247,7 +827,9 @@ public:
             // 默认放到标准输出
             buildSink<stdoutSink>();
         if (__logger_type == loggerType::LOGGER_ASYNC) {
-            return std::make_shared<asyncLogger>(__logger_name, __limit_value, __formatter, __sinks, __looper_type);
+            return std::make_shared<asyncLogger>(__logger_name, __limit_value, __formatter, __sinks, __looper_type, __sink_queue_depth, __pool_config, __lazy_format, __overflow, __worker_pool, __worker_cpus);
+        } else if (__logger_type == loggerType::LOGGER_BINARY) {
+            return std::make_shared<binaryLogger>(__logger_name, __limit_value, __formatter, __sinks, __looper_type, __binary_dump, __pool_config, __worker_pool, __worker_cpus);
         } else if (__logger_type == loggerType::LOGGER_SYNC)
             return std::make_shared<syncLogger>(__logger_name, __limit_value, __formatter, __sinks);
         else
@@ -260,45 +842,99 @@ public:
 // 日志器管理器(单例模式 懒汉)
 class loggerManager {
 private:
-    std::mutex __mtx;
+    using loggerMap = std::unordered_map<std::string, logger::ptr>;
+    std::mutex __mtx; // 只在注册日志器时使用
     logger::ptr __root_logger;
-    std::unordered_map<std::string, logger::ptr> __loggers; //
+    // 读多写少：注册时复制一份新的表再整体替换，读者不加锁
+    std::shared_ptr<const loggerMap> __loggers;
+    std::atomic<size_t> __version; // 每次替换表之后加一，线程本地缓存据此判断是否需要重新加载
 private:
-    loggerManager() {
+    loggerManager()
+        : __loggers(std::make_shared<loggerMap>())
+        , __version(1) {
         std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
         builder->buildLoggerName("root");
         __root_logger = builder->build();
-        __loggers.insert({ "root", __root_logger }); // 添加到管理中
+        add(__root_logger); // 添加到管理中
     } //
 public:
     void add(logger::ptr& obj) {
-        if (exists(obj->name()))
-            return;
         std::unique_lock<std::mutex> lock(__mtx);
-        __loggers.insert({ obj->name(), obj });
+        if (__loggers->count(obj->name()))
+            return;
+        std::shared_ptr<loggerMap> copy = std::make_shared<loggerMap>(*__loggers);
+        copy->insert({ obj->name(), obj });
+        std::atomic_store(&__loggers, std::shared_ptr<const loggerMap>(copy));
+        __version.fetch_add(1, std::memory_order_release);
     }
     bool exists(const std::string& logger_name) {
-        std::unique_lock<std::mutex> lock(__mtx);
-        auto it = __loggers.find(logger_name);
-        if (it == __loggers.end())
-            return false;
-        return true;
+        return snapshot().count(logger_name) > 0;
     }
     logger::ptr get(const std::string& logger_name) {
-        std::unique_lock<std::mutex> lock(__mtx);
-        auto it = __loggers.find(logger_name);
-        if (it == __loggers.end()) {
+        const loggerMap& loggers = snapshot();
+        auto it = loggers.find(logger_name);
+        if (it == loggers.end()) {
             std::cerr << "cannot find this logger: " << logger_name << std::endl;
             abort();
         }
         return it->second;
     }
-    logger::ptr get_root() { return __root_logger; }
+    const logger::ptr& get_root() { return __root_logger; }
+    std::vector<loggerMetrics> metrics() {
+        std::vector<loggerMetrics> all;
+        for (const auto& e : snapshot())
+            all.push_back(e.second->metrics());
+        std::sort(all.begin(), all.end(), [](const loggerMetrics& a, const loggerMetrics& b) { return a.__name < b.__name; });
+        return all;
+    } // 所有已注册日志器的运行时统计，按名称排序
+    std::string metricsText() {
+        std::string text;
+        for (const auto& e : metrics())
+            text += e.toText();
+        return text;
+    }
+    std::string metricsJson() {
+        std::vector<loggerMetrics> all = metrics();
+        std::string json = "[";
+        for (size_t i = 0; i < all.size(); ++i)
+            json += (i ? ", " : "") + all[i].toJson();
+        return json + "]";
+    }
     static loggerManager& getInstance() {
         // 在 C++11 之后，针对静态局部变量，编译器在编译的层面实现了线程安全
         // 当静态局部变量在没有构造完成之前，其他的线程进入就会阻塞
         static loggerManager eton;
         return eton;
+    } //
+private:
+    const loggerMap& snapshot() {
+        // 每个线程缓存一份表的引用，版本号没变时只需要一次原子读
+        struct snapshotCache {
+            size_t __version = 0;
+            std::shared_ptr<const loggerMap> __loggers;
+        };
+        static thread_local snapshotCache cache;
+        size_t version = __version.load(std::memory_order_acquire);
+        if (cache.__version != version) {
+            cache.__loggers = std::atomic_load(&__loggers);
+            cache.__version = version;
+        }
+        return *cache.__loggers;
+    }
+};
+// 调用点缓存：日志器注册之后不会被删除，同一个调用点的名字没变就直接复用上次查到的日志器
+class loggerSiteCache {
+private:
+    std::string __name;
+    logger* __logger = nullptr; //
+public:
+    template <typename T>
+    logger* get(const T& logger_name) {
+        if (__logger != nullptr && __name == logger_name)
+            return __logger;
+        __logger = loggerManager::getInstance().get(logger_name).get();
+        __name = logger_name;
+        return __logger;
     }
 };
 
@@ -315,7 +951,9 @@ public:
             buildSink<stdoutSink>();
         logger::ptr obj;
         if (__logger_type == loggerType::LOGGER_ASYNC) {
-            obj = std::make_shared<asyncLogger>(__logger_name, __limit_value, __formatter, __sinks, __looper_type);
+            obj = std::make_shared<asyncLogger>(__logger_name, __limit_value, __formatter, __sinks, __looper_type, __sink_queue_depth, __pool_config, __lazy_format, __overflow, __worker_pool, __worker_cpus);
+        } else if (__logger_type == loggerType::LOGGER_BINARY) {
+            obj = std::make_shared<binaryLogger>(__logger_name, __limit_value, __formatter, __sinks, __looper_type, __binary_dump, __pool_config, __worker_pool, __worker_cpus);
         } else if (__logger_type == loggerType::LOGGER_SYNC)
             obj = std::make_shared<syncLogger>(__logger_name, __limit_value, __formatter, __sinks);
         else
@@ -0,0 +1,186 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_LOOPER_POOL__
+#define __YUFC_LOOPER_POOL__
+
+#include "asyncLooper.hpp"
+#include "util.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ffengc_log {
+#define DEFAULT_POOL_THREADS 2
+struct looperPoolConfig {
+    size_t __threads = DEFAULT_POOL_THREADS; // 工作线程数
+    std::vector<int> __cpus; // 不为空时第 i 个工作线程绑定到 __cpus[i % __cpus.size()] 号CPU
+    size_t __chunk_size = DEFAULT_BUFFER_SIZE; // 使用这个大小的缓冲块的日志器共用空闲的块
+    size_t __idle_ms = DEFAULT_BUFFER_IDLE_MS; // 共用的空闲块超过这个时间还给操作系统，0表示不释放
+};
+// 多个异步日志器共用的工作线程
+// 每个日志器自己的 looper 有数据时进入就绪队列，工作线程按先进先出的顺序每次处理一个 looper 的一轮数据，
+// 处理完还有数据就排到队尾，一个日志量很大的日志器不会让其他日志器一直等待
+// 同一个 looper 同一时刻只会被一个工作线程处理，因此 sink 不需要额外加锁
+// 空闲的缓冲块放在线程池共用的 chunkCache 中，ASYNC_LOCKFREE 的消费缓冲区由工作线程持有，日志器再多，这部分内存也不增加
+class looperPool : public looperScheduler {
+private:
+    looperPoolConfig __config;
+    chunkCache::ptr __chunks;
+    std::mutex __mtx;
+    std::condition_variable __work_condition; // 就绪队列不为空，或者需要停止
+    std::condition_variable __done_condition; // 某个 looper 处理完了一轮，detach 等待它
+    std::deque<asyncLooper*> __ready;
+    std::vector<asyncLooper*> __loopers; // 所有挂在这个线程池上的 looper
+    int64_t __next_tick_ns; // 最早一个需要定期检查的 looper 的时间
+    bool __stop;
+    std::vector<std::thread> __workers; //
+public:
+    using ptr = std::shared_ptr<looperPool>;
+    looperPool(const looperPoolConfig& config = looperPoolConfig())
+        : __config(config)
+        , __chunks(std::make_shared<chunkCache>(config.__chunk_size, config.__idle_ms))
+        , __next_tick_ns(INT64_MAX)
+        , __stop(false) {
+        if (__config.__threads == 0)
+            __config.__threads = 1;
+        for (size_t i = 0; i < __config.__threads; ++i)
+            __workers.emplace_back(&looperPool::workerEntry, this, i);
+    }
+    ~looperPool() {
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            assert(__loopers.empty()); // looper 持有线程池的引用，线程池析构时它们都已经停止
+            __stop = true;
+        }
+        __work_condition.notify_all();
+        for (auto& e : __workers)
+            e.join();
+    }
+    // 进程内共享的线程池，第一次调用时按 configureGlobal 设置的参数创建
+    static ptr global() {
+        std::unique_lock<std::mutex> lock(globalMutex());
+        if (globalPool() == nullptr)
+            globalPool() = std::make_shared<looperPool>(globalConfig());
+        return globalPool();
+    }
+    // 必须在第一次调用 global() 之前设置，否则返回 false
+    static bool configureGlobal(const looperPoolConfig& config) {
+        std::unique_lock<std::mutex> lock(globalMutex());
+        if (globalPool() != nullptr)
+            return false;
+        globalConfig() = config;
+        return true;
+    }
+    size_t threads() const { return __workers.size(); }
+    size_t cachedBytes() { return __chunks->cachedBytes(); } // 共用的空闲缓冲块占用的内存
+    chunkCache::ptr chunks() override { return __chunks; }
+    size_t loopers() {
+        std::unique_lock<std::mutex> lock(__mtx);
+        return __loopers.size();
+    } // 挂在这个线程池上的 looper 数量
+    void attach(asyncLooper* looper) override {
+        std::unique_lock<std::mutex> lock(__mtx);
+        looper->__attached = true;
+        looper->__next_tick_ns = nextTick(looper, util::Date::monotonicNs());
+        __next_tick_ns = std::min(__next_tick_ns, looper->__next_tick_ns);
+        __loopers.push_back(looper);
+        __work_condition.notify_one(); // 让工作线程按新的检查时间等待
+    }
+    void detach(asyncLooper* looper) override {
+        std::unique_lock<std::mutex> lock(__mtx);
+        if (!looper->__attached)
+            return;
+        looper->__attached = false;
+        __loopers.erase(std::find(__loopers.begin(), __loopers.end(), looper));
+        auto it = std::find(__ready.begin(), __ready.end(), looper);
+        if (it != __ready.end())
+            __ready.erase(it);
+        __done_condition.wait(lock, [&]() { return !running(looper); });
+        looper->__sched_state.store(asyncLooper::STATE_RUNNING); // 之后的通知都不会再排队
+    }
+    void schedule(asyncLooper* looper) override {
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            if (!looper->__attached)
+                return; // 正在停止，剩下的数据由 stop() 处理
+            __ready.push_back(looper);
+        }
+        __work_condition.notify_one();
+    }
+private:
+    static std::mutex& globalMutex() {
+        static std::mutex mtx;
+        return mtx;
+    }
+    static ptr& globalPool() {
+        static ptr pool;
+        return pool;
+    }
+    static looperPoolConfig& globalConfig() {
+        static looperPoolConfig config;
+        return config;
+    }
+    static bool running(asyncLooper* looper) {
+        int state = looper->__sched_state.load();
+        return state == asyncLooper::STATE_RUNNING || state == asyncLooper::STATE_RUNNING_NOTIFIED;
+    }
+    static int64_t nextTick(asyncLooper* looper, int64_t now) {
+        int64_t interval = (int64_t)looper->waitTimeout().count() * 1000000;
+        return interval > 0 ? now + interval : INT64_MAX; // 0表示没有需要定期做的事，不检查，否则工作线程会空转
+    } // 和独立线程一样，每隔 waitTimeout() 释放空闲的缓冲块、调用一次 idle 回调
+    // 到了检查时间的 looper 标记一下，交给工作线程执行，保证 idle 回调和数据处理不会同时进行，调用时持有 __mtx
+    void checkTicks(int64_t now) {
+        if (now < __next_tick_ns)
+            return;
+        __next_tick_ns = INT64_MAX;
+        for (auto e : __loopers) {
+            if (now >= e->__next_tick_ns) {
+                e->__next_tick_ns = nextTick(e, now);
+                e->__tick_pending = true;
+                if (e->markPending())
+                    __ready.push_back(e);
+            }
+            __next_tick_ns = std::min(__next_tick_ns, e->__next_tick_ns);
+        }
+    }
+    void workerEntry(size_t index) {
+        util::Thread::setName("ffengc-pool-" + std::to_string(index));
+        if (!__config.__cpus.empty())
+            util::Numa::setAffinity(pthread_self(), { __config.__cpus[index % __config.__cpus.size()] });
+        buffer scratch(0); // ASYNC_LOCKFREE 的消费缓冲区，第一次用到时才分配
+        std::unique_lock<std::mutex> lock(__mtx);
+        while (true) {
+            checkTicks(util::Date::monotonicNs());
+            if (__ready.empty()) {
+                if (__stop)
+                    break;
+                if (__next_tick_ns == INT64_MAX)
+                    __work_condition.wait(lock);
+                else
+                    __work_condition.wait_for(lock, std::chrono::nanoseconds(std::max<int64_t>(__next_tick_ns - util::Date::monotonicNs(), 0)));
+                continue;
+            }
+            asyncLooper* looper = __ready.front();
+            __ready.pop_front();
+            looper->__sched_state.store(asyncLooper::STATE_RUNNING);
+            lock.unlock();
+            bool more = looper->runOnce(scratch);
+            if (!more)
+                scratch.shrink(DEFAULT_BUFFER_SIZE); // 被超大的一轮撑大了，恢复成默认大小
+            lock.lock();
+            if (!looper->finishRun(more) && looper->__attached)
+                __ready.push_back(looper); // 还有数据，排到队尾；已经 detach 的由 stop() 处理
+            __done_condition.notify_all();
+        }
+    }
+};
+} // namespace ffengc_log
+
+#endif
@@ -8,33 +8,45 @@
 #ifndef __YUFC_MESSAGE__
 #define __YUFC_MESSAGE__
 
+#include "field.hpp"
 #include "level.hpp"
 #include "util.hpp"
 #include <iostream>
 #include <string>
-#include <thread>
 
 namespace ffengc_log {
 struct logMessage {
     time_t __ctime; // 日志产生的时间戳
+    long __cnsec; // 时间戳的纳秒部分
     logLevel::value __level; // 日志等级
     size_t __line; // 行号
-    std::thread::id __tid; // 线程id
-    std::string __file; // 文件名
-    std::string __logger; // 日志器名称
-    std::string __payload; // 日志主体
+    pid_t __tid; // 内核线程ID
+    uint32_t __name_id; // 线程注册的名字的编号，0表示没有注册
+    // 以下三个字段不持有内存，只在格式化期间有效，避免每条日志拷贝三次字符串
+    util::strView __file; // 文件名
+    util::strView __logger; // 日志器名称
+    util::strView __payload; // 日志主体
+    const logField* __fields; // 附加的键值对，同样只在格式化期间有效
+    size_t __field_cnt;
     logMessage(const logLevel::value& level,
         const size_t& line,
-        const std::string& file,
-        const std::string& logger,
-        const std::string& message)
-        : __ctime(util::Date::now())
-        , __level(level)
+        util::strView file,
+        util::strView logger,
+        util::strView message)
+        : __level(level)
         , __line(line)
-        , __tid(std::this_thread::get_id())
+        , __tid(util::Thread::id())
+        , __name_id(util::Thread::nameId())
         , __file(file)
         , __logger(logger)
-        , __payload(message) { }
+        , __payload(message)
+        , __fields(nullptr)
+        , __field_cnt(0) {
+        int64_t now = util::Date::nowNs();
+        __ctime = (time_t)(now / util::Date::NS_PER_SEC);
+        __cnsec = (long)(now % util::Date::NS_PER_SEC);
+    }
+    int64_t timeNs() const { return (int64_t)__ctime * util::Date::NS_PER_SEC + __cnsec; } // 纳秒时间戳
 };
 } // namespace ffengc_log
 
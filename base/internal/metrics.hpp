@@ -0,0 +1,134 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_METRICS__
+#define __YUFC_METRICS__
+
+#include <atomic>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ffengc_log {
+#define METRICS_SHARDS 16
+// 多个线程频繁累加、很少读取的计数器
+// 每个线程固定使用其中一个分片，读取时再把所有分片加起来，避免所有线程争用同一个缓存行
+class shardedCounter {
+private:
+    struct shard {
+        std::atomic<uint64_t> __value;
+        char __pad[64 - sizeof(std::atomic<uint64_t>)];
+    };
+    shard __shards[METRICS_SHARDS]; //
+public:
+    shardedCounter() {
+        for (auto& e : __shards)
+            e.__value.store(0, std::memory_order_relaxed);
+    }
+    void add(uint64_t n = 1) { __shards[slot()].__value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const {
+        uint64_t sum = 0;
+        for (const auto& e : __shards)
+            sum += e.__value.load(std::memory_order_relaxed);
+        return sum;
+    } //
+private:
+    static size_t slot() {
+        static std::atomic<size_t> next(0);
+        static thread_local size_t idx = next.fetch_add(1, std::memory_order_relaxed) % METRICS_SHARDS;
+        return idx;
+    }
+};
+// 以下是读取时得到的快照，都是普通的值
+struct sinkMetrics {
+    uint64_t __writes = 0; // 调用次数（异步日志器每批算一次）
+    uint64_t __bytes = 0;
+    uint64_t __write_ns = 0; // 异步线程中调用 sink 的总耗时
+    uint64_t __write_max_ns = 0;
+    uint64_t __rolls = 0; // 滚动文件的次数
+    uint64_t __flushes = 0; // 刷新的次数
+    uint64_t __syncs = 0; // 其中调用 fdatasync 的次数
+};
+struct looperMetrics {
+    uint64_t __batches = 0; // 消费者取数据并调用回调的次数
+    uint64_t __buffers = 0; // 交给回调的缓冲块数量
+    uint64_t __bytes = 0;
+    uint64_t __callback_ns = 0; // 回调（格式化、落地）的总耗时
+    uint64_t __callback_max_ns = 0;
+    uint64_t __producer_waits = 0; // 生产者因为缓冲区满了而等待的次数
+    uint64_t __producer_wait_ns = 0;
+    uint64_t __dropped = 0;
+    uint64_t __pending_bytes = 0; // 读取时还没有交给回调的数据量
+    uint64_t __allocated_bytes = 0; // 缓冲块占用的内存
+};
+struct loggerMetrics {
+    std::string __name;
+    std::string __type; // sync / async / binary
+    uint64_t __records = 0; // 通过了等级过滤的日志条数
+    bool __has_looper = false;
+    looperMetrics __looper;
+    std::vector<sinkMetrics> __sinks;
+    std::string toText() const {
+        std::stringstream ss;
+        ss << "logger " << __name << " (" << __type << ") records: " << __records << "\n";
+        if (__has_looper) {
+            const looperMetrics& l = __looper;
+            ss << "  looper batches: " << l.__batches << " buffers: " << l.__buffers << " bytes: " << l.__bytes
+               << " callback_ns: " << l.__callback_ns << " callback_max_ns: " << l.__callback_max_ns
+               << " producer_waits: " << l.__producer_waits << " producer_wait_ns: " << l.__producer_wait_ns
+               << " dropped: " << l.__dropped << " pending_bytes: " << l.__pending_bytes
+               << " allocated_bytes: " << l.__allocated_bytes << "\n";
+        }
+        for (size_t i = 0; i < __sinks.size(); ++i) {
+            const sinkMetrics& s = __sinks[i];
+            ss << "  sink[" << i << "] writes: " << s.__writes << " bytes: " << s.__bytes << " write_ns: " << s.__write_ns
+               << " write_max_ns: " << s.__write_max_ns << " rolls: " << s.__rolls
+               << " flushes: " << s.__flushes << " syncs: " << s.__syncs << "\n";
+        }
+        return ss.str();
+    }
+    std::string toJson() const {
+        std::stringstream ss;
+        ss << "{\"name\": \"" << escape(__name) << "\", \"type\": \"" << __type << "\", \"records\": " << __records;
+        if (__has_looper) {
+            const looperMetrics& l = __looper;
+            ss << ", \"looper\": {\"batches\": " << l.__batches << ", \"buffers\": " << l.__buffers << ", \"bytes\": " << l.__bytes
+               << ", \"callback_ns\": " << l.__callback_ns << ", \"callback_max_ns\": " << l.__callback_max_ns
+               << ", \"producer_waits\": " << l.__producer_waits << ", \"producer_wait_ns\": " << l.__producer_wait_ns
+               << ", \"dropped\": " << l.__dropped << ", \"pending_bytes\": " << l.__pending_bytes
+               << ", \"allocated_bytes\": " << l.__allocated_bytes << "}";
+        }
+        ss << ", \"sinks\": [";
+        for (size_t i = 0; i < __sinks.size(); ++i) {
+            const sinkMetrics& s = __sinks[i];
+            ss << (i ? ", " : "") << "{\"writes\": " << s.__writes << ", \"bytes\": " << s.__bytes << ", \"write_ns\": " << s.__write_ns
+               << ", \"write_max_ns\": " << s.__write_max_ns << ", \"rolls\": " << s.__rolls
+               << ", \"flushes\": " << s.__flushes << ", \"syncs\": " << s.__syncs << "}";
+        }
+        ss << "]}";
+        return ss.str();
+    } //
+private:
+    static std::string escape(const std::string& str) {
+        std::string out;
+        for (char c : str) {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            if ((unsigned char)c >= 0x20)
+                out += c;
+        }
+        return out;
+    } // 日志器名称中的引号和反斜杠转义，控制字符直接去掉
+};
+// 原子地更新最大值
+inline void updateMax(std::atomic<uint64_t>& max, uint64_t value) {
+    uint64_t cur = max.load(std::memory_order_relaxed);
+    while (value > cur && !max.compare_exchange_weak(cur, value, std::memory_order_relaxed)) { }
+}
+} // namespace ffengc_log
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_RATE_LIMIT__
+#define __YUFC_RATE_LIMIT__
+
+#include "level.hpp"
+#include "util.hpp"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace ffengc_log {
+#define DEFAULT_SUPPRESS_REPORT_MS 1000
+#define SUPPRESS_CHECK_EVERY 16 // 每被限流这么多条才读一次时钟，判断是否需要汇总，必须是2的幂
+#define SUPPRESS_REPORT_FMT "suppressed %llu messages"
+// 调用点的限流规则，由 LOG_xxx_LIMIT 宏使用
+struct rateLimit {
+    enum class mode {
+        TOKEN_BUCKET, // 每秒最多 __rate 条，允许突发 __burst 条
+        EVERY_N, // 前 __first 条都输出，之后每 __every 条输出一条
+        SAMPLE, // 每条以 __probability 的概率输出
+    };
+    mode __mode;
+    double __rate;
+    size_t __burst;
+    size_t __first;
+    size_t __every;
+    double __probability;
+};
+inline rateLimit limitRate(double per_sec, size_t burst = 1) { return { rateLimit::mode::TOKEN_BUCKET, per_sec, burst, 0, 0, 0 }; }
+inline rateLimit limitEveryN(size_t first, size_t every) { return { rateLimit::mode::EVERY_N, 0, 0, first, every, 0 }; }
+inline rateLimit limitSample(double probability) { return { rateLimit::mode::SAMPLE, 0, 0, 0, 0, probability }; }
+// 一个调用点需要输出的汇总
+struct suppressedReport {
+    logLevel::value __level;
+    const char* __file;
+    size_t __line;
+    uint64_t __count;
+};
+class siteLimiter;
+// 每个日志器一个，记录向它输出过的限流调用点，日志器空闲时和析构时汇总其中还没有输出的被限流条数
+class limiterRegistry {
+private:
+    std::mutex __mtx;
+    std::vector<siteLimiter*> __limiters;
+    std::vector<suppressedReport> __orphans; // 比日志器先析构的调用点留下的条数 //
+public:
+    using ptr = std::shared_ptr<limiterRegistry>;
+    void add(siteLimiter* limiter) {
+        std::unique_lock<std::mutex> lock(__mtx);
+        __limiters.push_back(limiter);
+    }
+    void remove(siteLimiter* limiter, const suppressedReport& last) {
+        std::unique_lock<std::mutex> lock(__mtx);
+        for (size_t i = 0; i < __limiters.size(); ++i) {
+            if (__limiters[i] == limiter) {
+                __limiters.erase(__limiters.begin() + i);
+                break;
+            }
+        }
+        if (last.__count > 0)
+            __orphans.push_back(last);
+    }
+    // 取走需要汇总的条数：距离上次汇总超过 DEFAULT_SUPPRESS_REPORT_MS 的调用点，final 为 true 时取走全部
+    void collect(bool final, std::vector<suppressedReport>& reports);
+};
+// 每个调用点一个（静态变量），多个线程共享，判断都是无锁的
+// 被限流的日志在格式化之前就返回，只累加计数；下一条输出的日志之前，或者距离上次汇总超过 DEFAULT_SUPPRESS_REPORT_MS 时（每 SUPPRESS_CHECK_EVERY 条检查一次），输出一条汇总
+// 调用点之后不再被调用时，由注册的日志器在空闲时和析构时输出剩下的汇总
+class siteLimiter {
+public:
+    typedef int64_t (*clockFunc)(); // 单调时钟，返回纳秒
+private:
+    rateLimit __limit;
+    clockFunc __clock;
+    int64_t __interval_ns; // 令牌桶：每条日志占用的时间
+    int64_t __burst_ns; // 令牌桶：最多可以提前占用的时间
+    uint64_t __threshold; // 采样：随机数小于它时输出
+    std::atomic<int64_t> __tat; // 令牌桶：下一条日志理论上的到达时间（GCRA）
+    std::atomic<uint64_t> __count; // 每N条：调用次数
+    std::atomic<uint64_t> __suppressed; // 还没有汇总的被限流条数
+    std::atomic<int64_t> __last_report; // 上次定期汇总的时间
+    // 注册到第一个使用这个调用点的日志器
+    std::atomic<bool> __attached;
+    std::mutex __attach_mtx;
+    std::weak_ptr<limiterRegistry> __registry;
+    logLevel::value __level;
+    const char* __file;
+    size_t __line; //
+public:
+    explicit siteLimiter(const rateLimit& limit, clockFunc clock = util::Date::monotonicNs) // 测试时可以换成手动推进的时钟
+        : __limit(limit)
+        , __clock(clock)
+        , __interval_ns(limit.__rate > 0 ? (int64_t)(util::Date::NS_PER_SEC / limit.__rate) : 0)
+        , __burst_ns(__interval_ns * (int64_t)(limit.__burst > 0 ? limit.__burst : 1))
+        , __threshold(limit.__probability >= 1 ? UINT64_MAX : (uint64_t)(limit.__probability * 4294967296.0) << 32)
+        , __tat(0)
+        , __count(0)
+        , __suppressed(0)
+        , __last_report(clock())
+        , __attached(false)
+        , __level(logLevel::value::UNKNOW)
+        , __file("")
+        , __line(0) { }
+    ~siteLimiter() {
+        limiterRegistry::ptr registry = __registry.lock();
+        if (registry)
+            registry->remove(this, { __level, __file, __line, __suppressed.exchange(0, std::memory_order_relaxed) }); // 进程退出时调用点可能先于日志器析构
+    }
+    // 宏每次调用，只有第一次会注册，汇总以 level 等级、file:line 的位置输出
+    void attach(const limiterRegistry::ptr& registry, logLevel::value level, const char* file, size_t line) {
+        if (__attached.load(std::memory_order_acquire))
+            return;
+        std::unique_lock<std::mutex> lock(__attach_mtx);
+        if (__attached.load(std::memory_order_relaxed))
+            return;
+        __level = level;
+        __file = file;
+        __line = line;
+        __registry = registry;
+        registry->add(this);
+        __attached.store(true, std::memory_order_release);
+    }
+    // 返回这条日志是否输出；report 不为0时，调用者先输出一条 "suppressed report messages"
+    bool allow(uint64_t& report) {
+        report = 0;
+        if (pass()) {
+            if (__suppressed.load(std::memory_order_relaxed) > 0)
+                report = __suppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+        uint64_t n = __suppressed.fetch_add(1, std::memory_order_relaxed) + 1;
+        if ((n & (SUPPRESS_CHECK_EVERY - 1)) != 0)
+            return false;
+        // 这个调用点一直被限流时，也定期汇总一次
+        int64_t now = __clock();
+        int64_t last = __last_report.load(std::memory_order_relaxed);
+        if (now - last >= DEFAULT_SUPPRESS_REPORT_MS * 1000000LL && __last_report.compare_exchange_strong(last, now, std::memory_order_relaxed))
+            report = __suppressed.exchange(0, std::memory_order_relaxed);
+        return false;
+    }
+    uint64_t suppressed() const { return __suppressed.load(std::memory_order_relaxed); }
+    // 日志器空闲时调用：距离上次汇总超过 DEFAULT_SUPPRESS_REPORT_MS 时取走被限流的条数，final 为 true 时直接取走
+    uint64_t takeSuppressed(bool final) {
+        if (__suppressed.load(std::memory_order_relaxed) == 0)
+            return 0;
+        if (!final) {
+            int64_t now = __clock();
+            int64_t last = __last_report.load(std::memory_order_relaxed);
+            if (now - last < DEFAULT_SUPPRESS_REPORT_MS * 1000000LL || !__last_report.compare_exchange_strong(last, now, std::memory_order_relaxed))
+                return 0;
+        }
+        return __suppressed.exchange(0, std::memory_order_relaxed);
+    }
+    suppressedReport report(uint64_t count) const { return { __level, __file, __line, count }; } //
+private:
+    bool pass() {
+        switch (__limit.__mode) {
+        case rateLimit::mode::TOKEN_BUCKET: {
+            if (__interval_ns == 0)
+                return false;
+            int64_t now = __clock();
+            int64_t tat = __tat.load(std::memory_order_relaxed);
+            while (true) {
+                int64_t base = tat > now ? tat : now;
+                if (base + __interval_ns - now > __burst_ns)
+                    return false;
+                if (__tat.compare_exchange_weak(tat, base + __interval_ns, std::memory_order_relaxed))
+                    return true;
+            }
+        }
+        case rateLimit::mode::EVERY_N: {
+            uint64_t n = __count.fetch_add(1, std::memory_order_relaxed);
+            return n < __limit.__first || (__limit.__every > 0 && (n - __limit.__first) % __limit.__every == 0);
+        }
+        case rateLimit::mode::SAMPLE:
+            return random() < __threshold;
+        }
+        return true;
+    }
+    static uint64_t random() {
+        // xorshift64*，每个线程独立的状态
+        static thread_local uint64_t state = (uint64_t)util::Date::monotonicNs() ^ (uint64_t)(uintptr_t)&state ^ 0x9E3779B97F4A7C15ULL;
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+};
+inline void limiterRegistry::collect(bool final, std::vector<suppressedReport>& reports) {
+    std::unique_lock<std::mutex> lock(__mtx);
+    reports.insert(reports.end(), __orphans.begin(), __orphans.end());
+    __orphans.clear();
+    for (auto e : __limiters) {
+        uint64_t count = e->takeSuppressed(final);
+        if (count > 0)
+            reports.push_back(e->report(count));
+    }
+}
+} // namespace ffengc_log
+
+#endif
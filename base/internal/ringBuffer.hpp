@@ -0,0 +1,100 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_RING_BUFFER__
+#define __YUFC_RING_BUFFER__
+
+#include "buffer.hpp"
+#include <atomic>
+#include <memory>
+#include <string.h>
+#include <vector>
+
+namespace ffengc_log {
+#define DEFAULT_RING_SIZE (256 * 1024)
+#define CACHE_LINE_SIZE 64
+// 单生产者单消费者的字节环形缓冲区
+// 生产者只修改 __head，消费者只修改 __tail，两端都不需要加锁
+// 生产者每次写入一条完整的日志后才发布 __head，因此消费者读到的永远是完整的日志
+class ringBuffer {
+private:
+    char* __ring; // 单独映射的内存，可以在第一次写入之前绑定到生产者所在的节点
+    size_t __mask; //
+    char __pad0[CACHE_LINE_SIZE];
+    std::atomic<size_t> __head; // 写位置（只由生产者修改）
+    size_t __cached_tail; // 生产者缓存的读位置，减少对 __tail 的访问
+    char __pad1[CACHE_LINE_SIZE];
+    std::atomic<size_t> __tail; // 读位置（只由消费者修改）
+    char __pad2[CACHE_LINE_SIZE];
+    std::atomic<bool> __closed; // 生产线程已经退出，消费者取完数据后回收
+public:
+    using ptr = std::shared_ptr<ringBuffer>;
+    ringBuffer(size_t size = DEFAULT_RING_SIZE, int node = -1) // node >= 0 时环的内存放到这个NUMA节点
+        : __head(0)
+        , __cached_tail(0)
+        , __tail(0)
+        , __closed(false) {
+        size_t cap = 1;
+        while (cap < size)
+            cap <<= 1; // 容量取2的幂，下标用掩码计算
+        __ring = util::Numa::allocate(cap, node);
+        __mask = cap - 1;
+    }
+    ~ringBuffer() { util::Numa::deallocate(__ring, capacity()); }
+    ringBuffer(const ringBuffer&) = delete;
+    ringBuffer& operator=(const ringBuffer&) = delete;
+    size_t capacity() const { return __mask + 1; }
+    bool push(const char* data, size_t len) { return push(nullptr, 0, data, len); } // 生产者调用
+    bool push(const char* prefix, size_t prefix_len, const char* data, size_t len) {
+        size_t head = __head.load(std::memory_order_relaxed);
+        size_t total = prefix_len + len;
+        if (capacity() - (head - __cached_tail) < total) {
+            __cached_tail = __tail.load(std::memory_order_acquire);
+            if (capacity() - (head - __cached_tail) < total)
+                return false; // 空间不够，由调用者决定等待策略
+        }
+        copyIn(head, prefix, prefix_len);
+        copyIn(head + prefix_len, data, len);
+        __head.store(head + total, std::memory_order_release);
+        return true;
+    } // 生产者调用，两段数据作为一个整体发布
+    size_t popTo(buffer& out) {
+        size_t tail = __tail.load(std::memory_order_relaxed);
+        size_t head = __head.load(std::memory_order_acquire);
+        size_t len = head - tail;
+        if (len == 0)
+            return 0;
+        size_t off = tail & __mask;
+        size_t first = std::min(len, capacity() - off);
+        out.push(&__ring[off], first);
+        if (len > first)
+            out.push(&__ring[0], len - first);
+        __tail.store(head, std::memory_order_release);
+        return len;
+    } // 消费者调用，把当前所有已发布的数据搬到 out 中
+    size_t size() const {
+        size_t tail = __tail.load(std::memory_order_acquire); // 先读 __tail，保证 head >= tail
+        return __head.load(std::memory_order_acquire) - tail;
+    } // 还没有被取走的字节数，只用于统计
+    bool empty() const {
+        return __head.load(std::memory_order_acquire) == __tail.load(std::memory_order_acquire);
+    }
+    void close() { __closed.store(true, std::memory_order_release); }
+    bool closed() const { return __closed.load(std::memory_order_acquire); } //
+private:
+    void copyIn(size_t pos, const char* data, size_t len) {
+        if (len == 0)
+            return;
+        size_t off = pos & __mask;
+        size_t first = std::min(len, capacity() - off);
+        memcpy(&__ring[off], data, first);
+        if (len > first)
+            memcpy(&__ring[0], data + first, len - first);
+    }
+};
+} // namespace ffengc_log
+
+#endif
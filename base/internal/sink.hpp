@@ -7,30 +7,196 @@
 #ifndef __YUFC_SINK__
 #define __YUFC_SINK__
 
+#include "level.hpp"
+#include "metrics.hpp"
+#include "uring.hpp"
 #include "util.hpp"
+#include <algorithm>
 #include <assert.h>
+#include <condition_variable>
+#include <fcntl.h>
 #include <fstream>
+#include <limits.h>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 namespace ffengc_log {
+// sink 的刷新策略，几个条件满足任意一个就刷新；默认都不开启，由 ofstream 自己的缓冲决定何时写入内核
+// 异步日志器每轮交付之后最多刷新一次，一轮中的多条日志共用一次刷新
+struct flushPolicy {
+    logLevel::value __level = logLevel::value::OFF; // 写入了不低于这个等级的日志就刷新，OFF表示不按等级（异步日志器会为此记录每条日志的等级）
+    size_t __bytes = 0; // 距离上次刷新写入了这么多字节就刷新，0表示不按大小
+    size_t __interval_ms = 0; // 距离上次刷新超过这么久就刷新，0表示不按时间；异步日志器的工作线程空闲时也会定期检查
+    bool __sync = false; // 刷新后再调用 fdatasync，数据落到磁盘，而不只是进入页缓存
+    bool enabled() const { return __level != logLevel::value::OFF || __bytes > 0 || __interval_ms > 0; }
+};
+// 一条日志的视图，指向异步缓冲区（或格式化缓冲区）中的数据，只在 logRecords 调用期间有效
+struct recordView {
+    const char* __data;
+    size_t __size;
+    logLevel::value __level;
+    int64_t __time_ns; // 纳秒时间戳
+};
 class logSink {
+protected:
+    // 由日志器通过 write* 接口统计，同一个 sink 可能被多个日志器共享
+    std::atomic<uint64_t> __writes;
+    std::atomic<uint64_t> __bytes;
+    std::atomic<uint64_t> __write_ns;
+    std::atomic<uint64_t> __write_max_ns;
+    std::atomic<uint64_t> __rolls; // 滚动文件的 sink 自己累加
+    std::atomic<uint64_t> __flushes;
+    std::atomic<uint64_t> __syncs;
+    // 刷新策略，只在写入 sink 的线程中使用
+    flushPolicy __flush_policy;
+    size_t __unflushed; // 上次刷新之后写入的字节数
+    int64_t __last_flush; // 上次刷新的时间 //
 public:
     using ptr = std::shared_ptr<logSink>;
-    logSink() = default;
+    logSink()
+        : __writes(0)
+        , __bytes(0)
+        , __write_ns(0)
+        , __write_max_ns(0)
+        , __rolls(0)
+        , __flushes(0)
+        , __syncs(0)
+        , __unflushed(0)
+        , __last_flush(util::Date::monotonicNs()) { }
     virtual ~logSink() { }
     virtual void log(const char* data, size_t len) = 0;
+    virtual void logChunks(const struct iovec* iov, size_t cnt) {
+        for (size_t i = 0; i < cnt; ++i)
+            log((const char*)iov[i].iov_base, iov[i].iov_len);
+    } // 异步线程一次交付多个缓冲块，默认逐块调用 log
+    virtual bool wantsRecords() const { return false; } // 重写了 logRecords 的 sink 返回 true，日志器才会记录每条日志的元数据
+    virtual void logRecords(const recordView* records, size_t cnt) {
+        for (size_t i = 0; i < cnt; ++i)
+            log(records[i].__data, records[i].__size);
+    } // 一次交付一批日志，可以逐条过滤、路由、加帧头
+    virtual void flush() { } // 把 sink 自己缓冲的数据交给内核
+    virtual void sync() { } // 把已经交给内核的数据写到磁盘（fdatasync）
+    virtual bool nextWriteStartsFile() const { return false; } // 下一次写入会滚动到新文件，二进制日志器据此在每个分段开头写文件头
+    virtual void keepWritesWhole() { } // 此后每次写入完整地落在一个文件中，只在两次写入之间滚动；二进制 dump 的帧不能被切开
+    void setFlushPolicy(const flushPolicy& policy) { __flush_policy = policy; } // 在 sink 交给日志器之前设置
+    const flushPolicy& getFlushPolicy() const { return __flush_policy; }
+    // 日志器通过下面的接口调用 sink，顺便统计写入量、按策略刷新；批量接口在异步线程中调用，同时统计耗时（包括刷新）
+    // level 是这次写入的日志中最高的等级，不知道时为 UNKNOW
+    void write(const char* data, size_t len, logLevel::value level = logLevel::value::UNKNOW) {
+        log(data, len);
+        __writes.fetch_add(1, std::memory_order_relaxed);
+        __bytes.fetch_add(len, std::memory_order_relaxed);
+        if (__flush_policy.enabled())
+            applyFlushPolicy(len, level);
+    }
+    void writeChunks(const struct iovec* iov, size_t cnt, logLevel::value level = logLevel::value::UNKNOW) {
+        size_t bytes = 0;
+        for (size_t i = 0; i < cnt; ++i)
+            bytes += iov[i].iov_len;
+        int64_t start = util::Date::monotonicNs();
+        logChunks(iov, cnt);
+        if (__flush_policy.enabled())
+            applyFlushPolicy(bytes, level);
+        account(bytes, util::Date::monotonicNs() - start);
+    }
+    void writeRecords(const recordView* records, size_t cnt) {
+        size_t bytes = 0;
+        logLevel::value level = logLevel::value::UNKNOW;
+        for (size_t i = 0; i < cnt; ++i) {
+            bytes += records[i].__size;
+            level = std::max(level, records[i].__level);
+        }
+        int64_t start = util::Date::monotonicNs();
+        logRecords(records, cnt);
+        if (__flush_policy.enabled())
+            applyFlushPolicy(bytes, level);
+        account(bytes, util::Date::monotonicNs() - start);
+    }
+    // 立即刷新，策略要求时同时 fdatasync
+    void flushNow() {
+        flush();
+        __flushes.fetch_add(1, std::memory_order_relaxed);
+        if (__flush_policy.__sync) {
+            sync();
+            __syncs.fetch_add(1, std::memory_order_relaxed);
+        }
+        __unflushed = 0;
+        __last_flush = util::Date::monotonicNs();
+    }
+    // 按时间刷新的 sink 由写入它的线程在空闲时调用，避免最后一批日志一直留在缓冲区中
+    void flushIfDue() {
+        if (__flush_policy.__interval_ms > 0 && __unflushed > 0
+            && util::Date::monotonicNs() - __last_flush >= (int64_t)__flush_policy.__interval_ms * 1000000)
+            flushNow();
+    }
+    sinkMetrics metrics() const {
+        sinkMetrics m;
+        m.__writes = __writes.load(std::memory_order_relaxed);
+        m.__bytes = __bytes.load(std::memory_order_relaxed);
+        m.__write_ns = __write_ns.load(std::memory_order_relaxed);
+        m.__write_max_ns = __write_max_ns.load(std::memory_order_relaxed);
+        m.__rolls = __rolls.load(std::memory_order_relaxed);
+        m.__flushes = __flushes.load(std::memory_order_relaxed);
+        m.__syncs = __syncs.load(std::memory_order_relaxed);
+        return m;
+    } //
+private:
+    void applyFlushPolicy(size_t bytes, logLevel::value level) {
+        __unflushed += bytes;
+        const flushPolicy& p = __flush_policy;
+        if ((level >= p.__level && level != logLevel::value::OFF) || (p.__bytes > 0 && __unflushed >= p.__bytes))
+            flushNow();
+        else
+            flushIfDue();
+    }
+    void account(size_t bytes, int64_t ns) {
+        __writes.fetch_add(1, std::memory_order_relaxed);
+        __bytes.fetch_add(bytes, std::memory_order_relaxed);
+        __write_ns.fetch_add(ns, std::memory_order_relaxed);
+        updateMax(__write_max_ns, ns);
+    }
 };
 // 标准输出
 class stdoutSink : public logSink {
 public:
     void log(const char* data, size_t len) { std::cout.write(data, len); }
+    void flush() { std::cout.flush(); }
+};
+// ofstream 拿不到文件描述符，需要 fdatasync 时另外打开同一个文件
+class fileSyncer {
+private:
+    std::string __file_name;
+    int __fd; //
+public:
+    fileSyncer()
+        : __fd(-1) { }
+    ~fileSyncer() { reset(""); }
+    void reset(const std::string& file_name) {
+        if (__fd >= 0)
+            ::close(__fd);
+        __fd = -1;
+        __file_name = file_name;
+    } // 文件换了（滚动）之后调用
+    void sync() {
+        if (__fd < 0 && !__file_name.empty())
+            __fd = ::open(__file_name.c_str(), O_WRONLY | O_CLOEXEC);
+        if (__fd >= 0)
+            fdatasync(__fd);
+    }
 };
 // 指定文件
 class fileSink : public logSink {
 private:
     std::ofstream __ofs;
-    std::string __file_name; //
+    std::string __file_name;
+    fileSyncer __syncer; //
 public:
     fileSink(const std::string& file_name)
         : __file_name(file_name) {
@@ -39,11 +205,71 @@ public:
         // 2. 创建并打开日志文件
         __ofs.open(__file_name, std::ios::binary | std::ios::app);
         assert(__ofs.is_open());
+        __syncer.reset(__file_name);
     }
     void log(const char* data, size_t len) {
         __ofs.write(data, len);
         assert(__ofs.good());
     }
+    void flush() { __ofs.flush(); }
+    void sync() { __syncer.sync(); }
+};
+// 指定文件，不经过 ofstream 的缓冲，直接把缓冲块交给内核
+// 异步日志器一次交付的多个缓冲块合并成一次 writev（或一次 io_uring 提交）
+enum class directIoType {
+    DIRECT_WRITEV,
+    DIRECT_IO_URING, // 内核不支持时自动退回到 writev
+};
+class directFileSink : public logSink {
+private:
+    int __fd;
+    std::string __file_name;
+    uringWriter __uring;
+    std::vector<struct iovec> __iov; // 处理部分写入时需要修改 iovec，拷贝一份
+public:
+    directFileSink(const std::string& file_name, directIoType type = directIoType::DIRECT_WRITEV)
+        : __file_name(file_name) {
+        util::File::createDirectory(util::File::path(file_name));
+        __fd = ::open(__file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        assert(__fd >= 0);
+        if (type == directIoType::DIRECT_IO_URING)
+            __uring.init();
+    }
+    ~directFileSink() {
+        if (__fd >= 0)
+            ::close(__fd);
+    }
+    bool usingUring() const { return __uring.ready(); }
+    void sync() { fdatasync(__fd); } // 没有用户态缓冲，不需要 flush
+    void log(const char* data, size_t len) {
+        struct iovec iov = { (void*)data, len };
+        logChunks(&iov, 1);
+    }
+    void logChunks(const struct iovec* iov, size_t cnt) {
+        __iov.assign(iov, iov + cnt);
+        struct iovec* cur = __iov.data();
+        struct iovec* end = cur + cnt;
+        while (cur != end) {
+            int n = (int)std::min<size_t>(end - cur, IOV_MAX);
+            ssize_t ret = __uring.ready() ? __uring.writev(__fd, cur, n) : ::writev(__fd, cur, n);
+            if (ret < 0) {
+                if (errno == EINTR || errno == EAGAIN)
+                    continue;
+                assert(false);
+                return;
+            }
+            // 跳过已经写完的部分，剩下的继续写
+            size_t done = ret;
+            while (cur != end && done >= cur->iov_len) {
+                done -= cur->iov_len;
+                ++cur;
+            }
+            if (cur != end) {
+                cur->iov_base = (char*)cur->iov_base + done;
+                cur->iov_len -= done;
+            }
+        }
+    }
 };
 // 滚动文件（以大小进行滚动）
 class rollSink : public logSink {
@@ -53,6 +279,7 @@ private:
     size_t __max_size; // 滚动的大小阈值
     size_t __cur_fsize; // 记录当前大小，避免重复查询文件状态（效率很低）
     size_t __name_cnt; // 文件名计数器
+    fileSyncer __syncer;
 public:
     rollSink(const std::string& base_name, size_t max_size)
         : __base_name(base_name)
@@ -63,19 +290,145 @@ public:
         util::File::createDirectory(util::File::path(path_name));
         __ofs.open(path_name, std::ios::binary | std::ios::app);
         assert(__ofs.is_open());
+        __syncer.reset(path_name);
     }
     void log(const char* data, size_t len) {
         if (__cur_fsize >= __max_size) {
             __ofs.close();
+            if (__flush_policy.__sync)
+                __syncer.sync(); // 写满的文件也要落盘
             std::string path_name = createNewFile();
             __ofs.open(path_name, std::ios::binary | std::ios::app);
             assert(__ofs.is_open());
+            __syncer.reset(path_name);
             __cur_fsize = 0;
+            __rolls.fetch_add(1, std::memory_order_relaxed);
         }
         __ofs.write(data, len);
         assert(__ofs.good());
         __cur_fsize += len;
-    } //
+    }
+    void flush() { __ofs.flush(); }
+    void sync() { __syncer.sync(); } //
+    bool nextWriteStartsFile() const { return __cur_fsize >= __max_size; }
+private:
+    std::string createNewFile() {
+        // 获取系统时间，以时间来构造文件名扩展名
+        time_t t = util::Date::now();
+        struct tm lt;
+        localtime_r(&t, &lt);
+        std::stringstream file_name;
+        file_name << __base_name;
+        file_name << lt.tm_year + 1900;
+        file_name << lt.tm_mon + 1;
+        file_name << lt.tm_mday;
+        file_name << lt.tm_hour;
+        file_name << lt.tm_min;
+        file_name << lt.tm_sec;
+        file_name << "-";
+        file_name << __name_cnt++;
+        file_name << ".log";
+        return file_name.str();
+    }
+};
+// 内存映射的滚动文件
+// 每个文件预先分配 max_size 大小并映射到内存，写日志就是一次 memcpy
+// 后台线程提前准备好下一个文件，滚动时只需要交换映射；写满的文件也由后台线程截断到实际大小并解除映射
+// 进程崩溃时已经拷贝进映射区的数据仍然在页缓存中，会由内核写回文件（文件末尾可能留有未使用的0字节）
+class mmapRollSink : public logSink {
+private:
+    struct segment {
+        int __fd = -1;
+        char* __addr = nullptr;
+        size_t __used = 0;
+        size_t __cap = 0; // 映射的大小，整块写入放不下时会扩大
+        std::string __name;
+    };
+    std::string __base_name; // {./log/base-}xxx.log
+    size_t __max_size; // 单个文件的大小
+    size_t __name_cnt; // 文件名计数器，只在构造函数和后台线程中使用
+    segment __cur; // 只在写日志的线程中使用
+    bool __whole_writes; // 不在换行处切开写入，见 keepWritesWhole
+    // 以下成员受 __mtx 保护
+    std::mutex __mtx;
+    std::condition_variable __cond;
+    segment __next; // 提前准备好的下一个文件
+    bool __next_ready;
+    std::vector<segment> __retired; // 等待后台线程收尾的文件
+    bool __stop;
+    std::thread __prepare_thread; //
+public:
+    mmapRollSink(const std::string& base_name, size_t max_size)
+        : __base_name(base_name)
+        , __max_size(max_size)
+        , __name_cnt(0)
+        , __whole_writes(false)
+        , __next_ready(false)
+        , __stop(false) {
+        assert(__max_size > 0);
+        util::File::createDirectory(util::File::path(base_name));
+        __cur = openSegment();
+        __prepare_thread = std::thread(&mmapRollSink::threadEntry, this);
+    }
+    ~mmapRollSink() {
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            __stop = true;
+        }
+        __cond.notify_all();
+        if (__prepare_thread.joinable())
+            __prepare_thread.join();
+        closeSegment(__cur);
+        if (__next_ready) {
+            // 没有用到的文件直接删除
+            munmap(__next.__addr, __next.__cap);
+            ::close(__next.__fd);
+            unlink(__next.__name.c_str());
+        }
+    }
+    void log(const char* data, size_t len) {
+        if (__whole_writes) {
+            struct iovec iov = { (void*)data, len };
+            logChunks(&iov, 1);
+            return;
+        }
+        while (len > 0) {
+            size_t avail = __max_size - __cur.__used;
+            size_t n = len;
+            if (n > avail) {
+                // 放不下时尽量在换行处切开，让每条日志完整地落在一个文件中
+                const char* nl = (const char*)memrchr(data, '\n', avail);
+                n = nl != nullptr ? nl - data + 1 : (__cur.__used > 0 ? 0 : avail);
+            }
+            memcpy(__cur.__addr + __cur.__used, data, n);
+            __cur.__used += n;
+            data += n;
+            len -= n;
+            if (len > 0 || __cur.__used == __max_size)
+                roll();
+        }
+    }
+    void logChunks(const struct iovec* iov, size_t cnt) {
+        if (!__whole_writes) {
+            logSink::logChunks(iov, cnt);
+            return;
+        }
+        // 写满之后才滚动，一次写入的所有数据放在同一个文件中，放不下时扩大当前文件
+        if (__cur.__used >= __max_size)
+            roll();
+        size_t len = 0;
+        for (size_t i = 0; i < cnt; ++i)
+            len += iov[i].iov_len;
+        if (__cur.__used + len > __cur.__cap)
+            grow(__cur, __cur.__used + len);
+        for (size_t i = 0; i < cnt; ++i) {
+            memcpy(__cur.__addr + __cur.__used, iov[i].iov_base, iov[i].iov_len);
+            __cur.__used += iov[i].iov_len;
+        }
+    }
+    void sync() { msync(__cur.__addr, __cur.__used, MS_SYNC); } // 拷贝进映射区就已经对内核可见，不需要 flush；写满的文件由后台线程截断时写回 //
+    void keepWritesWhole() { __whole_writes = true; } // 在第一次写入之前调用
+    bool nextWriteStartsFile() const { return __whole_writes && __cur.__used >= __max_size; }
 private:
     std::string createNewFile() {
         // 获取系统时间，以时间来构造文件名扩展名
@@ -95,6 +448,72 @@ private:
         file_name << ".log";
         return file_name.str();
     }
+    segment openSegment() {
+        segment seg;
+        seg.__name = createNewFile();
+        seg.__fd = ::open(seg.__name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        assert(seg.__fd >= 0);
+        // 预先分配磁盘空间，文件系统不支持时退回到 ftruncate
+        if (fallocate(seg.__fd, 0, 0, __max_size) < 0) {
+            int ret = ftruncate(seg.__fd, __max_size);
+            assert(ret == 0);
+            (void)ret;
+        }
+        void* addr = mmap(nullptr, __max_size, PROT_READ | PROT_WRITE, MAP_SHARED, seg.__fd, 0);
+        assert(addr != MAP_FAILED);
+        seg.__addr = (char*)addr;
+        seg.__cap = __max_size;
+        return seg;
+    }
+    void grow(segment& seg, size_t size) {
+        if (fallocate(seg.__fd, 0, 0, size) < 0) {
+            int ret = ftruncate(seg.__fd, size);
+            assert(ret == 0);
+            (void)ret;
+        }
+        void* addr = mremap(seg.__addr, seg.__cap, size, MREMAP_MAYMOVE);
+        assert(addr != MAP_FAILED);
+        seg.__addr = (char*)addr;
+        seg.__cap = size;
+    }
+    void closeSegment(segment& seg) {
+        munmap(seg.__addr, seg.__cap);
+        int ret = ftruncate(seg.__fd, seg.__used); // 去掉预分配但没有用到的部分
+        (void)ret;
+        ::close(seg.__fd);
+    }
+    void roll() {
+        std::unique_lock<std::mutex> lock(__mtx);
+        __cond.wait(lock, [&]() { return __next_ready; }); // 正常情况下下一个文件早已准备好
+        __retired.push_back(__cur);
+        __cur = __next;
+        __next_ready = false;
+        __rolls.fetch_add(1, std::memory_order_relaxed);
+        __cond.notify_all();
+    }
+    void threadEntry() {
+        while (true) {
+            std::vector<segment> retired;
+            bool prepare = false;
+            {
+                std::unique_lock<std::mutex> lock(__mtx);
+                __cond.wait(lock, [&]() { return __stop || !__next_ready || !__retired.empty(); });
+                retired.swap(__retired);
+                prepare = !__next_ready && !__stop;
+                if (__stop && retired.empty())
+                    break;
+            }
+            for (auto& e : retired)
+                closeSegment(e);
+            if (prepare) {
+                segment seg = openSegment();
+                std::unique_lock<std::mutex> lock(__mtx);
+                __next = seg;
+                __next_ready = true;
+                __cond.notify_all();
+            }
+        }
+    }
 };
 // easy factory mode
 class sinkFactory {
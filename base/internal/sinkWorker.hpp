@@ -0,0 +1,166 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_SINK_WORKER__
+#define __YUFC_SINK_WORKER__
+
+#include "buffer.hpp"
+#include "sink.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ffengc_log {
+#define DEFAULT_SINK_QUEUE_DEPTH 16
+// 根据缓冲块中记录的元数据生成日志视图
+inline void appendRecordViews(std::vector<recordView>& views, buffer& buf) {
+    const char* base = buf.begin();
+    for (const auto& e : buf.__records)
+        views.push_back({ base + e.__offset, e.__size, e.__level, e.__time_ns });
+}
+// 可以被多个 sink 共享的缓冲区，引用计数归零后回收复用
+// 内存池的块由 asyncLooper::lend 直接交给 sink 线程，这里只用于不属于内存池的缓冲区
+class bufferRecycler : public std::enable_shared_from_this<bufferRecycler> {
+private:
+    std::mutex __mtx;
+    std::vector<buffer*> __free;
+    size_t __max_free;
+    size_t __buf_size; // 和内存池的块一样大
+    size_t __allocated; // 已经分配的缓冲区数量（包括正在使用的） //
+public:
+    using ptr = std::shared_ptr<bufferRecycler>;
+    bufferRecycler(size_t max_free, size_t buf_size = DEFAULT_BUFFER_SIZE)
+        : __max_free(max_free)
+        , __buf_size(buf_size == 0 ? DEFAULT_BUFFER_SIZE : buf_size)
+        , __allocated(0) { }
+    ~bufferRecycler() {
+        for (auto e : __free)
+            delete e;
+    }
+    size_t allocatedBytes() {
+        std::unique_lock<std::mutex> lock(__mtx);
+        return __allocated * __buf_size;
+    }
+    std::shared_ptr<buffer> acquire() {
+        buffer* buf = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            if (!__free.empty()) {
+                buf = __free.back();
+                __free.pop_back();
+            } else
+                __allocated++;
+        }
+        if (buf == nullptr)
+            buf = new buffer(__buf_size);
+        // 删除器持有回收器的引用，保证回收器比所有缓冲区活得久
+        ptr self = shared_from_this();
+        return std::shared_ptr<buffer>(buf, [self](buffer* b) { self->release(b); });
+    } //
+private:
+    void release(buffer* buf) {
+        buf->reset();
+        buf->shrink(__buf_size); // 交换进来的缓冲区可能被撑大了
+        std::unique_lock<std::mutex> lock(__mtx);
+        if (__free.size() < __max_free) {
+            __free.push_back(buf);
+            return;
+        }
+        __allocated--;
+        lock.unlock();
+        delete buf;
+    }
+};
+// 每个 sink 独占的落地线程，一个慢的 sink 不会拖慢其他 sink
+class sinkWorker {
+private:
+    logSink::ptr __sink;
+    size_t __max_depth; // 队列中最多积压的缓冲区数量，满了之后阻塞异步线程
+    std::mutex __mtx;
+    std::condition_variable __not_empty;
+    std::condition_variable __not_full;
+    std::deque<std::shared_ptr<buffer>> __queue;
+    bool __stop;
+    std::thread __work_thread; //
+public:
+    using ptr = std::shared_ptr<sinkWorker>;
+    sinkWorker(const logSink::ptr& sink, size_t max_depth = DEFAULT_SINK_QUEUE_DEPTH)
+        : __sink(sink)
+        , __max_depth(max_depth == 0 ? 1 : max_depth)
+        , __stop(false) {
+        __work_thread = std::thread(&sinkWorker::threadEntry, this);
+    }
+    ~sinkWorker() { stop(); }
+    void push(const std::shared_ptr<buffer>& buf) {
+        std::unique_lock<std::mutex> lock(__mtx);
+        __not_full.wait(lock, [&]() { return __queue.size() < __max_depth; });
+        __queue.push_back(buf);
+        __not_empty.notify_one();
+    }
+    size_t depth() {
+        std::unique_lock<std::mutex> lock(__mtx);
+        return __queue.size();
+    } // 当前积压的缓冲区数量
+    void stop() {
+        {
+            std::unique_lock<std::mutex> lock(__mtx);
+            __stop = true;
+        }
+        __not_empty.notify_all();
+        if (__work_thread.joinable())
+            __work_thread.join();
+    } //
+private:
+    void threadEntry() {
+        std::vector<std::shared_ptr<buffer>> batch;
+        std::vector<struct iovec> iov;
+        std::vector<recordView> views;
+        bool records = __sink->wantsRecords();
+        size_t tick_ms = __sink->getFlushPolicy().__interval_ms; // 按时间刷新的 sink 空闲时也要定期检查
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(__mtx);
+                auto ready = [&]() { return __stop || !__queue.empty(); };
+                while (tick_ms > 0 && !ready()) {
+                    lock.unlock();
+                    __sink->flushIfDue();
+                    lock.lock();
+                    __not_empty.wait_for(lock, std::chrono::milliseconds(tick_ms), ready);
+                }
+                __not_empty.wait(lock, ready);
+                if (__queue.empty())
+                    break; // 停止前先把队列中的数据落地
+                // 一次取走所有积压的缓冲区，合并成一次写入
+                batch.assign(__queue.begin(), __queue.end());
+                __queue.clear();
+                __not_full.notify_all();
+            }
+            if (records) {
+                views.clear();
+                for (const auto& e : batch)
+                    appendRecordViews(views, *e);
+                __sink->writeRecords(views.data(), views.size());
+            } else {
+                iov.clear();
+                logLevel::value level = logLevel::value::UNKNOW;
+                for (const auto& e : batch) {
+                    iov.push_back({ (void*)e->begin(), e->readableSize() });
+                    for (const auto& r : e->__records)
+                        level = std::max(level, r.__level);
+                }
+                __sink->writeChunks(iov.data(), iov.size(), level);
+            }
+            batch.clear(); // 释放引用，缓冲区回到回收器
+        }
+    }
+};
+} // namespace ffengc_log
+
+#endif
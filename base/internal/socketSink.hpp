@@ -0,0 +1,404 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_SOCKET_SINK__
+#define __YUFC_SOCKET_SINK__
+
+#include "sink.hpp"
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace ffengc_log {
+#define DEFAULT_SOCKET_RECONNECT_MS 1000
+#define DEFAULT_SOCKET_BACKLOG (4 * 1024 * 1024)
+#define SOCKET_BATCH_MAX 1024 // 一次 sendmmsg 最多发送的数据报数量
+enum class socketType {
+    UNIX_DGRAM, // 本地的数据报 socket，例如 /dev/log
+    UNIX_STREAM,
+    UDP, // 地址为 host:port
+    TCP,
+};
+enum class socketFraming {
+    RAW, // 原样发送格式化好的日志
+    RFC5424, // 加上 syslog 头；流式 socket 再按 RFC6587 在前面加上长度
+};
+struct socketConfig {
+    socketFraming __framing = socketFraming::RAW;
+    std::string __app_name = "-"; // RFC5424 的 APP-NAME
+    int __facility = 1; // RFC5424 的 facility，默认 user
+    size_t __reconnect_ms = DEFAULT_SOCKET_RECONNECT_MS; // 连接断开后最多每隔这么久重连一次
+    size_t __max_backlog = DEFAULT_SOCKET_BACKLOG; // 流式 socket 暂时发不出去的数据最多暂存这么多，超过的日志丢弃
+};
+struct socketStats {
+    size_t __sent_records = 0; // 交给内核（或暂存）的日志条数
+    size_t __sent_bytes = 0;
+    size_t __dropped_records = 0; // 没有连接、内核缓冲区满了或者暂存区满了而丢弃的条数
+    size_t __reconnects = 0; // 重新建立连接的次数
+};
+// 发往本地代理的 socket，异步日志器每轮的所有日志合并成一次 sendmmsg（数据报，每条日志一个）或一次 sendmsg（流）
+// socket 是非阻塞的，连接断开、对端处理不过来时丢弃日志并计数，不会阻塞异步线程
+// 地址在构造函数中解析，重连只调用 connect
+class socketSink : public logSink {
+private:
+    socketType __type;
+    std::string __address;
+    socketConfig __config;
+    struct sockaddr_storage __addr;
+    socklen_t __addr_len;
+    std::string __hostname;
+    std::string __procid;
+    // 以下成员只在写入 sink 的线程中使用
+    int __fd;
+    bool __connecting; // TCP 的非阻塞 connect 还没有完成
+    bool __ever_connected;
+    int64_t __last_attempt;
+    std::string __headers; // 本轮所有日志的 syslog 头
+    std::vector<size_t> __header_ends; // 每条日志的头在 __headers 中的结束位置
+    std::vector<struct iovec> __iov;
+    std::vector<struct mmsghdr> __msgs;
+    std::string __backlog; // 流式 socket 上次没发完的数据
+    time_t __time_sec; // RFC5424 时间戳缓存的秒
+    char __time_buf[32];
+    std::atomic<size_t> __sent_records;
+    std::atomic<size_t> __sent_bytes;
+    std::atomic<size_t> __dropped_records;
+    std::atomic<size_t> __reconnects; //
+public:
+    socketSink(socketType type, const std::string& address, const socketConfig& config = socketConfig())
+        : __type(type)
+        , __address(address)
+        , __config(config)
+        , __addr_len(0)
+        , __fd(-1)
+        , __connecting(false)
+        , __ever_connected(false)
+        , __time_sec(-1)
+        , __sent_records(0)
+        , __sent_bytes(0)
+        , __dropped_records(0)
+        , __reconnects(0) {
+        memset(&__addr, 0, sizeof(__addr));
+        bool ok = resolve();
+        assert(ok);
+        (void)ok;
+        char host[256] = { 0 };
+        if (gethostname(host, sizeof(host) - 1) != 0 || host[0] == '\0')
+            strcpy(host, "-");
+        __hostname = host;
+        __procid = std::to_string(getpid());
+        __last_attempt = util::Date::monotonicNs() - (int64_t)__config.__reconnect_ms * 1000000;
+        connect();
+    }
+    ~socketSink() {
+        // 暂存的数据最多再等 __reconnect_ms 发出去
+        int64_t deadline = util::Date::monotonicNs() + (int64_t)__config.__reconnect_ms * 1000000;
+        while (__fd >= 0 && !flushBacklog() && __fd >= 0) {
+            int64_t left_ms = (deadline - util::Date::monotonicNs()) / 1000000;
+            struct pollfd pfd = { __fd, POLLOUT, 0 };
+            if (left_ms <= 0 || ::poll(&pfd, 1, (int)left_ms) <= 0)
+                break;
+        }
+        if (__fd >= 0)
+            ::close(__fd);
+    }
+    bool wantsRecords() const { return true; } // 数据报按条发送，syslog 头需要等级和时间
+    void log(const char* data, size_t len) {
+        recordView record = { data, len, logLevel::value::UNKNOW, util::Date::nowNs() };
+        logRecords(&record, 1);
+    }
+    void logRecords(const recordView* records, size_t cnt) {
+        if (cnt == 0)
+            return;
+        if (!ensureConnected()) {
+            __dropped_records.fetch_add(cnt, std::memory_order_relaxed);
+            return;
+        }
+        buildFrames(records, cnt);
+        if (isDgram())
+            sendDatagrams(cnt);
+        else
+            sendStream(cnt);
+    }
+    void flush() {
+        if (__fd >= 0)
+            flushBacklog();
+    } // 流式 socket 暂存的数据在下一批日志到来时发送，配置了按时间刷新时空闲时也会发送
+    socketStats stats() const {
+        socketStats s;
+        s.__sent_records = __sent_records.load(std::memory_order_relaxed);
+        s.__sent_bytes = __sent_bytes.load(std::memory_order_relaxed);
+        s.__dropped_records = __dropped_records.load(std::memory_order_relaxed);
+        s.__reconnects = __reconnects.load(std::memory_order_relaxed);
+        return s;
+    } //
+private:
+    bool ensureConnected() {
+        if (__fd >= 0 && !__connecting)
+            return true;
+        if (__fd >= 0 && __connecting)
+            return finishConnect();
+        if (util::Date::monotonicNs() - __last_attempt < (int64_t)__config.__reconnect_ms * 1000000)
+            return false;
+        return connect();
+    } // 没有连接时按重连间隔尝试一次，不会阻塞
+    bool isDgram() const { return __type == socketType::UNIX_DGRAM || __type == socketType::UDP; }
+    bool isUnix() const { return __type == socketType::UNIX_DGRAM || __type == socketType::UNIX_STREAM; }
+    bool resolve() {
+        if (isUnix()) {
+            struct sockaddr_un* un = (struct sockaddr_un*)&__addr;
+            if (__address.size() >= sizeof(un->sun_path))
+                return false;
+            un->sun_family = AF_UNIX;
+            memcpy(un->sun_path, __address.c_str(), __address.size() + 1);
+            __addr_len = sizeof(struct sockaddr_un);
+            return true;
+        }
+        size_t pos = __address.rfind(':');
+        if (pos == std::string::npos)
+            return false;
+        std::string host = __address.substr(0, pos), port = __address.substr(pos + 1);
+        if (host.size() >= 2 && host.front() == '[' && host.back() == ']')
+            host = host.substr(1, host.size() - 2); // [::1]:514
+        struct addrinfo hints, *res = nullptr;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = isDgram() ? SOCK_DGRAM : SOCK_STREAM;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || res == nullptr)
+            return false;
+        memcpy(&__addr, res->ai_addr, res->ai_addrlen);
+        __addr_len = res->ai_addrlen;
+        freeaddrinfo(res);
+        return true;
+    }
+    bool connect() {
+        __last_attempt = util::Date::monotonicNs();
+        __fd = ::socket(__addr.ss_family, (isDgram() ? SOCK_DGRAM : SOCK_STREAM) | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (__fd < 0)
+            return false;
+        if (::connect(__fd, (struct sockaddr*)&__addr, __addr_len) == 0)
+            return connectDone();
+        if (errno == EINPROGRESS) {
+            __connecting = true;
+            return finishConnect();
+        }
+        disconnect();
+        return false;
+    }
+    bool finishConnect() {
+        struct pollfd pfd = { __fd, POLLOUT, 0 };
+        if (poll(&pfd, 1, 0) <= 0)
+            return false; // 还在连接中，这一轮的日志丢弃
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(__fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+            disconnect();
+            return false;
+        }
+        return connectDone();
+    }
+    bool connectDone() {
+        __connecting = false;
+        if (__ever_connected)
+            __reconnects.fetch_add(1, std::memory_order_relaxed);
+        __ever_connected = true;
+        return true;
+    }
+    void disconnect() {
+        if (__fd >= 0)
+            ::close(__fd);
+        __fd = -1;
+        __connecting = false;
+        __backlog.clear(); // 新连接从完整的一条日志开始
+    }
+    static int severity(logLevel::value level) {
+        switch (level) {
+        case logLevel::value::DEBUG:
+            return 7;
+        case logLevel::value::WARNING:
+            return 4;
+        case logLevel::value::ERROR:
+            return 3;
+        case logLevel::value::FATAL:
+            return 2;
+        default:
+            return 6; // INFO 和未知的等级
+        }
+    }
+    static size_t bodySize(const recordView& r) {
+        return (r.__size > 0 && r.__data[r.__size - 1] == '\n') ? r.__size - 1 : r.__size;
+    } // syslog 消息不带末尾的换行
+    void appendTime(int64_t time_ns) {
+        // 2024-05-01T12:00:00.123456Z，同一秒内只重新计算微秒部分
+        time_t sec = (time_t)(time_ns / util::Date::NS_PER_SEC);
+        if (sec != __time_sec) {
+            struct tm tm;
+            gmtime_r(&sec, &tm);
+            strftime(__time_buf, sizeof(__time_buf), "%Y-%m-%dT%H:%M:%S", &tm);
+            __time_sec = sec;
+        }
+        char frac[16];
+        snprintf(frac, sizeof(frac), ".%06dZ", (int)(time_ns % util::Date::NS_PER_SEC / 1000));
+        __headers.append(__time_buf);
+        __headers.append(frac);
+    }
+    void buildFrames(const recordView* records, size_t cnt) {
+        __headers.clear();
+        __header_ends.clear();
+        if (__config.__framing == socketFraming::RFC5424) {
+            for (size_t i = 0; i < cnt; ++i) {
+                // <PRI>1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG
+                size_t begin = __headers.size();
+                __headers.push_back('<');
+                __headers.append(std::to_string(__config.__facility * 8 + severity(records[i].__level)));
+                __headers.append(">1 ");
+                appendTime(records[i].__time_ns);
+                __headers.push_back(' ');
+                __headers.append(__hostname);
+                __headers.push_back(' ');
+                __headers.append(__config.__app_name);
+                __headers.push_back(' ');
+                __headers.append(__procid);
+                __headers.append(" - - ");
+                if (!isDgram()) {
+                    // 流式 socket 用长度分隔（octet counting）: LEN SP MSG
+                    std::string len = std::to_string(__headers.size() - begin + bodySize(records[i])) + " ";
+                    __headers.insert(begin, len);
+                }
+                __header_ends.push_back(__headers.size());
+            }
+        }
+        // __headers 写完之后再取指针
+        __iov.clear();
+        size_t header_begin = 0;
+        for (size_t i = 0; i < cnt; ++i) {
+            if (!__header_ends.empty()) {
+                __iov.push_back({ (void*)(__headers.data() + header_begin), __header_ends[i] - header_begin });
+                header_begin = __header_ends[i];
+                __iov.push_back({ (void*)records[i].__data, bodySize(records[i]) });
+            } else
+                __iov.push_back({ (void*)records[i].__data, records[i].__size });
+        }
+    }
+    size_t iovPerRecord() const { return __header_ends.empty() ? 1 : 2; }
+    void sendDatagrams(size_t cnt) {
+        size_t per = iovPerRecord();
+        __msgs.resize(cnt);
+        for (size_t i = 0; i < cnt; ++i) {
+            memset(&__msgs[i], 0, sizeof(__msgs[i]));
+            __msgs[i].msg_hdr.msg_iov = &__iov[i * per];
+            __msgs[i].msg_hdr.msg_iovlen = per;
+        }
+        size_t done = 0;
+        while (done < cnt) {
+            int ret = sendmmsg(__fd, &__msgs[done], std::min<size_t>(cnt - done, SOCKET_BATCH_MAX), MSG_NOSIGNAL);
+            if (ret > 0) {
+                for (int i = 0; i < ret; ++i)
+                    __sent_bytes.fetch_add(__msgs[done + i].msg_len, std::memory_order_relaxed);
+                __sent_records.fetch_add(ret, std::memory_order_relaxed);
+                done += ret;
+                continue;
+            }
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret < 0 && (errno == EMSGSIZE || (errno == ECONNREFUSED && __type == socketType::UDP))) {
+                // 太大的数据报，或者 UDP 对端上一次返回了端口不可达：只丢这一条
+                __dropped_records.fetch_add(1, std::memory_order_relaxed);
+                done += 1;
+                continue;
+            }
+            if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+                disconnect(); // 对端关闭了（本地 socket 文件被删除、重建等），之后按间隔重连
+            break; // 内核缓冲区满了，剩下的丢弃
+        }
+        __dropped_records.fetch_add(cnt - done, std::memory_order_relaxed);
+    }
+    bool flushBacklog() {
+        while (!__backlog.empty()) {
+            ssize_t ret = ::send(__fd, __backlog.data(), __backlog.size(), MSG_NOSIGNAL);
+            if (ret > 0) {
+                __backlog.erase(0, ret);
+                __sent_bytes.fetch_add(ret, std::memory_order_relaxed);
+                continue;
+            }
+            if (ret < 0 && errno == EINTR)
+                continue;
+            if (ret < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+                disconnect();
+            return false;
+        }
+        return true;
+    } // 返回暂存的数据是否已经全部发出
+    void sendStream(size_t cnt) {
+        size_t per = iovPerRecord();
+        size_t done = 0; // 已经完整交给内核的日志条数
+        size_t partial = 0; // 第 done 条已经发出的字节数
+        if (flushBacklog()) {
+            struct iovec* cur = __iov.data();
+            struct iovec* end = cur + __iov.size();
+            size_t skip = 0; // cur 中已经发出的字节数
+            while (cur != end) {
+                struct msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = cur;
+                msg.msg_iovlen = std::min<size_t>(end - cur, IOV_MAX);
+                cur->iov_base = (char*)cur->iov_base + skip;
+                cur->iov_len -= skip;
+                ssize_t ret = ::sendmsg(__fd, &msg, MSG_NOSIGNAL);
+                cur->iov_base = (char*)cur->iov_base - skip;
+                cur->iov_len += skip;
+                if (ret < 0) {
+                    if (errno == EINTR)
+                        continue;
+                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                        disconnect();
+                        __dropped_records.fetch_add(cnt - done, std::memory_order_relaxed);
+                        return;
+                    }
+                    break;
+                }
+                __sent_bytes.fetch_add(ret, std::memory_order_relaxed);
+                size_t sent = ret + skip;
+                while (cur != end && sent >= cur->iov_len) {
+                    sent -= cur->iov_len;
+                    ++cur;
+                }
+                skip = sent;
+            }
+            done = (cur - __iov.data()) / per;
+            for (struct iovec* p = __iov.data() + done * per; p != cur; ++p)
+                partial += p->iov_len;
+            partial += skip;
+            __sent_records.fetch_add(done, std::memory_order_relaxed);
+        } else if (__fd < 0) {
+            __dropped_records.fetch_add(cnt, std::memory_order_relaxed);
+            return;
+        }
+        // 发了一半的那条日志必须暂存起来，保证对端收到的每条日志都是完整的；后面的日志放得下就暂存，否则丢弃
+        for (size_t i = done; i < cnt; ++i) {
+            size_t bytes = 0;
+            for (size_t j = 0; j < per; ++j)
+                bytes += __iov[i * per + j].iov_len;
+            size_t skip = i == done ? partial : 0;
+            if (skip == 0 && __backlog.size() + bytes > __config.__max_backlog) {
+                __dropped_records.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            for (size_t j = 0; j < per; ++j) {
+                const struct iovec& v = __iov[i * per + j];
+                size_t n = std::min(skip, v.iov_len);
+                __backlog.append((const char*)v.iov_base + n, v.iov_len - n);
+                skip -= n;
+            }
+            __sent_records.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+};
+} // namespace ffengc_log
+
+#endif
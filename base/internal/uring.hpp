@@ -0,0 +1,161 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+#ifndef __YUFC_URING__
+#define __YUFC_URING__
+
+#include <algorithm>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define FFENGC_LOG_HAS_URING 1
+#endif
+#endif
+
+#ifdef FFENGC_LOG_HAS_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ffengc_log {
+#define DEFAULT_URING_ENTRIES 8
+// 最简单的 io_uring 封装，不依赖 liburing，直接使用系统调用
+// 只用来提交 writev：每次提交一个请求并等待它完成，调用者可以马上复用缓冲区
+// 内核不支持（或者被禁用）时 init 返回 false，调用者退回到 ::writev
+class uringWriter {
+#ifdef FFENGC_LOG_HAS_URING
+private:
+    int __ring_fd;
+    void* __sq_ptr;
+    size_t __sq_len;
+    void* __cq_ptr;
+    size_t __cq_len;
+    io_uring_sqe* __sqes;
+    size_t __sqes_len;
+    unsigned* __sq_head;
+    unsigned* __sq_tail;
+    unsigned* __sq_mask;
+    unsigned* __sq_array;
+    unsigned* __cq_head;
+    unsigned* __cq_tail;
+    unsigned* __cq_mask;
+    io_uring_cqe* __cqes; //
+public:
+    uringWriter()
+        : __ring_fd(-1)
+        , __sq_ptr(MAP_FAILED)
+        , __cq_ptr(MAP_FAILED)
+        , __sqes(nullptr) { }
+    ~uringWriter() { release(); }
+    uringWriter(const uringWriter&) = delete;
+    uringWriter& operator=(const uringWriter&) = delete;
+    bool init(unsigned entries = DEFAULT_URING_ENTRIES) {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        __ring_fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+        if (__ring_fd < 0)
+            return false;
+        // 需要内核支持 off = -1 表示使用文件当前位置（追加写）
+        if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+            release();
+            return false;
+        }
+        __sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        __cq_len = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single)
+            __sq_len = __cq_len = std::max(__sq_len, __cq_len);
+        __sq_ptr = mmap(nullptr, __sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, __ring_fd, IORING_OFF_SQ_RING);
+        if (__sq_ptr == MAP_FAILED) {
+            release();
+            return false;
+        }
+        __cq_ptr = single ? __sq_ptr : mmap(nullptr, __cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, __ring_fd, IORING_OFF_CQ_RING);
+        __sqes_len = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, __sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, __ring_fd, IORING_OFF_SQES);
+        if (sqes != MAP_FAILED)
+            __sqes = (io_uring_sqe*)sqes;
+        if (__cq_ptr == MAP_FAILED || sqes == MAP_FAILED) {
+            release();
+            return false;
+        }
+        char* sq = (char*)__sq_ptr;
+        __sq_head = (unsigned*)(sq + p.sq_off.head);
+        __sq_tail = (unsigned*)(sq + p.sq_off.tail);
+        __sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+        __sq_array = (unsigned*)(sq + p.sq_off.array);
+        char* cq = (char*)__cq_ptr;
+        __cq_head = (unsigned*)(cq + p.cq_off.head);
+        __cq_tail = (unsigned*)(cq + p.cq_off.tail);
+        __cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+        __cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+        return true;
+    }
+    bool ready() const { return __sqes != nullptr; }
+    ssize_t writev(int fd, const struct iovec* iov, int cnt) {
+        // 1. 填写提交队列项
+        unsigned tail = *__sq_tail;
+        unsigned idx = tail & *__sq_mask;
+        io_uring_sqe* sqe = &__sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = fd;
+        sqe->addr = (unsigned long long)(uintptr_t)iov;
+        sqe->len = cnt;
+        sqe->off = (unsigned long long)-1;
+        __sq_array[idx] = idx;
+        __atomic_store_n(__sq_tail, tail + 1, __ATOMIC_RELEASE);
+        // 2. 提交并等待完成
+        unsigned head = *__cq_head;
+        while (head == __atomic_load_n(__cq_tail, __ATOMIC_ACQUIRE)) {
+            unsigned to_submit = tail + 1 - __atomic_load_n(__sq_head, __ATOMIC_ACQUIRE);
+            int ret = (int)syscall(__NR_io_uring_enter, __ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret < 0 && errno != EINTR)
+                return -1;
+        }
+        // 3. 取出完成结果
+        int res = __cqes[head & *__cq_mask].res;
+        __atomic_store_n(__cq_head, head + 1, __ATOMIC_RELEASE);
+        if (res < 0) {
+            errno = -res;
+            return -1;
+        }
+        return res;
+    } // 返回值和 ::writev 一致
+private:
+    void release() {
+        if (__sqes != nullptr)
+            munmap(__sqes, __sqes_len);
+        if (__cq_ptr != MAP_FAILED && __cq_ptr != __sq_ptr)
+            munmap(__cq_ptr, __cq_len);
+        if (__sq_ptr != MAP_FAILED)
+            munmap(__sq_ptr, __sq_len);
+        if (__ring_fd >= 0)
+            close(__ring_fd);
+        __ring_fd = -1;
+        __sq_ptr = __cq_ptr = MAP_FAILED;
+        __sqes = nullptr;
+    }
+#else
+public:
+    bool init(unsigned entries = DEFAULT_URING_ENTRIES) { return false; }
+    bool ready() const { return false; }
+    ssize_t writev(int fd, const struct iovec* iov, int cnt) {
+        errno = ENOSYS;
+        return -1;
+    }
+#endif
+};
+} // namespace ffengc_log
+
+#endif
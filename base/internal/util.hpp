@@ -7,16 +7,83 @@
 #ifndef __YUFC_UTIL__
 #define __YUFC_UTIL__
 
+#include <atomic>
 #include <ctime>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
 
 namespace ffengc_log {
 namespace util {
+    // 只读字符串视图，不持有内存（C++11 没有 std::string_view）
+    // 注意：被引用的字符串必须比视图活得更久
+    class strView {
+    private:
+        const char* __data;
+        size_t __size; //
+    public:
+        strView()
+            : __data("")
+            , __size(0) { }
+        strView(const char* str)
+            : __data(str)
+            , __size(strlen(str)) { }
+        strView(const char* str, size_t len)
+            : __data(str)
+            , __size(len) { }
+        strView(const std::string& str)
+            : __data(str.c_str())
+            , __size(str.size()) { }
+        const char* data() const { return __data; }
+        size_t size() const { return __size; }
+        bool empty() const { return __size == 0; }
+        std::string str() const { return std::string(__data, __size); }
+    };
+    inline std::ostream& operator<<(std::ostream& out, const strView& sv) { return out.write(sv.data(), sv.size()); }
     class Date {
     public:
         static size_t now() { return (size_t)time(nullptr); }
+        // 高精度的当前时间（纳秒）
+        // 使用单调时钟加上校准偏移得到真实时间，每隔 CALIBRATE_INTERVAL 秒重新和系统时间校准一次
+        static int64_t nowNs() {
+            static std::atomic<int64_t> offset(calibrate());
+            static std::atomic<int64_t> next_calibrate(monotonicNs() + CALIBRATE_INTERVAL * NS_PER_SEC);
+            int64_t mono = monotonicNs();
+            if (mono >= next_calibrate.load(std::memory_order_relaxed)) {
+                next_calibrate.store(mono + CALIBRATE_INTERVAL * NS_PER_SEC, std::memory_order_relaxed);
+                offset.store(calibrate(), std::memory_order_relaxed);
+            }
+            return mono + offset.load(std::memory_order_relaxed);
+        } //
+    public:
+        static const int64_t NS_PER_SEC = 1000000000;
+        static const int64_t CALIBRATE_INTERVAL = 60; //
+        static int64_t monotonicNs() {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return (int64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+        } // 单调时钟，用于计算耗时
+    private:
+        static int64_t calibrate() {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            return (int64_t)ts.tv_sec * NS_PER_SEC + ts.tv_nsec - monotonicNs();
+        } // 真实时间和单调时间的差值
     };
     class File {
     public:
@@ -54,6 +121,233 @@ namespace util {
             }
         }
     };
+    // 线程标识：内核线程ID（和 top -H、perf 中看到的一致），以及应用注册的线程名
+    class Thread {
+    public:
+        // 每个线程只调用一次 gettid，之后读 thread_local
+        static pid_t id() {
+            pid_t& tid = cachedId();
+            if (tid == 0) {
+                static int registered = pthread_atfork(nullptr, nullptr, []() { cachedId() = 0; }); // fork 出的子进程中线程ID变了
+                (void)registered;
+                tid = (pid_t)syscall(SYS_gettid);
+            }
+            return tid;
+        }
+        // 给当前线程注册名字，%t{name} 和结构化格式化器会输出它；同时设置系统中的线程名（最多15个字符）
+        // 线程退出时自动注销
+        static void setName(const std::string& name) {
+            static thread_local nameGuard guard;
+            guard.__registered = true;
+            {
+                std::lock_guard<std::mutex> lock(registry().__mtx);
+                registry().__names[id()] = name;
+                cachedNameId() = intern(name);
+            }
+            pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+        }
+        // 当前线程名字的编号，0表示没有注册。日志记录产生时保存编号，异步线程格式化时写日志的线程可能已经退出
+        static uint32_t nameId() { return cachedNameId(); }
+        // 编号对应的名字，0或者未知的编号返回 nullptr；名字一旦分配了编号就一直保留，返回的指针始终有效
+        static const std::string* nameOf(uint32_t name_id) {
+            if (name_id == 0)
+                return nullptr;
+            std::lock_guard<std::mutex> lock(registry().__mtx);
+            if (name_id > registry().__interned.size())
+                return nullptr;
+            return &registry().__interned[name_id - 1];
+        }
+        // 查询线程名，没有注册过时返回 false
+        static bool name(pid_t tid, std::string& out) {
+            std::lock_guard<std::mutex> lock(registry().__mtx);
+            auto it = registry().__names.find(tid);
+            if (it == registry().__names.end())
+                return false;
+            out = it->second;
+            return true;
+        }
+    private:
+        struct nameRegistry {
+            std::mutex __mtx;
+            std::unordered_map<pid_t, std::string> __names;
+            std::deque<std::string> __interned; // 所有出现过的名字，下标加1就是编号，只增不删
+            std::unordered_map<std::string, uint32_t> __ids;
+        };
+        struct nameGuard {
+            bool __registered = false;
+            ~nameGuard() {
+                if (!__registered)
+                    return;
+                {
+                    std::lock_guard<std::mutex> lock(registry().__mtx);
+                    registry().__names.erase(id());
+                }
+                cachedNameId() = 0;
+            }
+        };
+        static pid_t& cachedId() {
+            static thread_local pid_t tid = 0;
+            return tid;
+        }
+        static uint32_t& cachedNameId() {
+            static thread_local uint32_t name_id = 0;
+            return name_id;
+        }
+        static uint32_t intern(const std::string& name) {
+            // 调用者持有 registry().__mtx；同名的线程共用一个编号，保留的内存只和不同名字的数量有关
+            auto it = registry().__ids.find(name);
+            if (it != registry().__ids.end())
+                return it->second;
+            registry().__interned.push_back(name);
+            uint32_t name_id = (uint32_t)registry().__interned.size();
+            registry().__ids.insert({ name, name_id });
+            return name_id;
+        }
+        static nameRegistry& registry() {
+            static nameRegistry* reg = new nameRegistry(); // 不析构，其他线程退出时还可能用到
+            return *reg;
+        }
+    };
+    // NUMA 拓扑和内存绑定的实现，默认的 systemNuma 读 /sys、调用 mbind；测试时可以用 Numa::setProvider 换成模拟多个节点的实现
+    class numaProvider {
+    public:
+        using ptr = std::shared_ptr<numaProvider>;
+        virtual ~numaProvider() { }
+        virtual int nodeCount() = 0;
+        virtual std::vector<int> cpusOfNode(int node) = 0; // 不存在的节点返回空
+        virtual int nodeOfCpu(int cpu) = 0;
+        virtual int currentNode() = 0; // 调用线程当前所在的节点
+        virtual bool bindMemory(void* addr, size_t len, int node) = 0; // addr 和 len 按页对齐，内存还没有被访问过
+    };
+    // 拓扑从 /sys 读取，内存绑定直接调用 mbind，不依赖 libnuma
+    class systemNuma : public numaProvider {
+    public:
+        int nodeCount() override { return (int)topology().__node_cpus.size(); }
+        std::vector<int> cpusOfNode(int node) override {
+            const topologyInfo& topo = topology();
+            if (node < 0 || node >= (int)topo.__node_cpus.size())
+                return std::vector<int>();
+            return topo.__node_cpus[node];
+        }
+        int nodeOfCpu(int cpu) override {
+            const topologyInfo& topo = topology();
+            if (cpu < 0 || cpu >= (int)topo.__cpu_node.size())
+                return 0;
+            return topo.__cpu_node[cpu];
+        }
+        int currentNode() override { return nodeOfCpu(sched_getcpu()); }
+        bool bindMemory(void* addr, size_t len, int node) override {
+            if (node < 0 || node >= MAX_NODES)
+                return false;
+            unsigned long mask = 1UL << node;
+            return syscall(SYS_mbind, addr, len, (unsigned long)BIND_PREFERRED, &mask, (unsigned long)MAX_NODES + 1, 0UL) == 0;
+        }
+    private:
+        static const int MAX_NODES = sizeof(unsigned long) * 8 - 1; // 内核只使用节点掩码的前 maxnode - 1 位，传入 MAX_NODES + 1
+        static const int BIND_PREFERRED = 1; // 即 <numaif.h> 中的 MPOL_PREFERRED
+        struct topologyInfo {
+            std::vector<std::vector<int>> __node_cpus; // 下标为节点编号
+            std::vector<int> __cpu_node; // 下标为CPU编号
+        };
+        // 解析 "0-3,8-11" 这样的列表
+        static std::vector<int> parseList(const std::string& list) {
+            std::vector<int> out;
+            size_t pos = 0;
+            while (pos < list.size()) {
+                size_t end = list.find(',', pos);
+                if (end == std::string::npos)
+                    end = list.size();
+                int first = 0, last = 0;
+                int n = sscanf(list.c_str() + pos, "%d-%d", &first, &last);
+                if (n == 1)
+                    last = first;
+                for (int i = first; n >= 1 && i <= last; ++i)
+                    out.push_back(i);
+                pos = end + 1;
+            }
+            return out;
+        }
+        static std::string readLine(const std::string& path) {
+            char line[4096] = { 0 };
+            FILE* fp = fopen(path.c_str(), "r");
+            if (fp == nullptr)
+                return "";
+            if (fgets(line, sizeof(line), fp) == nullptr)
+                line[0] = 0;
+            fclose(fp);
+            return line;
+        }
+        static topologyInfo loadTopology() {
+            topologyInfo topo;
+            for (int node : parseList(readLine("/sys/devices/system/node/online"))) {
+                if (node >= (int)topo.__node_cpus.size())
+                    topo.__node_cpus.resize(node + 1);
+                topo.__node_cpus[node] = parseList(readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+            }
+            if (topo.__node_cpus.empty()) {
+                // 没有 NUMA 信息，当作所有CPU都在0号节点
+                topo.__node_cpus.resize(1);
+                for (long i = 0; i < sysconf(_SC_NPROCESSORS_CONF); ++i)
+                    topo.__node_cpus[0].push_back((int)i);
+            }
+            for (size_t node = 0; node < topo.__node_cpus.size(); ++node) {
+                for (int cpu : topo.__node_cpus[node]) {
+                    if (cpu >= (int)topo.__cpu_node.size())
+                        topo.__cpu_node.resize(cpu + 1, 0);
+                    topo.__cpu_node[cpu] = (int)node;
+                }
+            }
+            return topo;
+        }
+        static const topologyInfo& topology() {
+            static topologyInfo topo = loadTopology();
+            return topo;
+        }
+    };
+    // CPU 亲和性和 NUMA 节点
+    // 只有一个节点，或者容器禁止了 mbind 时，绑定操作什么也不做
+    class Numa {
+    public:
+        static int nodeCount() { return provider()->nodeCount(); }
+        static std::vector<int> cpusOfNode(int node) { return provider()->cpusOfNode(node); }
+        static int nodeOfCpu(int cpu) { return provider()->nodeOfCpu(cpu); }
+        static int currentNode() { return provider()->currentNode(); }
+        // 让线程只在这些CPU上运行
+        static bool setAffinity(pthread_t thread, const std::vector<int>& cpus) {
+            if (cpus.empty())
+                return false;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int e : cpus)
+                if (e >= 0 && e < CPU_SETSIZE)
+                    CPU_SET(e, &set);
+            return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+        }
+        // 单独 mmap 一段内存，node >= 0 且有多个节点时在第一次访问之前绑定到这个节点
+        // 内存策略只作用在这段映射上，不会影响 malloc 堆中相邻的内存，也不需要迁移已经分配的页
+        static char* allocate(size_t len, int node = -1) {
+            void* addr = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (addr == MAP_FAILED)
+                throw std::bad_alloc();
+            if (node >= 0 && nodeCount() > 1)
+                provider()->bindMemory(addr, pageAlign(len), node);
+            return (char*)addr;
+        }
+        static void deallocate(char* addr, size_t len) { munmap(addr, len); }
+        static size_t pageAlign(size_t len) {
+            size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            return (len + page - 1) / page * page;
+        }
+        // 替换拓扑和内存绑定的实现，传入空指针恢复默认；只能在没有日志器使用 NUMA 功能时调用
+        static void setProvider(const numaProvider::ptr& provider_impl) {
+            provider() = provider_impl ? provider_impl : std::make_shared<systemNuma>();
+        }
+    private:
+        static numaProvider::ptr& provider() {
+            static numaProvider::ptr impl = std::make_shared<systemNuma>();
+            return impl;
+        }
+    };
 } // namespace util
 } // namespace ffengc_log
 
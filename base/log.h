@@ -13,25 +13,108 @@ namespace ffengc_log {
 /* Get a logger */
 logger::ptr getLogger(const std::string& name) { return loggerManager::getInstance().get(name); }
 /* Get default logger */
-logger::ptr rootLogger() { return loggerManager::getInstance().get_root(); }
+const logger::ptr& rootLogger() { return loggerManager::getInstance().get_root(); }
+/* Resolve the logger name once per call site (and per thread) */
+#define FFENGC_LOG_SITE(name) ([&]() -> ffengc_log::logger* { static thread_local ffengc_log::loggerSiteCache __site; return __site.get(name); }())
 // proxy
 #define debug(fmt, ...) debug(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
 #define info(fmt, ...) info(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
 #define warning(fmt, ...) warning(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
 #define error(fmt, ...) error(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
 #define fatal(fmt, ...) fatal(__FILE__, __LINE__, fmt, ##__VA_ARGS__)
-// default output
-#define DLOG_DEBUG(fmt, ...) ffengc_log::rootLogger()->debug(fmt, ##__VA_ARGS__);
-#define DLOG_INFO(fmt, ...) ffengc_log::rootLogger()->info(fmt, ##__VA_ARGS__);
-#define DLOG_WARNING(fmt, ...) ffengc_log::rootLogger()->warning(fmt, ##__VA_ARGS__);
-#define DLOG_ERROR(fmt, ...) ffengc_log::rootLogger()->error(fmt, ##__VA_ARGS__);
-#define DLOG_FATAL(fmt, ...) ffengc_log::rootLogger()->fatal(fmt, ##__VA_ARGS__);
-// logger output
-#define LOG_DEBUG(name, fmt, ...) ffengc_log::getLogger(name)->debug(fmt, ##__VA_ARGS__);
-#define LOG_INFO(name, fmt, ...) ffengc_log::getLogger(name)->info(fmt, ##__VA_ARGS__);
-#define LOG_WARNING(name, fmt, ...) ffengc_log::getLogger(name)->warning(fmt, ##__VA_ARGS__);
-#define LOG_ERROR(name, fmt, ...) ffengc_log::getLogger(name)->error(fmt, ##__VA_ARGS__);
-#define LOG_FATAL(name, fmt, ...) ffengc_log::getLogger(name)->fatal(fmt, ##__VA_ARGS__);
+// 编译期的最低输出等级，低于它的宏调用会被整个删除，例如 -DFFENGC_LOG_ACTIVE_LEVEL=FFENGC_LOG_LEVEL_WARNING
+#define FFENGC_LOG_LEVEL_DEBUG 1
+#define FFENGC_LOG_LEVEL_INFO 2
+#define FFENGC_LOG_LEVEL_WARNING 3
+#define FFENGC_LOG_LEVEL_ERROR 4
+#define FFENGC_LOG_LEVEL_FATAL 5
+#define FFENGC_LOG_LEVEL_OFF 6
+#ifndef FFENGC_LOG_ACTIVE_LEVEL
+#define FFENGC_LOG_ACTIVE_LEVEL FFENGC_LOG_LEVEL_DEBUG
+#endif
+// 先检查日志器的等级，通过了才计算参数并调用
+#define FFENGC_LOG_CALL(obj, lv, method, fmt, ...)                           \
+    do {                                                                     \
+        ffengc_log::logger* __ffengc_logger = (obj);                         \
+        if (__ffengc_logger->shouldLog(ffengc_log::logLevel::value::lv))     \
+            __ffengc_logger->method(fmt, ##__VA_ARGS__);                     \
+    } while (0);
+// 带限流的版本：先检查等级，再由调用点的限流器决定是否输出，被限流的日志不计算参数
+// 调用点注册到日志器，之后不再被调用时，剩下的汇总由日志器在空闲时和析构时输出
+// 例如 LOG_WARNING_LIMIT("net", ffengc_log::limitRate(10, 20), "timeout %d", fd)
+#define FFENGC_LOG_LIMIT_CALL(obj, lv, method, limit, fmt, ...)                                                               \
+    do {                                                                                                                      \
+        ffengc_log::logger* __ffengc_logger = (obj);                                                                          \
+        if (__ffengc_logger->shouldLog(ffengc_log::logLevel::value::lv)) {                                                    \
+            static ffengc_log::siteLimiter __ffengc_limiter(limit);                                                           \
+            __ffengc_limiter.attach(__ffengc_logger->limiters(), ffengc_log::logLevel::value::lv, __FILE__, __LINE__);        \
+            uint64_t __ffengc_suppressed = 0;                                                                                 \
+            bool __ffengc_pass = __ffengc_limiter.allow(__ffengc_suppressed);                                                 \
+            if (__ffengc_suppressed > 0)                                                                                      \
+                __ffengc_logger->method(SUPPRESS_REPORT_FMT, (unsigned long long)__ffengc_suppressed);                        \
+            if (__ffengc_pass)                                                                                                \
+                __ffengc_logger->method(fmt, ##__VA_ARGS__);                                                                  \
+        }                                                                                                                     \
+    } while (0);
+#define FFENGC_LOG_NOOP \
+    do {                \
+    } while (0);
+// default output and logger output
+#if FFENGC_LOG_ACTIVE_LEVEL <= FFENGC_LOG_LEVEL_DEBUG
+#define DLOG_DEBUG(fmt, ...) FFENGC_LOG_CALL(ffengc_log::rootLogger().get(), DEBUG, debug, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(name, fmt, ...) FFENGC_LOG_CALL(FFENGC_LOG_SITE(name), DEBUG, debug, fmt, ##__VA_ARGS__)
+#define DLOG_DEBUG_LIMIT(limit, fmt, ...) FFENGC_LOG_LIMIT_CALL(ffengc_log::rootLogger().get(), DEBUG, debug, limit, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG_LIMIT(name, limit, fmt, ...) FFENGC_LOG_LIMIT_CALL(FFENGC_LOG_SITE(name), DEBUG, debug, limit, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_DEBUG(fmt, ...) FFENGC_LOG_NOOP
+#define LOG_DEBUG(name, fmt, ...) FFENGC_LOG_NOOP
+#define DLOG_DEBUG_LIMIT(limit, fmt, ...) FFENGC_LOG_NOOP
+#define LOG_DEBUG_LIMIT(name, limit, fmt, ...) FFENGC_LOG_NOOP
+#endif
+#if FFENGC_LOG_ACTIVE_LEVEL <= FFENGC_LOG_LEVEL_INFO
+#define DLOG_INFO(fmt, ...) FFENGC_LOG_CALL(ffengc_log::rootLogger().get(), INFO, info, fmt, ##__VA_ARGS__)
+#define LOG_INFO(name, fmt, ...) FFENGC_LOG_CALL(FFENGC_LOG_SITE(name), INFO, info, fmt, ##__VA_ARGS__)
+#define DLOG_INFO_LIMIT(limit, fmt, ...) FFENGC_LOG_LIMIT_CALL(ffengc_log::rootLogger().get(), INFO, info, limit, fmt, ##__VA_ARGS__)
+#define LOG_INFO_LIMIT(name, limit, fmt, ...) FFENGC_LOG_LIMIT_CALL(FFENGC_LOG_SITE(name), INFO, info, limit, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_INFO(fmt, ...) FFENGC_LOG_NOOP
+#define LOG_INFO(name, fmt, ...) FFENGC_LOG_NOOP
+#define DLOG_INFO_LIMIT(limit, fmt, ...) FFENGC_LOG_NOOP
+#define LOG_INFO_LIMIT(name, limit, fmt, ...) FFENGC_LOG_NOOP
+#endif
+#if FFENGC_LOG_ACTIVE_LEVEL <= FFENGC_LOG_LEVEL_WARNING
+#define DLOG_WARNING(fmt, ...) FFENGC_LOG_CALL(ffengc_log::rootLogger().get(), WARNING, warning, fmt, ##__VA_ARGS__)
+#define LOG_WARNING(name, fmt, ...) FFENGC_LOG_CALL(FFENGC_LOG_SITE(name), WARNING, warning, fmt, ##__VA_ARGS__)
+#define DLOG_WARNING_LIMIT(limit, fmt, ...) FFENGC_LOG_LIMIT_CALL(ffengc_log::rootLogger().get(), WARNING, warning, limit, fmt, ##__VA_ARGS__)
+#define LOG_WARNING_LIMIT(name, limit, fmt, ...) FFENGC_LOG_LIMIT_CALL(FFENGC_LOG_SITE(name), WARNING, warning, limit, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_WARNING(fmt, ...) FFENGC_LOG_NOOP
+#define LOG_WARNING(name, fmt, ...) FFENGC_LOG_NOOP
+#define DLOG_WARNING_LIMIT(limit, fmt, ...) FFENGC_LOG_NOOP
+#define LOG_WARNING_LIMIT(name, limit, fmt, ...) FFENGC_LOG_NOOP
+#endif
+#if FFENGC_LOG_ACTIVE_LEVEL <= FFENGC_LOG_LEVEL_ERROR
+#define DLOG_ERROR(fmt, ...) FFENGC_LOG_CALL(ffengc_log::rootLogger().get(), ERROR, error, fmt, ##__VA_ARGS__)
+#define LOG_ERROR(name, fmt, ...) FFENGC_LOG_CALL(FFENGC_LOG_SITE(name), ERROR, error, fmt, ##__VA_ARGS__)
+#define DLOG_ERROR_LIMIT(limit, fmt, ...) FFENGC_LOG_LIMIT_CALL(ffengc_log::rootLogger().get(), ERROR, error, limit, fmt, ##__VA_ARGS__)
+#define LOG_ERROR_LIMIT(name, limit, fmt, ...) FFENGC_LOG_LIMIT_CALL(FFENGC_LOG_SITE(name), ERROR, error, limit, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_ERROR(fmt, ...) FFENGC_LOG_NOOP
+#define LOG_ERROR(name, fmt, ...) FFENGC_LOG_NOOP
+#define DLOG_ERROR_LIMIT(limit, fmt, ...) FFENGC_LOG_NOOP
+#define LOG_ERROR_LIMIT(name, limit, fmt, ...) FFENGC_LOG_NOOP
+#endif
+#if FFENGC_LOG_ACTIVE_LEVEL <= FFENGC_LOG_LEVEL_FATAL
+#define DLOG_FATAL(fmt, ...) FFENGC_LOG_CALL(ffengc_log::rootLogger().get(), FATAL, fatal, fmt, ##__VA_ARGS__)
+#define LOG_FATAL(name, fmt, ...) FFENGC_LOG_CALL(FFENGC_LOG_SITE(name), FATAL, fatal, fmt, ##__VA_ARGS__)
+#define DLOG_FATAL_LIMIT(limit, fmt, ...) FFENGC_LOG_LIMIT_CALL(ffengc_log::rootLogger().get(), FATAL, fatal, limit, fmt, ##__VA_ARGS__)
+#define LOG_FATAL_LIMIT(name, limit, fmt, ...) FFENGC_LOG_LIMIT_CALL(FFENGC_LOG_SITE(name), FATAL, fatal, limit, fmt, ##__VA_ARGS__)
+#else
+#define DLOG_FATAL(fmt, ...) FFENGC_LOG_NOOP
+#define LOG_FATAL(name, fmt, ...) FFENGC_LOG_NOOP
+#define DLOG_FATAL_LIMIT(limit, fmt, ...) FFENGC_LOG_NOOP
+#define LOG_FATAL_LIMIT(name, limit, fmt, ...) FFENGC_LOG_NOOP
+#endif
 //
 } // namespace ffengc_log
 
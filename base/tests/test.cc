@@ -6,15 +6,35 @@
 
 #include "internal/buffer.hpp"
 #include "internal/format.hpp"
+#include "internal/gzipSink.hpp"
 #include "internal/level.hpp"
 #include "internal/logger.hpp"
 #include "internal/message.hpp"
+#include "internal/rateLimit.hpp"
 #include "internal/sink.hpp"
 #include "internal/util.hpp"
+#include <climits>
+#include <arpa/inet.h>
+#include <dirent.h>
 #include <gtest/gtest.h>
+#include <malloc.h>
+#include <sys/wait.h>
 
 #define sink_extension false
 
+// 统计当前线程的堆内存分配次数
+static thread_local size_t alloc_count = 0;
+void* operator new(size_t size) {
+    ++alloc_count;
+    void* p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+
 class all_test : public testing::Environment {
 public:
     virtual void SetUp() override { }
@@ -199,9 +219,1663 @@ TEST(all_test, globalLoggerBuilder) {
     test_log();
 }
 
+// 统计收到的日志条数，用于校验异步日志器没有丢数据
+class countSink : public ffengc_log::logSink {
+public:
+    std::atomic<size_t> __lines;
+    std::atomic<size_t> __bytes;
+    countSink()
+        : __lines(0)
+        , __bytes(0) { }
+    void log(const char* data, size_t len) override {
+        __lines += std::count(data, data + len, '\n');
+        __bytes += len;
+    }
+};
+TEST(all_test, async_lockfree_test) {
+    std::shared_ptr<countSink> sink = std::make_shared<countSink>();
+    {
+        ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%m%n"));
+        ffengc_log::logger::ptr logger(new ffengc_log::asyncLogger("lockfree_logger", ffengc_log::logLevel::value::DEBUG, fmt, { sink }, ffengc_log::asyncType::ASYNC_LOCKFREE));
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 8; ++i) {
+            threads.emplace_back([&]() {
+                for (int j = 0; j < 10000; ++j)
+                    logger->info(__FILE__, __LINE__, "%d", j);
+            });
+        }
+        // 超过环容量的日志走加锁的缓冲区
+        std::string big(DEFAULT_RING_SIZE * 2, 'A');
+        logger->info(__FILE__, __LINE__, "%s", big.c_str());
+        for (auto& t : threads)
+            t.join();
+    } // 日志器析构时会把剩余的数据全部落地
+    ASSERT_EQ(sink->__lines, 8 * 10000 + 1);
+
+    // 线程之后只向另一个looper写日志时，已经析构的looper的环形缓冲区也要立即释放
+    auto vmSize = []() {
+        std::ifstream ifs("/proc/self/status");
+        std::string line;
+        while (std::getline(ifs, line))
+            if (line.compare(0, 7, "VmSize:") == 0)
+                return std::stoul(line.substr(7)) * 1024;
+        return 0ul;
+    };
+    const size_t big_ring = 256 << 20; // 只映射不访问，不占物理内存
+    ffengc_log::asyncLooper::ptr keep(new ffengc_log::asyncLooper([](ffengc_log::buffer&) { }, ffengc_log::asyncType::ASYNC_LOCKFREE));
+    size_t before = vmSize();
+    ffengc_log::asyncLooper::ptr brief(new ffengc_log::asyncLooper([](ffengc_log::buffer&) { }, ffengc_log::asyncType::ASYNC_LOCKFREE, big_ring));
+    std::atomic<int> step(0);
+    std::thread producer([&]() {
+        brief->push("a\n", 2);
+        keep->push("b\n", 2);
+        step = 1;
+        while (step != 2)
+            std::this_thread::yield();
+        for (int i = 0; i < 100; ++i)
+            keep->push("c\n", 2); // 一直命中线程本地缓存
+        step = 3;
+        while (step != 4)
+            std::this_thread::yield();
+    });
+    while (step != 1)
+        std::this_thread::yield();
+    ASSERT_GE(vmSize(), before + big_ring);
+    brief.reset();
+    step = 2;
+    while (step != 3)
+        std::this_thread::yield();
+    size_t after = vmSize();
+    step = 4;
+    producer.join();
+    ASSERT_LT(after, before + big_ring / 2);
+}
+
+class nullSink : public ffengc_log::logSink {
+public:
+    void log(const char* /*data*/, size_t /*len*/) override { }
+};
+TEST(all_test, zero_alloc_test) {
+    // 稳态下，同步日志器每条日志都不应该有堆内存分配
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter());
+    ffengc_log::logger::ptr logger(new ffengc_log::syncLogger("zero_alloc_logger", ffengc_log::logLevel::value::DEBUG, fmt, { std::make_shared<nullSink>() }));
+    std::string str(100, 'A');
+    for (int i = 0; i < 10; ++i)
+        logger->info(__FILE__, __LINE__, "%s %d", str.c_str(), i); // 预热线程本地缓冲区
+    size_t before = alloc_count;
+    for (int i = 0; i < 1000; ++i) {
+        logger->info(__FILE__, __LINE__, "%s %d %f", str.c_str(), i, 3.14);
+        logger->debug(__FILE__, __LINE__, "no args");
+    }
+    ASSERT_EQ(alloc_count - before, 0);
+    // 超过固定缓冲区的日志走 overflow，之后复用它的容量
+    std::string big(LOG_STREAM_SIZE * 4, 'B');
+    logger->fatal(__FILE__, __LINE__, "%s", big.c_str());
+    before = alloc_count;
+    for (int i = 0; i < 100; ++i)
+        logger->fatal(__FILE__, __LINE__, "%s", big.c_str());
+    ASSERT_EQ(alloc_count - before, 0);
+}
+
+constexpr char static_pattern[] = "abc%%abc[%d{%H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n";
+constexpr char thread_name_pattern[] = "%t{name} %t%n";
+TEST(all_test, static_format_test) {
+    // 编译期解析的格式化器和运行时解析的格式化器输出必须一致
+    ffengc_log::logMessage msg(ffengc_log::logLevel::value::INFO,
+        53,
+        "main.c",
+        "root",
+        "fmt test...");
+    ffengc_log::formatter runtime_fmt(static_pattern);
+    ffengc_log::staticFormatter<static_pattern> static_fmt;
+    ASSERT_EQ(runtime_fmt.format(msg), static_fmt.format(msg));
+    // 通过建造者使用
+    std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+    builder->buildLoggerName("static_format_logger");
+    builder->buildFormatter<static_pattern>();
+    builder->buildSink<nullSink>();
+    auto logger = builder->build();
+    logger->info(__FILE__, __LINE__, "%s", "static format");
+}
+
+TEST(all_test, time_cache_test) {
+    ffengc_log::logMessage msg(ffengc_log::logLevel::value::INFO, 53, "main.c", "root", "fmt test...");
+    ffengc_log::formatter fmt("%d{%Y-%m-%d %H:%M:%S.%3N|%6N|%N|%%N}");
+    time_t base = 1700000000; // 秒数为20，方便测试同一分钟内的缓存
+    // 同一分钟内、跨分钟、时间倒退的情况都要和 strftime 的结果一致
+    for (time_t sec : { base, base, base + 5, base + 39, base + 40, base + 3600, base - 10 }) {
+        msg.__ctime = sec;
+        msg.__cnsec = 123456789;
+        struct tm t;
+        localtime_r(&sec, &t);
+        char expect[64];
+        strftime(expect, sizeof(expect), "%Y-%m-%d %H:%M:%S", &t);
+        ASSERT_EQ(fmt.format(msg), std::string(expect) + ".123|123456|123456789|%N");
+    }
+    msg.__cnsec = 7000;
+    ASSERT_EQ(fmt.format(msg).substr(20), "000|000007|000007000|%N");
+}
+
+// 把收到的日志保存下来，用于比较输出内容
+class stringSink : public ffengc_log::logSink {
+public:
+    std::mutex __mtx;
+    std::string __data;
+    void log(const char* data, size_t len) override {
+        std::unique_lock<std::mutex> lock(__mtx);
+        __data.append(data, len);
+    }
+};
+void binary_test_log(ffengc_log::logger::ptr logger) {
+    logger->info(__FILE__, 1, "int %d, long %ld, llong %lld, size %zu, hex %#08x", -1, 2L, 3LL, (size_t)4, 255);
+    logger->warning(__FILE__, 2, "double %.3f, %e, %Lf, width %*d, prec %.*s|", 3.14159, 1e10, (long double)2.5, 6, 42, 3, "abcdef");
+    logger->error(__FILE__, 3, "str %s, null %s, char %c, 100%%, %5s|%-5s|", "hello", (char*)nullptr, 'x', "ab", "cd");
+    logger->fatal(__FILE__, 4, "no args");
+    logger->debug(__FILE__, 5, "ptr %p, unknown %y", (void*)0x1234);
+}
+TEST(all_test, binary_logger_test) {
+    // 延迟格式化的结果必须和同步日志器一致
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("[%t][%c][%f:%l][%p] %m%n"));
+    std::shared_ptr<stringSink> expect = std::make_shared<stringSink>();
+    std::shared_ptr<stringSink> deferred = std::make_shared<stringSink>();
+    std::shared_ptr<stringSink> dump = std::make_shared<stringSink>();
+    binary_test_log(std::make_shared<ffengc_log::syncLogger>("binary", ffengc_log::logLevel::value::DEBUG, fmt, std::vector<ffengc_log::logSink::ptr> { expect }));
+    {
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+        builder->buildLoggerName("binary");
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_BINARY);
+        builder->buildFormatter(fmt);
+        builder->buildSink<ffengc_log::fileSink>("./logfile/binary_test.log"); // 同时验证普通 sink 可以正常使用
+        auto logger = builder->build();
+        binary_test_log(std::make_shared<ffengc_log::binaryLogger>("binary", ffengc_log::logLevel::value::DEBUG, fmt, std::vector<ffengc_log::logSink::ptr> { deferred }, ffengc_log::asyncType::ASYNC_SAFE));
+        binary_test_log(std::make_shared<ffengc_log::binaryLogger>("binary", ffengc_log::logLevel::value::DEBUG, fmt, std::vector<ffengc_log::logSink::ptr> { dump }, ffengc_log::asyncType::ASYNC_LOCKFREE, true));
+        binary_test_log(logger);
+    }
+    ASSERT_EQ(expect->__data, deferred->__data);
+    // 二进制数据可以被离线解码，分两次喂入数据模拟不完整的帧
+    ffengc_log::binary::decoder dec;
+    ffengc_log::logStream text;
+    size_t half = dump->__data.size() / 2;
+    size_t used = dec.decode(dump->__data.data(), half, *fmt, text);
+    ASSERT_NE(used, (size_t)-1);
+    std::string rest = dump->__data.substr(used);
+    ASSERT_EQ(dec.decode(rest.data(), rest.size(), *fmt, text), rest.size());
+    ASSERT_EQ(expect->__data, std::string(text.data(), text.size()));
+}
+
+// 每次落地都很慢的 sink
+class slowSink : public countSink {
+public:
+    void log(const char* data, size_t len) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        countSink::log(data, len);
+    }
+};
+class gateSink : public stringSink {
+public:
+    std::atomic<bool> __open;
+    std::atomic<bool> __entered; // 已经有写入在等待
+    gateSink()
+        : __open(false)
+        , __entered(false) { }
+    void log(const char* data, size_t len) override {
+        __entered = true;
+        while (!__open)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        stringSink::log(data, len);
+    }
+    size_t count(const std::string& str) {
+        size_t n = 0;
+        for (size_t pos = __data.find(str); pos != std::string::npos; pos = __data.find(str, pos + 1))
+            ++n;
+        return n;
+    }
+    size_t reportedDrops() {
+        // 把所有丢弃统计中的条数加起来
+        size_t n = 0;
+        const std::string key = " log records dropped";
+        for (size_t pos = __data.find(key); pos != std::string::npos; pos = __data.find(key, pos + 1)) {
+            size_t begin = __data.rfind(' ', pos - 1) + 1;
+            n += std::stoul(__data.substr(begin, pos - begin));
+        }
+        return n;
+    }
+};
+TEST(all_test, sink_worker_test) {
+    std::shared_ptr<countSink> fast = std::make_shared<countSink>();
+    std::shared_ptr<slowSink> slow = std::make_shared<slowSink>();
+    {
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+        builder->buildLoggerName("sink_worker_logger");
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+        builder->buildFormatter("%m%n");
+        builder->buildEnableSinkWorkers(4);
+        auto logger = builder->build();
+        ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%m%n"));
+        std::shared_ptr<ffengc_log::asyncLogger> async_logger = std::make_shared<ffengc_log::asyncLogger>("sink_worker_logger", ffengc_log::logLevel::value::DEBUG, fmt, std::vector<ffengc_log::logSink::ptr> { fast, slow }, ffengc_log::asyncType::ASYNC_SAFE, 4);
+        for (int i = 0; i < 20000; ++i)
+            async_logger->info(__FILE__, __LINE__, "%d", i);
+        ASSERT_EQ(async_logger->sinkQueueDepths().size(), 2);
+        ASSERT_LE(async_logger->sinkQueueDepths()[1], 4);
+    } // 析构时两个 sink 都要把数据全部落地
+    ASSERT_EQ(fast->__lines, 20000);
+    ASSERT_EQ(slow->__lines, 20000);
+    ASSERT_EQ(fast->__bytes, slow->__bytes);
+    // sink 线程持有的块也计入内存上限：sink 阻塞时，被接受的日志不能超过上限
+    const size_t chunk = 4096, limit = 4 * chunk;
+    const std::string msg(100, 'x');
+    for (auto type : { ffengc_log::asyncType::ASYNC_SAFE, ffengc_log::asyncType::ASYNC_UNSAFE }) {
+        std::shared_ptr<gateSink> gate = std::make_shared<gateSink>();
+        size_t accepted = 0, allocated = 0;
+        {
+            std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+            builder->buildLoggerName("sink_worker_limit");
+            builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+            if (type == ffengc_log::asyncType::ASYNC_UNSAFE)
+                builder->buildEnableUnsafeLoop();
+            builder->buildFormatter("%m%n");
+            builder->buildSink(gate);
+            builder->buildEnableSinkWorkers(4);
+            builder->buildBufferChunkSize(chunk);
+            builder->buildMemoryLimit(limit);
+            builder->buildOverflowPolicy(ffengc_log::overflowPolicy::DROP_NEWEST);
+            builder->buildDropReportInterval(0);
+            auto logger = builder->build();
+            for (int i = 0; i < 2000; ++i) {
+                logger->info(__FILE__, __LINE__, "%s", msg.c_str());
+                if (i % 100 == 99)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2)); // 让异步线程把块交给 sink 线程
+            }
+            ffengc_log::loggerMetrics m = logger->metrics();
+            allocated = m.__looper.__allocated_bytes;
+            accepted = 2000 - m.__looper.__dropped;
+            gate->__open = true; // 先放行再检查，检查失败时日志器也能正常析构
+        }
+        ASSERT_LE(allocated, limit);
+        ASSERT_GT(allocated, 0); // sink 线程手里的块仍然算在内
+        ASSERT_LE(accepted * (msg.size() + 1), limit);
+        ASSERT_EQ(gate->__data.size(), accepted * (msg.size() + 1));
+    }
+}
+
+TEST(all_test, buffer_pool_test) {
+    std::atomic<size_t> bytes(0);
+    std::atomic<size_t> max_chunk(0);
+    auto slow_cb = [&](ffengc_log::buffer& buf) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        bytes += buf.readableSize();
+        max_chunk = std::max(max_chunk.load(), buf.readableSize());
+    };
+    ffengc_log::bufferPoolConfig config;
+    config.__chunk_size = 64 * 1024;
+    config.__idle_ms = 100;
+    std::string msg(1000, 'A');
+    {
+        // 1. 非安全模式：消费者慢时会申请新的块，空闲之后把块还给操作系统
+        ffengc_log::asyncLooper looper(slow_cb, ffengc_log::asyncType::ASYNC_UNSAFE, DEFAULT_RING_SIZE, config);
+        for (int i = 0; i < 2000; ++i)
+            looper.push(msg.c_str(), msg.size());
+        ASSERT_GT(looper.allocatedBytes(), 2 * config.__chunk_size);
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        ASSERT_EQ(looper.allocatedBytes(), 0);
+    }
+    ASSERT_EQ(bytes, 2000 * msg.size());
+    ASSERT_LE(max_chunk, config.__chunk_size); // 写满一块就换新的，不会扩容
+    bytes = 0;
+    {
+        // 2. 设置了内存上限：生产者会阻塞，占用的内存不会超过上限
+        config.__max_bytes = 4 * config.__chunk_size;
+        ffengc_log::asyncLooper looper(slow_cb, ffengc_log::asyncType::ASYNC_SAFE, DEFAULT_RING_SIZE, config);
+        for (int i = 0; i < 2000; ++i) {
+            looper.push(msg.c_str(), msg.size());
+            ASSERT_LE(looper.allocatedBytes(), config.__max_bytes);
+        }
+        // 超过块大小的日志也不会阻塞
+        std::string big(config.__chunk_size * 3, 'B');
+        looper.push(big.c_str(), big.size());
+    }
+    ASSERT_EQ(bytes, 2000 * msg.size() + config.__chunk_size * 3);
+    // 3. 空闲超时为0：不释放空闲的块，消费者也不会空转
+    config.__max_bytes = 0;
+    config.__idle_ms = 0;
+    auto idleCpuNs = []() {
+        struct timespec cpu_start, cpu_end;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+        return (cpu_end.tv_sec - cpu_start.tv_sec) * 1000000000LL + (cpu_end.tv_nsec - cpu_start.tv_nsec);
+    };
+    {
+        ffengc_log::asyncLooper looper([](ffengc_log::buffer&) { }, ffengc_log::asyncType::ASYNC_SAFE, DEFAULT_RING_SIZE, config);
+        looper.push(msg.c_str(), msg.size());
+        ASSERT_LT(idleCpuNs(), 50000000); // 空转时会占满一个核
+        ASSERT_EQ(looper.allocatedBytes(), config.__chunk_size);
+    }
+    // 共享线程池的工作线程也不会一直检查这个 looper
+    {
+        ffengc_log::looperPool::ptr pool = std::make_shared<ffengc_log::looperPool>();
+        ffengc_log::asyncLooper looper([](ffengc_log::buffer&) { }, ffengc_log::asyncType::ASYNC_SAFE, DEFAULT_RING_SIZE, config, false,
+            ffengc_log::overflowConfig(), nullptr, 0, pool);
+        looper.push(msg.c_str(), msg.size());
+        ASSERT_LT(idleCpuNs(), 50000000);
+    }
+}
+
+TEST(all_test, direct_sink_test) {
+    std::vector<ffengc_log::directIoType> types = { ffengc_log::directIoType::DIRECT_WRITEV, ffengc_log::directIoType::DIRECT_IO_URING };
+    for (size_t t = 0; t < types.size(); ++t) {
+        std::string file_name = "./logfile/direct-" + std::to_string(t) + ".log";
+        remove(file_name.c_str());
+        {
+            std::shared_ptr<ffengc_log::directFileSink> sink = std::make_shared<ffengc_log::directFileSink>(file_name, types[t]);
+            // 1. 直接交付多个缓冲块
+            struct iovec iov[3] = { { (void*)"a", 1 }, { (void*)"bc", 2 }, { (void*)"\n", 1 } };
+            sink->logChunks(iov, 3);
+            // 2. 通过异步日志器交付
+            ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%m%n"));
+            ffengc_log::asyncLogger async_logger("direct_logger", ffengc_log::logLevel::value::DEBUG, fmt, std::vector<ffengc_log::logSink::ptr> { sink }, ffengc_log::asyncType::ASYNC_UNSAFE);
+            for (int i = 0; i < 20000; ++i)
+                async_logger.info(__FILE__, __LINE__, "%d", i);
+        }
+        std::ifstream ifs(file_name);
+        std::string line;
+        ASSERT_TRUE(std::getline(ifs, line));
+        ASSERT_EQ(line, "abc");
+        int expect = 0;
+        while (std::getline(ifs, line))
+            ASSERT_EQ(line, std::to_string(expect++));
+        ASSERT_EQ(expect, 20000);
+    }
+}
+
+static std::vector<std::string> list_files(const std::string& dir) {
+    std::vector<std::string> files;
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr)
+        return files;
+    while (struct dirent* e = readdir(d))
+        if (e->d_name[0] != '.')
+            files.push_back(dir + e->d_name);
+    closedir(d);
+    return files;
+}
+
+TEST(all_test, binary_segment_test) {
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("[%c][%f:%l][%p] %m%n"));
+    std::shared_ptr<stringSink> expect = std::make_shared<stringSink>();
+    binary_test_log(std::make_shared<ffengc_log::syncLogger>("binary", ffengc_log::logLevel::value::DEBUG, fmt, std::vector<ffengc_log::logSink::ptr> { expect }));
+    // 1. 两个日志器先后追加到同一个文件，中间的文件头可以被解码
+    std::shared_ptr<stringSink> dump = std::make_shared<stringSink>();
+    for (int i = 0; i < 2; ++i)
+        binary_test_log(std::make_shared<ffengc_log::binaryLogger>("binary", ffengc_log::logLevel::value::DEBUG, fmt, std::vector<ffengc_log::logSink::ptr> { dump }, ffengc_log::asyncType::ASYNC_SAFE, true));
+    ffengc_log::binary::decoder dec;
+    ffengc_log::logStream text;
+    ASSERT_EQ(dec.decode(dump->__data.data(), dump->__data.size(), *fmt, text), dump->__data.size());
+    ASSERT_EQ(std::string(text.data(), text.size()), expect->__data + expect->__data);
+    // 2. 滚动文件的每个分段都以文件头开始，可以单独解码；mmapRollSink 不会把一帧切到两个文件中
+    for (int kind = 0; kind < 2; ++kind) {
+        std::string dir = kind == 0 ? "./logfile/binary_roll/" : "./logfile/binary_mmap_roll/";
+        for (const auto& e : list_files(dir))
+            remove(e.c_str());
+        {
+            ffengc_log::logSink::ptr roll; // 每次写入之后都滚动
+            if (kind == 0)
+                roll = ffengc_log::sinkFactory::create<ffengc_log::rollSink>(dir + "seg-", 1);
+            else
+                roll = ffengc_log::sinkFactory::create<ffengc_log::mmapRollSink>(dir + "seg-", 1);
+            ffengc_log::binaryLogger obj("binary", ffengc_log::logLevel::value::DEBUG, fmt, { roll }, ffengc_log::asyncType::ASYNC_SAFE, true);
+            for (int i = 0; i < 3; ++i) {
+                uint64_t batches = obj.metrics().__looper.__batches;
+                obj.info(__FILE__, __LINE__, "segment %d", i);
+                obj.info(__FILE__, __LINE__, "segment %d again", i);
+                for (int j = 0; j < 100 && obj.metrics().__looper.__batches == batches; ++j)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10)); // 等这一轮落地，下一条日志进入新的分段
+            }
+        }
+        size_t segments = 0, lines = 0;
+        for (const auto& e : list_files(dir)) {
+            std::ifstream in(e, std::ios::binary);
+            std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            if (data.empty())
+                continue;
+            ffengc_log::binary::decoder seg_dec;
+            ffengc_log::logStream seg_text;
+            ASSERT_EQ(seg_dec.decode(data.data(), data.size(), *fmt, seg_text), data.size()) << e;
+            lines += std::count(seg_text.data(), seg_text.data() + seg_text.size(), '\n');
+            segments++;
+        }
+        ASSERT_GE(segments, 3) << dir; // 每轮至少一个分段，同一轮的两条日志也可能分开落地
+        ASSERT_EQ(lines, 6) << dir;
+    }
+}
+TEST(all_test, mmap_roll_test) {
+    std::string dir = "./logfile/mmap_roll/";
+    for (const auto& e : list_files(dir))
+        remove(e.c_str());
+    std::string expect;
+    size_t text_size = 0;
+    {
+        std::shared_ptr<ffengc_log::mmapRollSink> sink = std::make_shared<ffengc_log::mmapRollSink>(dir + "seg-", 4096);
+        ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%m%n"));
+        ffengc_log::syncLogger sync_logger("mmap_logger", ffengc_log::logLevel::value::DEBUG, fmt, std::vector<ffengc_log::logSink::ptr> { sink });
+        for (int i = 0; i < 5000; ++i) {
+            sync_logger.info(__FILE__, __LINE__, "%d", i);
+            expect += std::to_string(i) + "\n";
+        }
+        text_size = expect.size();
+        std::string big(10000, 'A'); // 比单个文件还大的数据会被切开
+        sink->log(big.c_str(), big.size());
+        expect += big;
+    }
+    // 按文件名中的计数器排序后拼接
+    std::vector<std::string> files = list_files(dir);
+    auto counter = [](const std::string& name) { return std::stoi(name.substr(name.rfind('-') + 1)); };
+    std::sort(files.begin(), files.end(), [&](const std::string& a, const std::string& b) { return counter(a) < counter(b); });
+    ASSERT_GT(files.size(), 8);
+    std::string content;
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::ifstream ifs(files[i], std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+        ASSERT_LE(data.size(), 4096); // 截断到实际大小
+        if (content.size() + data.size() <= text_size) {
+            ASSERT_EQ(data.back(), '\n'); // 日志没有被切到两个文件中
+        }
+        content += data;
+    }
+    ASSERT_EQ(content, expect);
+}
+
+TEST(all_test, gzip_roll_test) {
+    std::string dir = "./logfile/gzip_roll/";
+    for (const auto& e : list_files(dir))
+        remove(e.c_str());
+    std::string expect;
+    {
+        std::shared_ptr<ffengc_log::gzipRollSink> sink = std::make_shared<ffengc_log::gzipRollSink>(dir + "seg-", 64 * 1024);
+        ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("[%p][%c] %m%n"));
+        {
+            ffengc_log::asyncLogger obj("gzip_logger", ffengc_log::logLevel::value::DEBUG, fmt, { sink }, ffengc_log::asyncType::ASYNC_UNSAFE);
+            for (int i = 0; i < 50000; ++i) {
+                obj.info(__FILE__, __LINE__, "request %d done", i);
+                expect += "[INFO][gzip_logger] request " + std::to_string(i) + " done\n";
+            }
+        }
+        sink->waitCompressed(); // 已经滚动出去的文件都压缩完成
+        ffengc_log::compressStats stats = sink->stats();
+        ASSERT_GT(stats.__files, 3);
+        ASSERT_GT(stats.ratio(), 4);
+        std::weak_ptr<ffengc_log::gzipRollSink> weak = sink;
+        sink.reset(); // 析构时等待所有文件压缩完成
+        ASSERT_TRUE(weak.expired());
+    }
+    // 目录中只剩下压缩文件，按计数器排序后解压拼接
+    std::vector<std::string> files = list_files(dir);
+    auto counter = [](const std::string& name) { return std::stoi(name.substr(name.rfind('-') + 1)); };
+    std::sort(files.begin(), files.end(), [&](const std::string& a, const std::string& b) { return counter(a) < counter(b); });
+    ASSERT_GT(files.size(), 4);
+    std::string content;
+    size_t compressed = 0;
+    for (const auto& e : files) {
+        ASSERT_EQ(e.substr(e.size() - 7), ".log.gz");
+        struct stat st;
+        ASSERT_EQ(stat(e.c_str(), &st), 0);
+        compressed += st.st_size;
+        gzFile in = gzopen(e.c_str(), "rb");
+        ASSERT_TRUE(in != nullptr);
+        char chunk[4096];
+        int n = 0;
+        while ((n = gzread(in, chunk, sizeof(chunk))) > 0)
+            content.append(chunk, n);
+        gzclose(in);
+    }
+    ASSERT_EQ(content, expect);
+    ASSERT_LT(compressed * 4, expect.size());
+}
+
+TEST(all_test, registry_test) {
+    // 注册和查找同时进行，查找不加锁
+    std::atomic<bool> done(false);
+    std::thread reader([&]() {
+        while (!done)
+            ASSERT_TRUE(ffengc_log::loggerManager::getInstance().exists("root"));
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([t]() {
+            for (int i = 0; i < 50; ++i) {
+                std::string name = "registry_" + std::to_string(t) + "_" + std::to_string(i);
+                std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::globalLoggerBuilder());
+                builder->buildLoggerName(name);
+                builder->buildSink<nullSink>();
+                ffengc_log::logger::ptr obj = builder->build();
+                ASSERT_EQ(ffengc_log::loggerManager::getInstance().get(name), obj); // 注册完成后马上可见
+            }
+        });
+    }
+    for (auto& e : writers)
+        e.join();
+    done = true;
+    reader.join();
+    // 调用点缓存：名字不变时复用，名字变了重新查找
+    ffengc_log::loggerSiteCache site;
+    ffengc_log::logger* first = site.get("registry_0_0");
+    ASSERT_EQ(first, ffengc_log::loggerManager::getInstance().get("registry_0_0").get());
+    ASSERT_EQ(site.get("registry_0_0"), first);
+    ASSERT_EQ(site.get(std::string("registry_1_0")), ffengc_log::loggerManager::getInstance().get("registry_1_0").get());
+}
+
+TEST(all_test, level_check_test) {
+    std::shared_ptr<countSink> sink = std::make_shared<countSink>();
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%m%n"));
+    ffengc_log::syncLogger sync_logger("level_logger", ffengc_log::logLevel::value::WARNING, fmt, std::vector<ffengc_log::logSink::ptr> { sink });
+    ASSERT_FALSE(sync_logger.shouldLog(ffengc_log::logLevel::value::INFO));
+    ASSERT_TRUE(sync_logger.shouldLog(ffengc_log::logLevel::value::WARNING));
+    sync_logger.info(__FILE__, __LINE__, "%d", 1);
+    sync_logger.error(__FILE__, __LINE__, "%d", 2);
+    ASSERT_EQ(sink->__lines, 1);
+    // 运行时调整等级
+    sync_logger.setLevel(ffengc_log::logLevel::value::DEBUG);
+    ASSERT_EQ(sync_logger.level(), ffengc_log::logLevel::value::DEBUG);
+    sync_logger.debug(__FILE__, __LINE__, "%d", 3);
+    ASSERT_EQ(sink->__lines, 2);
+}
+
+TEST(all_test, fmt_api_test) {
+    std::shared_ptr<stringSink> sink = std::make_shared<stringSink>();
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%m%n"));
+    ffengc_log::logger::ptr logger(new ffengc_log::syncLogger("fmt_api_logger", ffengc_log::logLevel::value::DEBUG, fmt, { sink }));
+    logger->info(__FILE__, __LINE__, LOG_FMT("x={} y={} s={} {{}} }}"), 42, -7, std::string("str"));
+    logger->warning(__FILE__, __LINE__, LOG_FMT("{} {} {} {}"), LLONG_MIN, ULLONG_MAX, (short)-1, (unsigned char)200);
+    logger->error(__FILE__, __LINE__, LOG_FMT("{} {} {} {} {}"), 0.1, 1e20, 2.5f, 1.0 / 3, 100.0);
+    logger->fatal(__FILE__, __LINE__, LOG_FMT("{}{}{}|{}"), true, 'c', "literal", (const char*)nullptr);
+    logger->debug(__FILE__, __LINE__, LOG_FMT("no args"));
+    ASSERT_EQ(sink->__data, "x=42 y=-7 s=str {} }\n"
+                            "-9223372036854775808 18446744073709551615 -1 200\n"
+                            "0.1 1e+20 2.5 0.33333333333333331 100\n"
+                            "truecliteral|(null)\n"
+                            "no args\n");
+    // 被过滤的等级不格式化
+    logger->setLevel(ffengc_log::logLevel::value::ERROR);
+    logger->info(__FILE__, __LINE__, LOG_FMT("{}"), 1);
+    ASSERT_EQ(std::count(sink->__data.begin(), sink->__data.end(), '\n'), 5);
+    // 整数、字符串参数稳态下没有堆内存分配
+    ffengc_log::logger::ptr null_logger(new ffengc_log::syncLogger("fmt_alloc_logger", ffengc_log::logLevel::value::DEBUG, fmt, { std::make_shared<nullSink>() }));
+    null_logger->info(__FILE__, __LINE__, LOG_FMT("{} {}"), 1, "warm up");
+    size_t before = alloc_count;
+    for (int i = 0; i < 1000; ++i)
+        null_logger->info(__FILE__, __LINE__, LOG_FMT("i={} d={} s={}"), i, 0.5 * i, "abc");
+    ASSERT_EQ(alloc_count - before, 0);
+    // 二进制日志器：在生产者线程中格式化，作为字符串参数记录
+    std::shared_ptr<stringSink> binary_sink = std::make_shared<stringSink>();
+    {
+        ffengc_log::binaryLogger binary_logger("fmt_binary_logger", ffengc_log::logLevel::value::DEBUG, fmt, { binary_sink }, ffengc_log::asyncType::ASYNC_SAFE);
+        binary_logger.info(__FILE__, __LINE__, LOG_FMT("a={} b={}"), 1, "two");
+    }
+    ASSERT_EQ(binary_sink->__data, "a=1 b=two\n");
+}
+
+class recordSink : public ffengc_log::logSink {
+public:
+    std::mutex __mtx;
+    size_t __calls = 0;
+    size_t __records = 0;
+    size_t __errors = 0; // ERROR 等级的日志条数
+    bool __ok = true; // 每条日志都以换行结尾，并且带有时间戳
+    bool wantsRecords() const override { return true; }
+    void log(const char* /*data*/, size_t /*len*/) override { __ok = false; } // 不应该被调用
+    void logRecords(const ffengc_log::recordView* records, size_t cnt) override {
+        std::unique_lock<std::mutex> lock(__mtx);
+        __calls++;
+        for (size_t i = 0; i < cnt; ++i) {
+            __records++;
+            if (records[i].__level == ffengc_log::logLevel::value::ERROR)
+                __errors++;
+            if (records[i].__size == 0 || records[i].__data[records[i].__size - 1] != '\n' || records[i].__time_ns <= 0)
+                __ok = false;
+        }
+    }
+};
+
+TEST(all_test, record_batch_test) {
+    const size_t count = 20000;
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("[%p] %m%n"));
+    auto write = [&](ffengc_log::logger& obj) {
+        for (size_t i = 0; i < count; ++i) {
+            if (i % 4 == 0)
+                obj.error(__FILE__, __LINE__, "record %zu", i);
+            else
+                obj.info(__FILE__, __LINE__, "record %zu", i);
+        }
+        std::string big(DEFAULT_RING_SIZE * 2, 'A'); // 超过环容量的日志
+        obj.info(__FILE__, __LINE__, "%s", big.c_str());
+    };
+    std::vector<ffengc_log::asyncType> types = { ffengc_log::asyncType::ASYNC_SAFE, ffengc_log::asyncType::ASYNC_UNSAFE, ffengc_log::asyncType::ASYNC_LOCKFREE };
+    for (size_t worker_depth : { 0, 4 }) {
+        for (auto type : types) {
+            std::shared_ptr<recordSink> records = std::make_shared<recordSink>();
+            std::shared_ptr<countSink> bytes = std::make_shared<countSink>(); // 原有的 sink 照常工作
+            {
+                ffengc_log::asyncLogger obj("record_logger", ffengc_log::logLevel::value::DEBUG, fmt, { records, bytes }, type, worker_depth);
+                write(obj);
+            }
+            ASSERT_TRUE(records->__ok);
+            ASSERT_EQ(records->__records, count + 1);
+            ASSERT_EQ(records->__errors, count / 4);
+            ASSERT_LT(records->__calls, count); // 批量交付，调用次数少于日志条数
+            ASSERT_EQ(bytes->__lines, count + 1);
+        }
+    }
+    // 同步日志器和二进制日志器
+    std::shared_ptr<recordSink> sync_records = std::make_shared<recordSink>();
+    {
+        ffengc_log::syncLogger obj("record_sync_logger", ffengc_log::logLevel::value::DEBUG, fmt, { sync_records });
+        write(obj);
+    }
+    ASSERT_TRUE(sync_records->__ok);
+    ASSERT_EQ(sync_records->__records, count + 1);
+    ASSERT_EQ(sync_records->__errors, count / 4);
+    std::shared_ptr<recordSink> binary_records = std::make_shared<recordSink>();
+    {
+        ffengc_log::binaryLogger obj("record_binary_logger", ffengc_log::logLevel::value::DEBUG, fmt, { binary_records }, ffengc_log::asyncType::ASYNC_LOCKFREE);
+        write(obj);
+    }
+    ASSERT_TRUE(binary_records->__ok);
+    ASSERT_EQ(binary_records->__records, count + 1);
+    ASSERT_EQ(binary_records->__errors, count / 4);
+}
+
+void lazy_test_log(ffengc_log::logger& obj) {
+    for (int i = 0; i < 3000; ++i) {
+        obj.info(__FILE__, 100, "request %d", i);
+        obj.error(__FILE__, 200, LOG_FMT("failed {} {}"), i, "times");
+    }
+    std::string big(DEFAULT_RING_SIZE * 2, 'A'); // 超过环容量的日志
+    obj.warning(__FILE__, 300, "%s", big.c_str());
+}
+TEST(all_test, lazy_format_test) {
+    // 在异步线程中格式化的结果必须和同步日志器一致
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("[%t][%c][%f:%l][%p] %m%n"));
+    std::shared_ptr<stringSink> expect = std::make_shared<stringSink>();
+    {
+        ffengc_log::syncLogger obj("lazy", ffengc_log::logLevel::value::DEBUG, fmt, { expect });
+        lazy_test_log(obj);
+    }
+    std::vector<ffengc_log::asyncType> types = { ffengc_log::asyncType::ASYNC_SAFE, ffengc_log::asyncType::ASYNC_UNSAFE, ffengc_log::asyncType::ASYNC_LOCKFREE };
+    for (size_t worker_depth : { 0, 4 }) {
+        for (auto type : types) {
+            std::shared_ptr<stringSink> lazy = std::make_shared<stringSink>();
+            std::shared_ptr<recordSink> records = std::make_shared<recordSink>();
+            {
+                ffengc_log::asyncLogger obj("lazy", ffengc_log::logLevel::value::DEBUG, fmt, { lazy, records }, type, worker_depth, ffengc_log::bufferPoolConfig(), true);
+                lazy_test_log(obj);
+            }
+            ASSERT_EQ(expect->__data, lazy->__data);
+            ASSERT_TRUE(records->__ok);
+            ASSERT_EQ(records->__records, 6001);
+            ASSERT_EQ(records->__errors, 3000);
+        }
+    }
+    // 通过建造者开启
+    std::shared_ptr<countSink> count = std::make_shared<countSink>();
+    {
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+        builder->buildLoggerName("lazy_builder");
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+        builder->buildEnableLazyFormat();
+        builder->buildSink(count);
+        auto obj = builder->build();
+        lazy_test_log(*obj);
+    }
+    ASSERT_EQ(count->__lines, 6001);
+}
+
+// 打开之前所有的写入都阻塞，用来制造缓冲区满的情况
+TEST(all_test, overflow_policy_test) {
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("[%p] %m%n"));
+    ffengc_log::bufferPoolConfig pool;
+    pool.__chunk_size = 4096;
+    pool.__max_bytes = 2 * pool.__chunk_size;
+    auto run = [&](ffengc_log::asyncType type, ffengc_log::overflowPolicy policy, size_t count, size_t& dropped) {
+        std::shared_ptr<gateSink> sink = std::make_shared<gateSink>();
+        ffengc_log::overflowConfig overflow;
+        overflow.__policy = policy;
+        std::thread opener([&]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            sink->__open = true; // 需要阻塞的策略在这之后才能继续
+        });
+        {
+            ffengc_log::asyncLogger obj("overflow_logger", ffengc_log::logLevel::value::DEBUG, fmt, { sink }, type, 0, pool, false, overflow);
+            for (size_t i = 0; i < count; ++i) {
+                if (i % 2)
+                    obj.error(__FILE__, __LINE__, "msg %zu.", i);
+                else
+                    obj.info(__FILE__, __LINE__, "msg %zu.", i);
+            }
+            dropped = obj.droppedCount();
+        }
+        opener.join();
+        return sink;
+    };
+    const size_t count = 5000;
+    size_t dropped = 0;
+    // 1. 丢弃新日志：生产者不阻塞，收到的加上丢弃的等于写入的
+    auto newest = run(ffengc_log::asyncType::ASYNC_SAFE, ffengc_log::overflowPolicy::DROP_NEWEST, count, dropped);
+    ASSERT_GT(dropped, 0);
+    ASSERT_EQ(newest->count("] msg "), count - dropped);
+    ASSERT_GE(newest->count("log records dropped"), 1);
+    ASSERT_EQ(newest->reportedDrops(), dropped); // 最后一次统计之后的丢弃在析构时补上
+    ASSERT_NE(newest->__data.find("msg 0."), std::string::npos);
+    // 2. 丢弃旧日志（所有块都被消费者取走时只能丢弃新日志）
+    auto oldest = run(ffengc_log::asyncType::ASYNC_SAFE, ffengc_log::overflowPolicy::DROP_OLDEST, count, dropped);
+    ASSERT_GT(dropped, 0);
+    ASSERT_EQ(oldest->count("] msg "), count - dropped);
+    // 3. 按等级丢弃：ERROR 全部保留，只丢弃 INFO
+    auto level = run(ffengc_log::asyncType::ASYNC_SAFE, ffengc_log::overflowPolicy::DROP_BELOW_LEVEL, count, dropped);
+    ASSERT_GT(dropped, 0);
+    ASSERT_EQ(level->count("[ERROR] msg "), count / 2);
+    ASSERT_EQ(level->count("[INFO] msg "), count / 2 - dropped);
+    // 4. 自旋后阻塞：不丢日志
+    auto spin = run(ffengc_log::asyncType::ASYNC_SAFE, ffengc_log::overflowPolicy::SPIN_THEN_BLOCK, count, dropped);
+    ASSERT_EQ(dropped, 0);
+    ASSERT_EQ(spin->count("] msg "), count);
+    // 5. 无锁模式下环满了丢弃新日志
+    const size_t lockfree_count = 40000;
+    auto ring = run(ffengc_log::asyncType::ASYNC_LOCKFREE, ffengc_log::overflowPolicy::DROP_NEWEST, lockfree_count, dropped);
+    ASSERT_GT(dropped, 0);
+    ASSERT_EQ(ring->count("] msg "), lockfree_count - dropped);
+    ASSERT_EQ(ring->reportedDrops(), dropped);
+}
+
+TEST(all_test, metrics_test) {
+    // 1. 同步日志器：日志条数、每个 sink 的写入量和滚动次数
+    std::shared_ptr<countSink> count = std::make_shared<countSink>();
+    ffengc_log::logSink::ptr roll = ffengc_log::sinkFactory::create<ffengc_log::rollSink>("./logfile/metrics_roll-", 1024);
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%m%n"));
+    {
+        ffengc_log::syncLogger obj("metrics_sync", ffengc_log::logLevel::value::INFO, fmt, { count, roll });
+        for (int i = 0; i < 1000; ++i) {
+            obj.debug(__FILE__, __LINE__, "filtered %d", i); // 被过滤的不计数
+            obj.info(__FILE__, __LINE__, "%d", i);
+        }
+        ffengc_log::loggerMetrics m = obj.metrics();
+        ASSERT_EQ(m.__type, "sync");
+        ASSERT_EQ(m.__records, 1000);
+        ASSERT_FALSE(m.__has_looper);
+        ASSERT_EQ(m.__sinks.size(), 2);
+        ASSERT_EQ(m.__sinks[0].__writes, 1000);
+        ASSERT_EQ(m.__sinks[0].__bytes, count->__bytes);
+        ASSERT_EQ(m.__sinks[1].__bytes, count->__bytes);
+        ASSERT_GT(m.__sinks[1].__rolls, 0);
+    }
+    // 2. 异步日志器：通过管理器读取，慢 sink 和内存上限让生产者等待
+    std::shared_ptr<slowSink> slow = std::make_shared<slowSink>();
+    std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::globalLoggerBuilder());
+    builder->buildLoggerName("metrics_async");
+    builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+    builder->buildFormatter("%m%n");
+    builder->buildBufferChunkSize(4096);
+    builder->buildMemoryLimit(2 * 4096);
+    builder->buildSink(slow);
+    ffengc_log::logger::ptr obj = builder->build();
+    const int count_async = 3000;
+    for (int i = 0; i < count_async; ++i)
+        obj->info(__FILE__, __LINE__, "%d", i);
+    ffengc_log::loggerMetrics m;
+    for (int i = 0; i < 500; ++i) {
+        m = obj->metrics();
+        if (m.__looper.__pending_bytes == 0 && m.__sinks[0].__bytes == slow->__bytes && slow->__lines == count_async)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_EQ(slow->__lines, count_async);
+    ASSERT_EQ(m.__type, "async");
+    ASSERT_TRUE(m.__has_looper);
+    ASSERT_EQ(m.__records, count_async);
+    ASSERT_EQ(m.__looper.__bytes, slow->__bytes);
+    ASSERT_EQ(m.__sinks[0].__bytes, slow->__bytes);
+    ASSERT_GT(m.__looper.__batches, 0);
+    ASSERT_GE(m.__looper.__callback_ns, m.__looper.__batches * 20000000ULL); // 每次落地至少 20ms
+    ASSERT_GT(m.__looper.__producer_waits, 0);
+    ASSERT_GT(m.__looper.__producer_wait_ns, 0);
+    ASSERT_LE(m.__looper.__allocated_bytes, 2 * 4096);
+    // 3. 二进制日志器：printf、{} 和键值对三种接口每条只计一次
+    {
+        ffengc_log::binaryLogger binary("metrics_binary", ffengc_log::logLevel::value::DEBUG, fmt, { std::make_shared<nullSink>() }, ffengc_log::asyncType::ASYNC_SAFE);
+        binary.info(__FILE__, __LINE__, "%d", 1);
+        binary.info(__FILE__, __LINE__, LOG_FMT("{}"), 2);
+        binary.info(__FILE__, __LINE__, { { "k", 3 } }, "%d", 3);
+        ASSERT_EQ(binary.metrics().__records, 3);
+    }
+    // 4. 文本和 JSON 输出
+    std::string text = ffengc_log::loggerManager::getInstance().metricsText();
+    ASSERT_NE(text.find("logger metrics_async (async) records: 3000"), std::string::npos);
+    std::string json = ffengc_log::loggerManager::getInstance().metricsJson();
+    ASSERT_EQ(json.front(), '[');
+    ASSERT_EQ(json.back(), ']');
+    ASSERT_NE(json.find("{\"name\": \"metrics_async\", \"type\": \"async\", \"records\": 3000, \"looper\": {"), std::string::npos);
+    ASSERT_NE(json.find("{\"name\": \"root\", \"type\": \"sync\""), std::string::npos);
+}
+
+void structured_test_log(ffengc_log::logger& obj) {
+    obj.info(__FILE__, 7, { { "user", 42 }, { "neg", -5 }, { "ratio", 0.5 }, { "ok", true }, { "ip", std::string("10.0.0.1") }, { "q", "a b" } }, "login \"%s\"", "bob");
+    obj.warning(__FILE__, 8, "plain\ttab");
+}
+TEST(all_test, structured_test) {
+    // 1. 向量化的查找和逐字节查找结果一致
+    srand(7);
+    const char specials[] = { '"', '\\', '\n', '\x01', '\x1f', ' ', 'a', '\x7f', '\x80', '\xff' };
+    for (int i = 0; i < 2000; ++i) {
+        std::string str(rand() % 80, 'x');
+        if (!str.empty() && rand() % 4 != 0)
+            str[rand() % str.size()] = specials[rand() % sizeof(specials)];
+        const char* end = str.data() + str.size();
+        ASSERT_EQ(ffengc_log::structured::findEscape(str.data(), end), ffengc_log::structured::findEscapeScalar(str.data(), end));
+    }
+    ffengc_log::logStream escaped;
+    ffengc_log::structured::appendEscaped(escaped, "a\"b\\c\nd\x01\xe4\xb8\xad 0123456789abcdef\t");
+    ASSERT_EQ(escaped.view().str(), "a\\\"b\\\\c\\nd\\u0001\xe4\xb8\xad 0123456789abcdef\\t");
+    // 2. JSON、logfmt 和模式中的 %k
+    std::string tid = std::to_string(syscall(SYS_gettid)), file = __FILE__;
+    std::string json_expect = "{\"time\":\"T\",\"level\":\"INFO\",\"logger\":\"structured\",\"file\":\"" + file + "\",\"line\":7,\"tid\":" + tid
+        + ",\"msg\":\"login \\\"bob\\\"\",\"user\":42,\"neg\":-5,\"ratio\":0.5,\"ok\":true,\"ip\":\"10.0.0.1\",\"q\":\"a b\"}\n"
+        + "{\"time\":\"T\",\"level\":\"WARNING\",\"logger\":\"structured\",\"file\":\"" + file + "\",\"line\":8,\"tid\":" + tid
+        + ",\"msg\":\"plain\\ttab\"}\n";
+    std::string logfmt_expect = "time=T level=INFO logger=structured file=" + file + " line=7 tid=" + tid
+        + " msg=\"login \\\"bob\\\"\" user=42 neg=-5 ratio=0.5 ok=true ip=10.0.0.1 q=\"a b\"\n"
+        + "time=T level=WARNING logger=structured file=" + file + " line=8 tid=" + tid + " msg=\"plain\\ttab\"\n";
+    std::string pattern_expect = "[INFO] login \"bob\" user=42 neg=-5 ratio=0.5 ok=true ip=10.0.0.1 q=\"a b\"\n[WARNING] plain\ttab\n";
+    std::vector<std::pair<ffengc_log::formatter::ptr, std::string>> cases = {
+        { std::make_shared<ffengc_log::jsonFormatter>("T"), json_expect },
+        { std::make_shared<ffengc_log::logfmtFormatter>("T"), logfmt_expect },
+        { std::make_shared<ffengc_log::formatter>("[%p] %m%k%n"), pattern_expect },
+    };
+    for (auto& e : cases) {
+        std::shared_ptr<stringSink> sync_out = std::make_shared<stringSink>();
+        {
+            ffengc_log::syncLogger obj("structured", ffengc_log::logLevel::value::DEBUG, e.first, { sync_out });
+            structured_test_log(obj);
+        }
+        ASSERT_EQ(sync_out->__data, e.second);
+        // 异步日志器，包括在异步线程中格式化（键值对被拷贝进缓冲区）
+        for (bool lazy : { false, true }) {
+            std::shared_ptr<stringSink> async_out = std::make_shared<stringSink>();
+            {
+                ffengc_log::asyncLogger obj("structured", ffengc_log::logLevel::value::DEBUG, e.first, { async_out }, ffengc_log::asyncType::ASYNC_SAFE, 0, ffengc_log::bufferPoolConfig(), lazy);
+                structured_test_log(obj);
+            }
+            ASSERT_EQ(async_out->__data, e.second);
+        }
+    }
+    // 3. 二进制日志器把键值对拼在主体后面
+    std::shared_ptr<stringSink> binary_out = std::make_shared<stringSink>();
+    {
+        ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("[%p] %m%n"));
+        ffengc_log::binaryLogger obj("structured", ffengc_log::logLevel::value::DEBUG, fmt, { binary_out }, ffengc_log::asyncType::ASYNC_SAFE);
+        structured_test_log(obj);
+    }
+    ASSERT_EQ(binary_out->__data, pattern_expect);
+    // 4. 通过建造者选择
+    std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+    builder->buildLoggerName("structured_builder");
+    builder->buildJsonFormatter();
+    std::shared_ptr<stringSink> builder_out = std::make_shared<stringSink>();
+    builder->buildSink(builder_out);
+    builder->build()->error(__FILE__, __LINE__, { { "code", 500u } }, "failed");
+    ASSERT_EQ(builder_out->__data.front(), '{');
+    ASSERT_NE(builder_out->__data.find("\"level\":\"ERROR\""), std::string::npos);
+    ASSERT_NE(builder_out->__data.find(",\"msg\":\"failed\",\"code\":500}\n"), std::string::npos);
+}
+// 测试用的本地监听 socket
+static int listenSocket(int family, int type, const std::string& path, int& port) {
+    int fd = socket(family, type | SOCK_CLOEXEC, 0);
+    if (family == AF_UNIX) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path.c_str());
+        unlink(path.c_str());
+        bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    } else {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(fd, (struct sockaddr*)&addr, &len);
+        port = ntohs(addr.sin_port);
+    }
+    if (type == SOCK_STREAM)
+        listen(fd, 16);
+    struct timeval tv = { 2, 0 }; // 测试出错时不要一直阻塞
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+static std::vector<std::string> recvDatagrams(int fd, size_t cnt) {
+    std::vector<std::string> out;
+    char buf[65536];
+    for (size_t i = 0; i < cnt; ++i) {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0)
+            break;
+        out.push_back(std::string(buf, n));
+    }
+    return out;
+}
+static std::string recvStream(int conn) {
+    std::string out;
+    char buf[65536];
+    ssize_t n = 0;
+    while ((n = recv(conn, buf, sizeof(buf), 0)) > 0)
+        out.append(buf, n);
+    return out;
+}
+TEST(all_test, socket_sink_test) {
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("[%p] %m%n"));
+    int port = 0;
+    // 1. 本地数据报：每条日志一个数据报，原样发送；接收队列满时丢弃而不是阻塞后台线程
+    ffengc_log::util::File::createDirectory("./logfile/");
+    std::string dgram_path = "./logfile/sink_dgram.sock";
+    int dgram = listenSocket(AF_UNIX, SOCK_DGRAM, dgram_path, port);
+    std::shared_ptr<ffengc_log::socketSink> unix_dgram = std::make_shared<ffengc_log::socketSink>(ffengc_log::socketType::UNIX_DGRAM, dgram_path);
+    std::vector<std::string> got;
+    std::thread receiver([&]() {
+        char buf[65536];
+        ssize_t n = 0;
+        while ((n = recv(dgram, buf, sizeof(buf), 0)) > 0 && std::string(buf, n) != "[INFO] end\n")
+            got.push_back(std::string(buf, n));
+    });
+    {
+        ffengc_log::asyncLogger obj("socket_dgram", ffengc_log::logLevel::value::DEBUG, fmt, { unix_dgram }, ffengc_log::asyncType::ASYNC_SAFE);
+        for (int i = 0; i < 100; ++i) {
+            obj.info(__FILE__, __LINE__, "dgram %d", i);
+            if (i % 5 == 4)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        obj.info(__FILE__, __LINE__, "end");
+    }
+    receiver.join();
+    ffengc_log::socketStats dgram_stats = unix_dgram->stats();
+    ASSERT_EQ(dgram_stats.__sent_records + dgram_stats.__dropped_records, 101);
+    ASSERT_EQ(got.size() + 1, dgram_stats.__sent_records);
+    ASSERT_GT(got.size(), 0);
+    for (size_t i = 0, last = 0; i < got.size(); ++i) { // 收到的按顺序、内容完整
+        size_t idx = std::stoul(got[i].substr(13));
+        ASSERT_EQ(got[i], "[INFO] dgram " + std::to_string(idx) + "\n");
+        ASSERT_TRUE(i == 0 || idx > last);
+        last = idx;
+    }
+    close(dgram);
+    // 2. UDP + RFC5424
+    int udp = listenSocket(AF_INET, SOCK_DGRAM, "", port);
+    ffengc_log::socketConfig syslog_config;
+    syslog_config.__framing = ffengc_log::socketFraming::RFC5424;
+    syslog_config.__app_name = "ffengc_test";
+    std::shared_ptr<ffengc_log::socketSink> udp_sink = std::make_shared<ffengc_log::socketSink>(ffengc_log::socketType::UDP, "127.0.0.1:" + std::to_string(port), syslog_config);
+    {
+        ffengc_log::syncLogger obj("socket_udp", ffengc_log::logLevel::value::DEBUG, fmt, { udp_sink });
+        obj.error(__FILE__, __LINE__, "disk %s", "full");
+        obj.debug(__FILE__, __LINE__, "detail");
+    }
+    got = recvDatagrams(udp, 2);
+    ASSERT_EQ(got.size(), 2);
+    std::string tail = " ffengc_test " + std::to_string(getpid()) + " - - [ERROR] disk full";
+    ASSERT_EQ(got[0].substr(0, 6), "<11>1 "); // user.err
+    ASSERT_EQ(got[0].substr(got[0].size() - tail.size()), tail);
+    ASSERT_EQ(got[0][6 + 27], ' '); // 2024-05-01T12:00:00.123456Z
+    ASSERT_EQ(got[0][6 + 26], 'Z');
+    ASSERT_EQ(got[1].substr(0, 6), "<15>1 "); // user.debug
+    close(udp);
+    // 3. 本地流：监听方还不存在时丢弃日志，不阻塞；监听方出现后按间隔重连，RFC5424 的日志按长度分隔
+    std::string stream_path = "./logfile/sink_stream.sock";
+    unlink(stream_path.c_str());
+    syslog_config.__reconnect_ms = 50;
+    std::shared_ptr<ffengc_log::socketSink> unix_stream = std::make_shared<ffengc_log::socketSink>(ffengc_log::socketType::UNIX_STREAM, stream_path, syslog_config);
+    std::unique_ptr<ffengc_log::asyncLogger> obj(new ffengc_log::asyncLogger("socket_stream", ffengc_log::logLevel::value::DEBUG, fmt, { unix_stream }, ffengc_log::asyncType::ASYNC_SAFE));
+    obj->info(__FILE__, __LINE__, "lost");
+    for (int i = 0; i < 100 && unix_stream->stats().__dropped_records == 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_EQ(unix_stream->stats().__dropped_records, 1);
+    int stream = listenSocket(AF_UNIX, SOCK_STREAM, stream_path, port);
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    std::string big(30000, 'x'); // 大于 socket 缓冲区的部分先暂存
+    for (int i = 0; i < 20; ++i)
+        obj->warning(__FILE__, __LINE__, "%d %s", i, big.c_str());
+    int conn = accept(stream, nullptr, nullptr);
+    ASSERT_GE(conn, 0);
+    ffengc_log::socketStats stats;
+    std::thread closer([&]() {
+        obj.reset();
+        stats = unix_stream->stats();
+        unix_stream.reset(); // 析构时把暂存的数据发完（对端在读）再关闭
+    });
+    std::string data = recvStream(conn);
+    closer.join();
+    close(conn);
+    close(stream);
+    // 逐条按长度解析，收到的日志必须完整、按顺序
+    size_t pos = 0, records = 0, last = 0;
+    while (pos < data.size()) {
+        size_t sp = data.find(' ', pos);
+        ASSERT_NE(sp, std::string::npos);
+        size_t len = std::stoul(data.substr(pos, sp - pos));
+        std::string msg = data.substr(sp + 1, len);
+        ASSERT_EQ(msg.substr(0, 6), "<12>1 "); // user.warning
+        size_t body = msg.find(" - - [WARNING] ");
+        ASSERT_NE(body, std::string::npos);
+        size_t idx = std::stoul(msg.substr(body + 15));
+        ASSERT_EQ(msg.substr(body + 15), std::to_string(idx) + " " + big);
+        ASSERT_TRUE(records == 0 || idx > last);
+        last = idx;
+        pos = sp + 1 + len;
+        ++records;
+    }
+    ASSERT_EQ(records, 20); // 暂存区足够大，连接后的日志一条都不丢
+    ASSERT_EQ(stats.__dropped_records, 1);
+    ASSERT_EQ(stats.__sent_records, records);
+    ASSERT_EQ(stats.__reconnects, 0); // 第一次连上不算重连
+}
+TEST(all_test, thread_id_test) {
+    // 1. 缓存的线程ID就是内核线程ID，fork 出的子进程中重新获取
+    pid_t self = ffengc_log::util::Thread::id();
+    ASSERT_EQ(self, (pid_t)syscall(SYS_gettid));
+    ASSERT_EQ(ffengc_log::util::Thread::id(), self);
+    pid_t other = 0;
+    std::thread([&]() { other = ffengc_log::util::Thread::id(); }).join();
+    ASSERT_NE(other, 0);
+    ASSERT_NE(other, self);
+    pid_t child = fork();
+    if (child == 0)
+        _exit(ffengc_log::util::Thread::id() == getpid() ? 0 : 1);
+    int status = 0;
+    waitpid(child, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+    // 2. 延迟格式化在后台线程格式化，输出的仍然是写日志线程的ID和名字
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%t{name} %t %m%n"));
+    std::shared_ptr<stringSink> lazy = std::make_shared<stringSink>();
+    std::shared_ptr<stringSink> json = std::make_shared<stringSink>();
+    pid_t named = 0, unnamed = 0;
+    std::string os_name;
+    {
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+        builder->buildLoggerName("thread_lazy");
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+        builder->buildEnableLazyFormat();
+        builder->buildFormatter(fmt);
+        builder->buildSink(lazy);
+        ffengc_log::logger::ptr obj = builder->build();
+        builder.reset(new ffengc_log::localLoggerBuilder());
+        builder->buildLoggerName("thread_json");
+        builder->buildJsonFormatter("T");
+        builder->buildSink(json);
+        ffengc_log::logger::ptr json_obj = builder->build();
+        std::thread([&]() {
+            named = ffengc_log::util::Thread::id();
+            ffengc_log::util::Thread::setName("io-worker-with-a-long-name");
+            char buf[32] = { 0 };
+            pthread_getname_np(pthread_self(), buf, sizeof(buf));
+            os_name = buf;
+            obj->info(__FILE__, __LINE__, "named");
+            json_obj->info(__FILE__, 1, "named");
+        }).join();
+        std::thread([&]() {
+            unnamed = ffengc_log::util::Thread::id();
+            obj->info(__FILE__, __LINE__, "unnamed");
+            json_obj->info(__FILE__, 2, "unnamed");
+        }).join();
+    }
+    ASSERT_EQ(os_name, "io-worker-with-"); // 系统中的线程名最多15个字符
+    std::string n = std::to_string(named), u = std::to_string(unnamed), file = __FILE__;
+    ASSERT_EQ(lazy->__data, "io-worker-with-a-long-name " + n + " named\n" + u + " " + u + " unnamed\n");
+    ASSERT_EQ(json->__data, "{\"time\":\"T\",\"level\":\"INFO\",\"logger\":\"thread_json\",\"file\":\"" + file + "\",\"line\":1,\"tid\":" + n
+            + ",\"thread\":\"io-worker-with-a-long-name\",\"msg\":\"named\"}\n"
+            + "{\"time\":\"T\",\"level\":\"INFO\",\"logger\":\"thread_json\",\"file\":\"" + file + "\",\"line\":2,\"tid\":" + u + ",\"msg\":\"unnamed\"}\n");
+    // 3. 线程退出后名字自动注销
+    std::string name;
+    ASSERT_FALSE(ffengc_log::util::Thread::name(named, name));
+    std::string registered, formatted;
+    pid_t tid = 0;
+    std::thread([&]() {
+        tid = ffengc_log::util::Thread::id();
+        ffengc_log::util::Thread::setName("flusher");
+        ffengc_log::util::Thread::name(tid, registered);
+        ffengc_log::logMessage msg(ffengc_log::logLevel::value::INFO, 1, "f", "l", "m");
+        ffengc_log::staticFormatter<thread_name_pattern> static_fmt;
+        formatted = static_fmt.format(msg);
+    }).join();
+    ASSERT_EQ(registered, "flusher");
+    ASSERT_EQ(formatted, "flusher " + std::to_string(tid) + "\n");
+    ASSERT_FALSE(ffengc_log::util::Thread::name(tid, name));
+    // 4. 写日志的线程在异步线程格式化之前就退出了，延迟格式化和二进制日志器输出的仍然是它当时的名字
+    for (int binary = 0; binary < 2; ++binary) {
+        std::shared_ptr<gateSink> gate = std::make_shared<gateSink>();
+        {
+            ffengc_log::logger::ptr obj;
+            if (binary)
+                obj.reset(new ffengc_log::binaryLogger("thread_exit", ffengc_log::logLevel::value::DEBUG, fmt, { gate }, ffengc_log::asyncType::ASYNC_SAFE));
+            else
+                obj.reset(new ffengc_log::asyncLogger("thread_exit", ffengc_log::logLevel::value::DEBUG, fmt, { gate }, ffengc_log::asyncType::ASYNC_SAFE, 0, ffengc_log::bufferPoolConfig(), true));
+            obj->info(__FILE__, __LINE__, "first");
+            while (!gate->__entered)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1)); // 异步线程卡在第一批日志上
+            std::thread([&]() {
+                tid = ffengc_log::util::Thread::id();
+                ffengc_log::util::Thread::setName("short-lived");
+                obj->info(__FILE__, __LINE__, "exited");
+            }).join();
+            ASSERT_FALSE(ffengc_log::util::Thread::name(tid, name));
+            gate->__open = true;
+        }
+        ASSERT_NE(gate->__data.find("short-lived " + std::to_string(tid) + " exited\n"), std::string::npos);
+    }
+}
+static size_t diskSize(const std::string& name) {
+    struct stat st;
+    return stat(name.c_str(), &st) == 0 ? st.st_size : 0;
+} // 已经交给内核的数据量，ofstream 缓冲区中的不算
+TEST(all_test, flush_policy_test) {
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("[%p] %m%n"));
+    // 1. 按等级：INFO 留在 ofstream 的缓冲区中，ERROR 立即刷新（连同之前的 INFO）
+    std::string level_file = "./logfile/flush_level.log";
+    remove(level_file.c_str());
+    ffengc_log::logSink::ptr level_sink = ffengc_log::sinkFactory::create<ffengc_log::fileSink>(level_file);
+    ffengc_log::flushPolicy on_error;
+    on_error.__level = ffengc_log::logLevel::value::ERROR;
+    level_sink->setFlushPolicy(on_error);
+    {
+        ffengc_log::syncLogger obj("flush_level", ffengc_log::logLevel::value::DEBUG, fmt, { level_sink });
+        for (int i = 0; i < 10; ++i)
+            obj.info(__FILE__, __LINE__, "info %d", i);
+        ASSERT_EQ(diskSize(level_file), 0);
+        obj.error(__FILE__, __LINE__, "error");
+        ASSERT_EQ(diskSize(level_file), level_sink->metrics().__bytes);
+        ASSERT_EQ(level_sink->metrics().__flushes, 1);
+    }
+    // 2. 按大小：每写满 1000 字节刷新一次
+    std::string bytes_file = "./logfile/flush_bytes.log";
+    remove(bytes_file.c_str());
+    ffengc_log::logSink::ptr bytes_sink = ffengc_log::sinkFactory::create<ffengc_log::fileSink>(bytes_file);
+    ffengc_log::flushPolicy every_kb;
+    every_kb.__bytes = 1000;
+    bytes_sink->setFlushPolicy(every_kb);
+    {
+        ffengc_log::syncLogger obj("flush_bytes", ffengc_log::logLevel::value::DEBUG, fmt, { bytes_sink });
+        std::string line(93, 'x'); // 加上 "[INFO] " 和换行一共 101 字节
+        for (int i = 0; i < 25; ++i)
+            obj.info(__FILE__, __LINE__, "%s", line.c_str());
+        ASSERT_EQ(bytes_sink->metrics().__flushes, 2); // 第 10 条和第 20 条之后
+        ASSERT_EQ(diskSize(bytes_file), 20 * 101);
+        ASSERT_EQ(bytes_sink->metrics().__syncs, 0);
+    }
+    // 3. 异步日志器：按时间刷新由空闲的异步线程完成，按等级刷新需要记录每条日志的等级
+    auto check_async = [&](const std::string& name, bool lockfree, bool workers) {
+        std::string time_file = "./logfile/" + name + "_time.log", error_file = "./logfile/" + name + "_error.log";
+        remove(time_file.c_str());
+        remove(error_file.c_str());
+        ffengc_log::flushPolicy every_20ms;
+        every_20ms.__interval_ms = 20;
+        every_20ms.__sync = true;
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+        builder->buildLoggerName(name);
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+        builder->buildFormatter("[%p] %m%n");
+        if (lockfree)
+            builder->buildEnableLockFreeLoop();
+        if (workers)
+            builder->buildEnableSinkWorkers();
+        builder->buildSink<ffengc_log::fileSink>(time_file);
+        builder->buildSinkFlushPolicy(every_20ms);
+        builder->buildSink<ffengc_log::fileSink>(error_file);
+        builder->buildSinkFlushPolicy(on_error);
+        ffengc_log::logger::ptr obj = builder->build();
+        obj->info(__FILE__, __LINE__, "%s", "info");
+        size_t expect = strlen("[INFO] info\n");
+        for (int i = 0; i < 100 && diskSize(time_file) < expect; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ASSERT_EQ(diskSize(time_file), expect);
+        ASSERT_EQ(diskSize(error_file), 0);
+        obj->error(__FILE__, __LINE__, "%s", "error");
+        expect += strlen("[ERROR] error\n");
+        for (int i = 0; i < 100 && diskSize(error_file) < expect; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ASSERT_EQ(diskSize(error_file), expect);
+        ffengc_log::loggerMetrics m = obj->metrics();
+        for (int i = 0; i < 100 && (m.__sinks[0].__syncs == 0 || m.__sinks[1].__flushes == 0); ++i) { // 数据先写入内核，刷新、fdatasync 之后才计数
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            m = obj->metrics();
+        }
+        ASSERT_GT(m.__sinks[0].__syncs, 0);
+        ASSERT_EQ(m.__sinks[1].__syncs, 0);
+        ASSERT_EQ(m.__sinks[1].__flushes, 1);
+    };
+    check_async("flush_async", false, false);
+    check_async("flush_lockfree", true, false);
+    check_async("flush_workers", false, true);
+}
+// 检查同一个日志器的数据不会被两个线程同时处理
+class exclusiveSink : public stringSink {
+public:
+    std::atomic<int> __inside;
+    std::atomic<bool> __overlapped;
+    size_t __delay_us;
+    exclusiveSink(size_t delay_us = 0)
+        : __inside(0)
+        , __overlapped(false)
+        , __delay_us(delay_us) { }
+    void log(const char* data, size_t len) override {
+        if (__inside.fetch_add(1) != 0)
+            __overlapped = true;
+        if (__delay_us > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(__delay_us));
+        stringSink::log(data, len);
+        __inside.fetch_sub(1);
+    }
+};
+static size_t threadCount() {
+    return list_files("/proc/self/task").size();
+}
+TEST(all_test, shared_pool_test) {
+    // 1. 线程数只取决于线程池，日志器再多也不增加线程；所有模式的数据都完整、每个线程内有序
+    ffengc_log::looperPoolConfig config;
+    config.__threads = 2;
+    config.__cpus = { 0 };
+    ffengc_log::looperPool::ptr pool = std::make_shared<ffengc_log::looperPool>(config);
+    ASSERT_EQ(pool->threads(), 2);
+    std::vector<std::shared_ptr<exclusiveSink>> sinks;
+    std::vector<ffengc_log::logger::ptr> loggers;
+    size_t threads_before = threadCount();
+    for (int i = 0; i < 20; ++i) {
+        std::shared_ptr<exclusiveSink> sink = std::make_shared<exclusiveSink>();
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+        builder->buildLoggerName("shared_" + std::to_string(i));
+        builder->buildLoggerType(i == 19 ? ffengc_log::loggerType::LOGGER_BINARY : ffengc_log::loggerType::LOGGER_ASYNC);
+        builder->buildFormatter("%m%n");
+        if (i % 4 == 1)
+            builder->buildEnableLockFreeLoop();
+        if (i % 4 == 2)
+            builder->buildEnableUnsafeLoop();
+        if (i % 4 == 3)
+            builder->buildEnableLazyFormat();
+        builder->buildSharedWorkers(pool);
+        builder->buildSink(sink);
+        loggers.push_back(builder->build());
+        sinks.push_back(sink);
+    }
+    ASSERT_EQ(threadCount(), threads_before);
+    ASSERT_EQ(pool->loopers(), 20);
+    ASSERT_EQ(loggers[0]->metrics().__looper.__allocated_bytes, 0); // 没有写过日志的日志器不占缓冲区
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t) {
+        producers.emplace_back([&, t]() {
+            for (int j = 0; j < 2000; ++j)
+                for (auto& e : loggers)
+                    e->info(__FILE__, __LINE__, "%d %d", t, j);
+        });
+    }
+    for (auto& e : producers)
+        e.join();
+    loggers.clear(); // 析构时把剩下的数据处理完
+    ASSERT_EQ(pool->loopers(), 0);
+    for (auto& sink : sinks) {
+        ASSERT_FALSE(sink->__overlapped);
+        std::istringstream in(sink->__data);
+        int t = 0, j = 0, next[4] = { 0 };
+        size_t lines = 0;
+        while (in >> t >> j) {
+            ASSERT_EQ(j, next[t]);
+            next[t] = j + 1;
+            ++lines;
+        }
+        ASSERT_EQ(lines, 4 * 2000);
+    }
+    // 2. 公平调度：一个工作线程，一个日志器一直有大量数据、sink 很慢，另一个日志器的日志也能很快落地
+    config.__threads = 1;
+    config.__cpus.clear();
+    pool = std::make_shared<ffengc_log::looperPool>(config);
+    std::shared_ptr<exclusiveSink> slow = std::make_shared<exclusiveSink>(2000);
+    std::shared_ptr<exclusiveSink> quick = std::make_shared<exclusiveSink>();
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%m%n"));
+    {
+        ffengc_log::asyncLogger hot("shared_hot", ffengc_log::logLevel::value::DEBUG, fmt, { slow }, ffengc_log::asyncType::ASYNC_UNSAFE, 0,
+            ffengc_log::bufferPoolConfig(), false, ffengc_log::overflowConfig(), pool);
+        ffengc_log::asyncLogger cold("shared_cold", ffengc_log::logLevel::value::DEBUG, fmt, { quick }, ffengc_log::asyncType::ASYNC_SAFE, 0,
+            ffengc_log::bufferPoolConfig(), false, ffengc_log::overflowConfig(), pool);
+        std::atomic<bool> stop(false);
+        std::thread flood([&]() {
+            while (!stop)
+                hot.info(__FILE__, __LINE__, "flood");
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        auto start = std::chrono::steady_clock::now();
+        cold.info(__FILE__, __LINE__, "cold");
+        while (quick->__data.empty() && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+        stop = true;
+        flood.join();
+        ASSERT_EQ(quick->__data, "cold\n");
+        ASSERT_LT(waited.count(), 0.5); // 最多等热日志器处理一两轮
+    }
+    // 3. 按时间刷新由线程池定期触发：没有新日志时数据也会写到文件
+    std::string file = "./logfile/shared_flush.log";
+    unlink(file.c_str());
+    {
+        ffengc_log::flushPolicy every_20ms;
+        every_20ms.__interval_ms = 20;
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+        builder->buildLoggerName("shared_flush");
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+        builder->buildFormatter("%m%n");
+        builder->buildSharedWorkers(pool);
+        builder->buildSink<ffengc_log::fileSink>(file);
+        builder->buildSinkFlushPolicy(every_20ms);
+        ffengc_log::logger::ptr obj = builder->build();
+        obj->info(__FILE__, __LINE__, "tick");
+        for (int i = 0; i < 100 && diskSize(file) < 5; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ASSERT_EQ(diskSize(file), 5);
+    }
+    // 4. 内存不随日志器的数量增长：用完的缓冲块放回线程池共用的缓存，无锁模式的消费缓冲区由工作线程持有
+    auto footprint = [&](size_t n) {
+        ffengc_log::looperPool::ptr mem_pool = std::make_shared<ffengc_log::looperPool>(config);
+        struct mallinfo2 before = mallinfo2();
+        std::vector<std::unique_ptr<ffengc_log::asyncLogger>> objs;
+        for (size_t i = 0; i < n; ++i) {
+            ffengc_log::asyncType type = i % 2 ? ffengc_log::asyncType::ASYNC_LOCKFREE : ffengc_log::asyncType::ASYNC_SAFE;
+            objs.emplace_back(new ffengc_log::asyncLogger("shared_memory", ffengc_log::logLevel::value::DEBUG, fmt, { std::make_shared<nullSink>() }, type, 0,
+                ffengc_log::bufferPoolConfig(), false, ffengc_log::overflowConfig(), mem_pool));
+            if (type == ffengc_log::asyncType::ASYNC_SAFE) {
+                objs.back()->info(__FILE__, __LINE__, "%zu", i); // 等这一块处理完、放回共用的缓存
+                while (objs.back()->metrics().__looper.__allocated_bytes > 0)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        struct mallinfo2 after = mallinfo2();
+        EXPECT_EQ(mem_pool->cachedBytes(), DEFAULT_BUFFER_SIZE); // 所有日志器轮流用同一块
+        return (after.uordblks + after.hblkhd) - (before.uordblks + before.hblkhd);
+    };
+    size_t few = footprint(8), many = footprint(64);
+    ASSERT_LT(many - few, DEFAULT_BUFFER_SIZE); // 多了56个日志器，还不到一个缓冲块
+    // 5. 进程内共享的线程池
+    ffengc_log::looperPool::ptr global = ffengc_log::looperPool::global();
+    ASSERT_EQ(global, ffengc_log::looperPool::global());
+    ASSERT_FALSE(ffengc_log::looperPool::configureGlobal(config)); // 已经创建，不能再修改
+}
+// 记录调用 log 的线程（即异步线程）被允许运行的CPU
+class affinitySink : public stringSink {
+public:
+    std::vector<int> __cpus;
+    void log(const char* data, size_t len) override {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+        std::unique_lock<std::mutex> lock(__mtx);
+        __cpus.clear();
+        for (int i = 0; i < CPU_SETSIZE; ++i)
+            if (CPU_ISSET(i, &set))
+                __cpus.push_back(i);
+        __data.append(data, len);
+    }
+};
+// 模拟两个节点：0号CPU在0号节点，其他CPU在1号节点，线程所在的节点由 fake_node 指定；记录每次内存绑定
+static thread_local int fake_node = 0;
+class fakeNuma : public ffengc_log::util::numaProvider {
+public:
+    std::mutex __mtx;
+    std::vector<std::pair<size_t, int>> __binds; // 长度和节点
+    int nodeCount() override { return 2; }
+    std::vector<int> cpusOfNode(int node) override { return node == 0 ? std::vector<int>({ 0 }) : std::vector<int>({ 1 }); }
+    int nodeOfCpu(int cpu) override { return cpu == 0 ? 0 : 1; }
+    int currentNode() override { return fake_node; }
+    bool bindMemory(void* /*addr*/, size_t len, int node) override {
+        std::unique_lock<std::mutex> lock(__mtx);
+        __binds.push_back({ len, node });
+        return true;
+    }
+};
+TEST(all_test, numa_placement_test) {
+    // 1. 拓扑：当前CPU属于当前节点
+    int cpu = sched_getcpu();
+    int node = ffengc_log::util::Numa::currentNode();
+    ASSERT_GE(ffengc_log::util::Numa::nodeCount(), 1);
+    ASSERT_EQ(node, ffengc_log::util::Numa::nodeOfCpu(cpu));
+    std::vector<int> node_cpus = ffengc_log::util::Numa::cpusOfNode(node);
+    ASSERT_NE(std::find(node_cpus.begin(), node_cpus.end(), cpu), node_cpus.end());
+    ASSERT_TRUE(ffengc_log::util::Numa::cpusOfNode(-1).empty());
+    // 2. 异步线程绑定到指定的CPU，开启节点本地缓冲区后所有模式的数据都完整、每个线程内有序
+    std::vector<ffengc_log::asyncType> modes = { ffengc_log::asyncType::ASYNC_SAFE, ffengc_log::asyncType::ASYNC_UNSAFE, ffengc_log::asyncType::ASYNC_LOCKFREE };
+    for (auto mode : modes) {
+        std::shared_ptr<affinitySink> sink = std::make_shared<affinitySink>();
+        {
+            std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+            builder->buildLoggerName("numa_placement");
+            builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+            builder->buildFormatter("%m%n");
+            if (mode == ffengc_log::asyncType::ASYNC_UNSAFE)
+                builder->buildEnableUnsafeLoop();
+            if (mode == ffengc_log::asyncType::ASYNC_LOCKFREE)
+                builder->buildEnableLockFreeLoop();
+            builder->buildWorkerAffinity({ cpu });
+            builder->buildNodeLocalBuffers();
+            builder->buildBufferChunkSize(4096); // 小块，多次换块
+            builder->buildSink(sink);
+            ffengc_log::logger::ptr obj = builder->build();
+            std::vector<std::thread> producers;
+            for (int t = 0; t < 4; ++t) {
+                producers.emplace_back([&, t]() {
+                    for (int j = 0; j < 5000; ++j)
+                        obj->info(__FILE__, __LINE__, "%d %d", t, j);
+                });
+            }
+            for (auto& e : producers)
+                e.join();
+        }
+        ASSERT_EQ(sink->__cpus, std::vector<int>({ cpu }));
+        std::istringstream in(sink->__data);
+        int t = 0, j = 0, next[4] = { 0 };
+        size_t lines = 0;
+        while (in >> t >> j) {
+            ASSERT_EQ(j, next[t]);
+            next[t] = j + 1;
+            ++lines;
+        }
+        ASSERT_EQ(lines, 4 * 5000);
+    }
+    // 3. 按节点绑定：异步线程可以在当前节点的所有CPU上运行
+    std::shared_ptr<affinitySink> sink = std::make_shared<affinitySink>();
+    {
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+        builder->buildLoggerName("numa_node");
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_BINARY);
+        builder->buildFormatter("%m%n");
+        builder->buildWorkerNode(node);
+        builder->buildSink(sink);
+        builder->build()->info(__FILE__, __LINE__, "node");
+    }
+    ASSERT_EQ(sink->__data, "node\n");
+    for (int e : sink->__cpus)
+        ASSERT_EQ(ffengc_log::util::Numa::nodeOfCpu(e), node);
+    // 4. 模拟两个节点：无锁模式下每个生产者的环形缓冲区在第一次写入之前绑定到它所在的节点，之后一直复用；其他模式不绑定
+    std::shared_ptr<fakeNuma> fake = std::make_shared<fakeNuma>();
+    ffengc_log::util::Numa::setProvider(fake);
+    struct providerGuard {
+        ~providerGuard() { ffengc_log::util::Numa::setProvider(nullptr); }
+    } guard;
+    ASSERT_EQ(ffengc_log::util::Numa::nodeCount(), 2);
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%m%n"));
+    for (auto mode : modes) {
+        for (int node_local = 0; node_local < 2; ++node_local) {
+            fake->__binds.clear();
+            std::shared_ptr<stringSink> out = std::make_shared<stringSink>();
+            {
+                ffengc_log::bufferPoolConfig pool;
+                pool.__node_local = node_local;
+                ffengc_log::asyncLogger obj("numa_fake", ffengc_log::logLevel::value::DEBUG, fmt, { out }, mode, 0, pool);
+                std::vector<std::thread> producers;
+                for (int t = 0; t < 2; ++t) {
+                    producers.emplace_back([&, t]() {
+                        fake_node = t;
+                        for (int j = 0; j < 100; ++j)
+                            obj.info(__FILE__, __LINE__, "%d", t);
+                    });
+                }
+                for (auto& e : producers)
+                    e.join();
+            }
+            ASSERT_EQ(std::count(out->__data.begin(), out->__data.end(), '\n'), 200);
+            std::sort(fake->__binds.begin(), fake->__binds.end());
+            if (node_local && mode == ffengc_log::asyncType::ASYNC_LOCKFREE) {
+                ASSERT_EQ(fake->__binds, (std::vector<std::pair<size_t, int>>({ { DEFAULT_RING_SIZE, 0 }, { DEFAULT_RING_SIZE, 1 } })));
+            } else {
+                ASSERT_TRUE(fake->__binds.empty());
+            }
+        }
+    }
+}
+// 手动推进的时钟，让限流测试不依赖真实的时间
+static int64_t fake_now_ns = 1000000000LL;
+static int64_t fake_clock() { return fake_now_ns; }
+TEST(all_test, rate_limit_test) {
+    // 调用 count 次，返回输出的条数，以及汇总中报告的被限流条数
+    auto run = [](ffengc_log::siteLimiter& limiter, size_t count, uint64_t& reported) {
+        size_t passed = 0;
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t report = 0;
+            if (limiter.allow(report))
+                ++passed;
+            reported += report;
+        }
+        return passed;
+    };
+    // 1. 前3条，之后每10条一条
+    ffengc_log::siteLimiter every(ffengc_log::limitEveryN(3, 10));
+    uint64_t reported = 0;
+    ASSERT_EQ(run(every, 100, reported), 13);
+    ASSERT_EQ(reported + every.suppressed(), 87);
+    ASSERT_EQ(reported, 81); // 最后一条输出的日志（第94条）之前的都已经汇总
+    // 2. 令牌桶：每秒10条，突发5条
+    ffengc_log::siteLimiter bucket(ffengc_log::limitRate(10, 5), fake_clock);
+    reported = 0;
+    size_t passed = run(bucket, 100, reported);
+    ASSERT_EQ(passed, 5);
+    fake_now_ns += 350 * 1000000LL; // 补充了3.5个令牌
+    passed = run(bucket, 100, reported);
+    ASSERT_EQ(passed, 3);
+    ASSERT_EQ(reported, 95); // 第一轮被限流的在第二轮第一条输出前汇总
+    ASSERT_EQ(bucket.suppressed(), 97);
+    // 3. 采样
+    ffengc_log::siteLimiter sample(ffengc_log::limitSample(0.1));
+    passed = run(sample, 100000, reported);
+    ASSERT_GT(passed, 9000);
+    ASSERT_LT(passed, 11000);
+    ffengc_log::siteLimiter all(ffengc_log::limitSample(1));
+    ASSERT_EQ(run(all, 1000, reported), 1000);
+    ffengc_log::siteLimiter none(ffengc_log::limitSample(0));
+    ASSERT_EQ(run(none, 1000, reported), 0);
+    // 4. 一直被限流的调用点也会定期汇总
+    ffengc_log::siteLimiter quiet(ffengc_log::limitEveryN(0, 0), fake_clock);
+    reported = 0;
+    ASSERT_EQ(run(quiet, 50, reported), 0);
+    ASSERT_EQ(reported, 0);
+    fake_now_ns += (DEFAULT_SUPPRESS_REPORT_MS + 50) * 1000000LL;
+    ASSERT_EQ(run(quiet, SUPPRESS_CHECK_EVERY * 4 - 50, reported), 0); // 每 SUPPRESS_CHECK_EVERY 条检查一次时间
+    ASSERT_EQ(reported, SUPPRESS_CHECK_EVERY * 4);
+    ASSERT_EQ(quiet.suppressed(), 0);
+    // 5. 多线程共享一个调用点
+    ffengc_log::siteLimiter shared(ffengc_log::limitEveryN(0, 4));
+    std::atomic<size_t> shared_passed(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&]() {
+            uint64_t r = 0;
+            shared_passed += run(shared, 10000, r);
+        });
+    }
+    for (auto& e : threads)
+        e.join();
+    ASSERT_EQ(shared_passed, 10000);
+    // 6. 调用点之后不再被调用时，剩下的汇总由日志器在空闲时和析构时输出
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("[%p][%f:%l] %m%n"));
+    std::shared_ptr<stringSink> idle_sink = std::make_shared<stringSink>();
+    ffengc_log::flushPolicy tick;
+    tick.__interval_ms = 10; // 异步线程每10毫秒做一次空闲检查
+    idle_sink->setFlushPolicy(tick);
+    {
+        ffengc_log::asyncLogger obj("rate_idle", ffengc_log::logLevel::value::DEBUG, fmt, { idle_sink }, ffengc_log::asyncType::ASYNC_SAFE);
+        ffengc_log::siteLimiter site(ffengc_log::limitEveryN(0, 0), fake_clock); // 比日志器先析构
+        site.attach(obj.limiters(), ffengc_log::logLevel::value::WARNING, "site.cc", 7);
+        reported = 0;
+        ASSERT_EQ(run(site, 15, reported), 0);
+        ASSERT_EQ(reported, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ASSERT_EQ(obj.metrics().__sinks[0].__writes, 0); // 距离上次汇总还不到 DEFAULT_SUPPRESS_REPORT_MS
+        fake_now_ns += DEFAULT_SUPPRESS_REPORT_MS * 1000000LL;
+        for (int i = 0; i < 100 && obj.metrics().__sinks[0].__writes == 0; ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ASSERT_EQ(idle_sink->__data, "[WARNING][site.cc:7] suppressed 15 messages\n");
+        ASSERT_EQ(site.suppressed(), 0);
+        ASSERT_EQ(run(site, 4, reported), 0); // 析构时不管间隔，全部输出
+    }
+    ASSERT_EQ(idle_sink->__data, "[WARNING][site.cc:7] suppressed 15 messages\n[WARNING][site.cc:7] suppressed 4 messages\n");
+    // 调用点比日志器活得久：同步日志器在析构时输出，之后调用点仍然可以使用
+    std::shared_ptr<stringSink> sync_sink = std::make_shared<stringSink>();
+    ffengc_log::siteLimiter outlive(ffengc_log::limitEveryN(0, 0), fake_clock);
+    {
+        ffengc_log::syncLogger obj("rate_sync", ffengc_log::logLevel::value::DEBUG, fmt, { sync_sink });
+        outlive.attach(obj.limiters(), ffengc_log::logLevel::value::ERROR, "sync.cc", 9);
+        ASSERT_EQ(run(outlive, 6, reported), 0);
+        ASSERT_EQ(sync_sink->__data, "");
+    }
+    ASSERT_EQ(sync_sink->__data, "[ERROR][sync.cc:9] suppressed 6 messages\n");
+    ASSERT_EQ(run(outlive, 3, reported), 0);
+    // 二进制日志器：汇总编码成记录，dump 出来可以解码
+    std::shared_ptr<stringSink> dump = std::make_shared<stringSink>();
+    {
+        ffengc_log::binaryLogger obj("rate_binary", ffengc_log::logLevel::value::DEBUG, fmt, { dump }, ffengc_log::asyncType::ASYNC_SAFE, true);
+        ffengc_log::siteLimiter site(ffengc_log::limitEveryN(0, 0), fake_clock);
+        site.attach(obj.limiters(), ffengc_log::logLevel::value::INFO, "binary.cc", 3);
+        ASSERT_EQ(run(site, 5, reported), 0);
+    }
+    ffengc_log::binary::decoder dec;
+    ffengc_log::logStream text;
+    ASSERT_EQ(dec.decode(dump->__data.data(), dump->__data.size(), *fmt, text), dump->__data.size());
+    ASSERT_EQ(std::string(text.data(), text.size()), "[INFO][binary.cc:3] suppressed 5 messages\n");
+}
+
+// 以下测试通过 log.h 的宏调用，log.h 会把 info 等成员函数名定义成宏，因此放在文件最后引入
+#include "log.h"
+TEST(all_test, level_macro_test) {
+    std::shared_ptr<countSink> sink = std::make_shared<countSink>();
+    std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::globalLoggerBuilder());
+    builder->buildLoggerName("level_macro");
+    builder->buildLoggerLevel(ffengc_log::logLevel::value::WARNING);
+    builder->buildFormatter("%m%n");
+    builder->buildSink(sink);
+    builder->build();
+    int evaluated = 0;
+    auto arg = [&]() { return ++evaluated; }; // 有副作用的参数，被过滤时不应该被计算
+    LOG_DEBUG("level_macro", "%d", arg());
+    LOG_INFO("level_macro", "%d", arg());
+    LOG_INFO_LIMIT("level_macro", ffengc_log::limitEveryN(1, 0), "%d", arg());
+    LOG_INFO("level_macro", LOG_FMT("{}"), arg());
+    ASSERT_EQ(evaluated, 0);
+    ASSERT_EQ(sink->__lines, 0);
+    LOG_WARNING("level_macro", "%d", arg());
+    LOG_ERROR("level_macro", LOG_FMT("{}"), arg());
+    ASSERT_EQ(evaluated, 2);
+    ASSERT_EQ(sink->__lines, 2);
+    // 运行时调低等级之后，同一个调用点的参数会被计算
+    ffengc_log::getLogger("level_macro")->setLevel(ffengc_log::logLevel::value::DEBUG);
+    for (int i = 0; i < 2; ++i)
+        LOG_DEBUG("level_macro", "%d", arg());
+    ASSERT_EQ(evaluated, 4);
+    ASSERT_EQ(sink->__lines, 4);
+}
 int main(int argc, char** argv) {
     testing::InitGoogleTest(&argc, argv);
     testing::AddGlobalTestEnvironment(new all_test);
-    testing::GTEST_FLAG(filter) = "all_test.globalLoggerBuilder";
+    testing::GTEST_FLAG(filter) = "all_test.globalLoggerBuilder:all_test.async_lockfree_test:all_test.zero_alloc_test:all_test.static_format_test:all_test.time_cache_test:all_test.binary_logger_test:all_test.binary_segment_test:all_test.sink_worker_test:all_test.buffer_pool_test:all_test.direct_sink_test:all_test.mmap_roll_test:all_test.registry_test:all_test.level_check_test:all_test.level_macro_test:all_test.fmt_api_test:all_test.record_batch_test:all_test.gzip_roll_test:all_test.lazy_format_test:all_test.overflow_policy_test:all_test.metrics_test:all_test.rate_limit_test:all_test.flush_policy_test:all_test.structured_test:all_test.socket_sink_test:all_test.thread_id_test:all_test.shared_pool_test:all_test.numa_placement_test";
     return RUN_ALL_TESTS();
 }
\ No newline at end of file
@@ -5,9 +5,13 @@
  */
 
 #include "log.h"
+#include "internal/gzipSink.hpp"
 #include <algorithm>
 #include <chrono>
+#include <dirent.h>
+#include <mutex>
 #include <numeric>
+#include <unordered_map>
 
 std::pair<double, double> bench(const std::string& logger_name, size_t thr_count, size_t msg_count, size_t msg_len) {
     // 1. 获取日志器
@@ -68,13 +72,491 @@ void make_bench() {
         msg_per_sec_lst.push_back(p.first);
         size_per_sec_lst.push_back(p.second);
     }
-    double msg_per_sec_mean = std::accumulate(msg_per_sec_lst.begin(), msg_per_sec_lst.end(), 0) / msg_per_sec_lst.size();
-    double size_per_sec_mean = std::accumulate(size_per_sec_lst.begin(), size_per_sec_lst.end(), 0) / size_per_sec_lst.size();
+    double msg_per_sec_mean = std::accumulate(msg_per_sec_lst.begin(), msg_per_sec_lst.end(), 0.0) / msg_per_sec_lst.size();
+    double size_per_sec_mean = std::accumulate(size_per_sec_lst.begin(), size_per_sec_lst.end(), 0.0) / size_per_sec_lst.size();
     std::cout << "avg message per sec: " << msg_per_sec_mean << std::endl;
     std::cout << "avg size per sec: " << size_per_sec_mean / 1024 << "mb" << std::endl;
 }
 
+// 对比加锁的双缓冲区和每线程环形缓冲区在不同线程数下的扩展性
+void make_scaling_bench() {
+    std::vector<std::pair<std::string, ffengc_log::asyncType>> modes = {
+        { "scaling_unsafe", ffengc_log::asyncType::ASYNC_UNSAFE },
+        { "scaling_lockfree", ffengc_log::asyncType::ASYNC_LOCKFREE },
+    };
+    for (const auto& mode : modes) {
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::globalLoggerBuilder());
+        builder->buildLoggerLevel(ffengc_log::logLevel::value::WARNING);
+        builder->buildLoggerName(mode.first);
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+        if (mode.second == ffengc_log::asyncType::ASYNC_UNSAFE)
+            builder->buildEnableUnsafeLoop();
+        else
+            builder->buildEnableLockFreeLoop();
+        builder->buildFormatter("%m%n");
+        builder->buildSink<ffengc_log::fileSink>("./logfile/" + mode.first + ".log");
+        builder->build();
+        for (size_t thr_count : { 1, 2, 4, 8, 16, 32 }) {
+            auto p = bench(mode.first, thr_count, 2000000, 100);
+            std::cout << mode.first << " threads: " << thr_count
+                      << " message per sec: " << p.first
+                      << " size per sec: " << p.second / 1024 << "mb" << std::endl;
+        }
+    }
+}
+
+// 带时间格式的同步日志器，用于观察时间格式化的开销
+void make_time_bench() {
+    std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::globalLoggerBuilder());
+    builder->buildLoggerLevel(ffengc_log::logLevel::value::WARNING);
+    builder->buildLoggerName("time_bench");
+    builder->buildLoggerType(ffengc_log::loggerType::LOGGER_SYNC);
+    builder->buildFormatter("[%d{%Y-%m-%d %H:%M:%S.%6N}] %m%n");
+    builder->buildSink<ffengc_log::fileSink>("./logfile/time.log");
+    builder->build();
+    for (size_t thr_count : { 1, 4 }) {
+        auto p = bench("time_bench", thr_count, 2000000, 100);
+        std::cout << "time_bench threads: " << thr_count
+                  << " message per sec: " << p.first
+                  << " size per sec: " << p.second / 1024 << "mb" << std::endl;
+    }
+}
+
+// 线程标识的开销：取线程ID（构造 logMessage 时）以及 %t、%t{name} 的格式化，和原来通过流输出 std::thread::id 对比
+void make_thread_bench() {
+    size_t count = 5000000;
+    ffengc_log::logStream out;
+    auto run = [&](const std::string& name, const std::function<void()>& fn) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            out.clear();
+            fn();
+        }
+        std::chrono::duration<double> cost = std::chrono::high_resolution_clock::now() - start;
+        std::cout << name << " ns per call: " << cost.count() * 1e9 / count << std::endl;
+    };
+    ffengc_log::logMessage msg(ffengc_log::logLevel::value::INFO, __LINE__, __FILE__, "thread_bench", "A");
+    ffengc_log::threadIdFormatItem tid, tid_name("name");
+    run("ostream_thread_id", [&]() {
+        std::ostringstream ss;
+        ss << std::this_thread::get_id();
+        out.append(ss.str());
+    });
+    run("cached_tid", [&]() { out.appendUnsigned((unsigned)ffengc_log::util::Thread::id()); });
+    run("format_%t", [&]() { tid.format(out, msg); });
+    run("format_%t{name}_unnamed", [&]() { tid_name.format(out, msg); });
+    std::thread([&]() {
+        ffengc_log::util::Thread::setName("bench-worker");
+        ffengc_log::logMessage named(ffengc_log::logLevel::value::INFO, __LINE__, __FILE__, "thread_bench", "A");
+        run("format_%t{name}", [&]() { tid_name.format(out, named); });
+    }).join();
+}
+
+// 对比生产者格式化的异步日志器和延迟格式化的二进制日志器
+void make_binary_bench() {
+    std::vector<std::pair<std::string, ffengc_log::loggerType>> modes = {
+        { "text_async", ffengc_log::loggerType::LOGGER_ASYNC },
+        { "binary_async", ffengc_log::loggerType::LOGGER_BINARY },
+    };
+    for (const auto& mode : modes) {
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::globalLoggerBuilder());
+        builder->buildLoggerLevel(ffengc_log::logLevel::value::WARNING);
+        builder->buildLoggerName(mode.first);
+        builder->buildLoggerType(mode.second);
+        builder->buildEnableLockFreeLoop();
+        builder->buildFormatter("[%d{%H:%M:%S.%6N}][%p] %m%n");
+        builder->buildSink<ffengc_log::fileSink>("./logfile/" + mode.first + ".log");
+        builder->build();
+        auto p = bench(mode.first, 4, 2000000, 100);
+        std::cout << mode.first << " message per sec: " << p.first
+                  << " size per sec: " << p.second / 1024 << "mb" << std::endl;
+    }
+}
+
+// 对比经过 ofstream 的 fileSink 和直接 writev/io_uring 的 directFileSink
+// 计时包含日志器析构，也就是所有数据都交给内核之后
+void make_sink_bench() {
+    std::vector<std::pair<std::string, ffengc_log::logSink::ptr>> sinks = {
+        { "file_sink", ffengc_log::sinkFactory::create<ffengc_log::fileSink>("./logfile/file_sink.log") },
+        { "direct_writev", ffengc_log::sinkFactory::create<ffengc_log::directFileSink>("./logfile/direct_writev.log") },
+        { "direct_uring", ffengc_log::sinkFactory::create<ffengc_log::directFileSink>("./logfile/direct_uring.log", ffengc_log::directIoType::DIRECT_IO_URING) },
+    };
+    size_t msg_count = 2000000, msg_len = 100;
+    std::string msg(msg_len - 1, 'A');
+    for (const auto& e : sinks) {
+        auto start = std::chrono::high_resolution_clock::now();
+        {
+            ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%m%n"));
+            ffengc_log::asyncLogger obj(e.first, ffengc_log::logLevel::value::DEBUG, fmt, { e.second }, ffengc_log::asyncType::ASYNC_UNSAFE);
+            for (size_t i = 0; i < msg_count; ++i)
+                obj.fatal("%s", msg.c_str()); // log.h 的宏已经加上了文件名和行号
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> cost = end - start;
+        std::cout << e.first << " message per sec: " << msg_count / cost.count()
+                  << " size per sec: " << (msg_count * msg_len) / (cost.count() * 1024 * 1024) << "mb" << std::endl;
+    }
+}
+
+// 滚动文件和压缩滚动文件的对比，输出写入速度、压缩比和后台压缩的速度
+void make_compress_bench() {
+    size_t msg_count = 2000000, roll_size = 16 * 1024 * 1024;
+    ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("[%d{%Y-%m-%d %H:%M:%S}][%t][%c][%f:%l][%p]%T%m%n"));
+    for (bool compress : { false, true }) {
+        std::string name = compress ? "gzip_roll_sink" : "roll_sink";
+        ffengc_log::logSink::ptr sink;
+        if (compress)
+            sink = ffengc_log::sinkFactory::create<ffengc_log::gzipRollSink>("./logfile/" + name + "-", roll_size);
+        else
+            sink = ffengc_log::sinkFactory::create<ffengc_log::rollSink>("./logfile/" + name + "-", roll_size);
+        auto start = std::chrono::high_resolution_clock::now();
+        {
+            ffengc_log::asyncLogger obj(name, ffengc_log::logLevel::value::DEBUG, fmt, { sink }, ffengc_log::asyncType::ASYNC_UNSAFE);
+            for (size_t i = 0; i < msg_count; ++i)
+                obj.info("user %zu login from 10.0.%zu.%zu, cost %zu us", i % 1000, i % 256, i % 100, i % 5000);
+        }
+        std::chrono::duration<double> cost = std::chrono::high_resolution_clock::now() - start;
+        std::cout << name << " message per sec: " << msg_count / cost.count();
+        if (compress) {
+            ffengc_log::gzipRollSink* gz = (ffengc_log::gzipRollSink*)sink.get();
+            gz->waitCompressed();
+            ffengc_log::compressStats stats = gz->stats();
+            std::cout << " compressed files: " << stats.__files << " ratio: " << stats.ratio()
+                      << " compress speed: " << stats.__raw_bytes / (stats.__seconds * 1024 * 1024) << "mb/s";
+        }
+        std::cout << std::endl;
+    }
+}
+
+// 不同刷新策略的吞吐量，以及平均每次刷新之间积压的数据量和时间（进程崩溃时最多丢失这么多）
+void make_flush_bench() {
+    struct policyCase {
+        std::string name;
+        ffengc_log::flushPolicy policy;
+    };
+    std::vector<policyCase> cases(7);
+    cases[0].name = "no_flush";
+    cases[1].name = "flush_on_error";
+    cases[1].policy.__level = ffengc_log::logLevel::value::ERROR;
+    cases[2].name = "flush_every_64kb";
+    cases[2].policy.__bytes = 64 * 1024;
+    cases[3].name = "flush_every_10ms";
+    cases[3].policy.__interval_ms = 10;
+    cases[4].name = "fdatasync_every_10ms";
+    cases[4].policy.__interval_ms = 10;
+    cases[4].policy.__sync = true;
+    cases[5].name = "flush_every_batch";
+    cases[5].policy.__level = ffengc_log::logLevel::value::DEBUG;
+    cases[6].name = "fdatasync_every_batch";
+    cases[6].policy.__level = ffengc_log::logLevel::value::DEBUG;
+    cases[6].policy.__sync = true;
+    size_t msg_count = 500000, msg_len = 100;
+    std::string msg(msg_len - 1, 'A');
+    for (const auto& e : cases) {
+        ffengc_log::logSink::ptr sink = ffengc_log::sinkFactory::create<ffengc_log::fileSink>("./logfile/" + e.name + ".log");
+        sink->setFlushPolicy(e.policy);
+        auto start = std::chrono::high_resolution_clock::now();
+        {
+            ffengc_log::formatter::ptr fmt(new ffengc_log::formatter("%m%n"));
+            ffengc_log::asyncLogger obj(e.name, ffengc_log::logLevel::value::DEBUG, fmt, { sink }, ffengc_log::asyncType::ASYNC_SAFE);
+            for (size_t i = 0; i < msg_count; ++i) {
+                if (i % 100 == 0)
+                    obj.error("%s", msg.c_str()); // 1% 的日志是 ERROR
+                else
+                    obj.info("%s", msg.c_str());
+            }
+        }
+        std::chrono::duration<double> cost = std::chrono::high_resolution_clock::now() - start;
+        ffengc_log::sinkMetrics m = sink->metrics();
+        std::cout << e.name << " message per sec: " << msg_count / cost.count() << " flushes: " << m.__flushes << " syncs: " << m.__syncs;
+        if (m.__flushes > 0)
+            std::cout << " kb per flush: " << m.__bytes / (m.__flushes * 1024.0) << " ms per flush: " << cost.count() * 1000 / m.__flushes;
+        std::cout << std::endl;
+    }
+}
+
+// socketSink 发送 UDP 数据报：每批一次 sendmmsg 和每条一次系统调用的对比
+// 本地接收方不读，内核直接丢弃收不下的包，UDP 的发送方感觉不到，测的只是发送本身的开销
+void make_socket_bench() {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    socklen_t addr_len = sizeof(addr);
+    getsockname(fd, (struct sockaddr*)&addr, &addr_len);
+    std::string address = "127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+    size_t msg_count = 1000000, batch = 64;
+    std::string msg(99, 'A');
+    msg.push_back('\n');
+    std::vector<ffengc_log::recordView> records(batch, { msg.data(), msg.size(), ffengc_log::logLevel::value::INFO, ffengc_log::util::Date::nowNs() });
+    for (auto framing : { ffengc_log::socketFraming::RAW, ffengc_log::socketFraming::RFC5424 }) {
+        for (bool batched : { false, true }) {
+            ffengc_log::socketConfig config;
+            config.__framing = framing;
+            ffengc_log::socketSink sink(ffengc_log::socketType::UDP, address, config);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < msg_count; i += batch) {
+                if (batched)
+                    sink.logRecords(records.data(), batch);
+                else
+                    for (size_t j = 0; j < batch; ++j)
+                        sink.logRecords(&records[j], 1);
+            }
+            std::chrono::duration<double> cost = std::chrono::high_resolution_clock::now() - start;
+            ffengc_log::socketStats stats = sink.stats();
+            std::cout << (framing == ffengc_log::socketFraming::RAW ? "raw" : "rfc5424") << (batched ? "_sendmmsg" : "_per_record")
+                      << " message per sec: " << msg_count / cost.count() << " sent: " << stats.__sent_records << " dropped: " << stats.__dropped_records << std::endl;
+        }
+    }
+    close(fd);
+}
+
+// 大量异步日志器：每个日志器独占异步线程和共用线程池的对比，线程数、缓冲区内存和吞吐
+static size_t threadCount() {
+    size_t cnt = 0;
+    DIR* dir = opendir("/proc/self/task");
+    if (dir == nullptr)
+        return 0;
+    while (struct dirent* e = readdir(dir))
+        if (e->d_name[0] != '.')
+            cnt++;
+    closedir(dir);
+    return cnt;
+}
+void make_pool_bench() {
+    size_t logger_count = 64, thr_count = 4, msg_count = 1000000;
+    std::string msg(99, 'A');
+    for (bool shared : { false, true }) {
+        ffengc_log::looperPool::ptr pool;
+        if (shared)
+            pool = std::make_shared<ffengc_log::looperPool>();
+        size_t threads_before = threadCount();
+        std::vector<ffengc_log::logger::ptr> loggers;
+        for (size_t i = 0; i < logger_count; ++i) {
+            std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+            builder->buildLoggerName("pool_bench_" + std::to_string(i));
+            builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+            builder->buildFormatter("%m%n");
+            builder->buildSink<ffengc_log::fileSink>("/dev/null");
+            if (shared)
+                builder->buildSharedWorkers(pool);
+            loggers.push_back(builder->build());
+        }
+        size_t threads = threadCount() - threads_before;
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> producers;
+        for (size_t t = 0; t < thr_count; ++t) {
+            producers.emplace_back([&, t]() {
+                for (size_t i = t; i < msg_count; i += thr_count)
+                    loggers[i % logger_count]->info(__FILE__, __LINE__, "%s", msg.c_str());
+            });
+        }
+        for (auto& e : producers)
+            e.join();
+        size_t allocated = 0;
+        for (auto& e : loggers)
+            allocated += e->metrics().__looper.__allocated_bytes;
+        loggers.clear(); // 析构时落地剩余的数据
+        std::chrono::duration<double> cost = std::chrono::high_resolution_clock::now() - start;
+        std::cout << (shared ? "shared_pool" : "dedicated") << " loggers: " << logger_count << " threads: " << threads
+                  << " buffer bytes: " << allocated / 1024 << "kb"
+                  << " message per sec: " << msg_count / cost.count() << std::endl;
+    }
+}
+
+// NUMA：异步线程固定在0号节点，生产者分别在同一节点和另一个节点上时的吞吐（无锁模式，开启节点本地缓冲区）
+void make_numa_bench() {
+    std::vector<int> producer_nodes = { 0 };
+    int far_node = ffengc_log::util::Numa::nodeCount() - 1;
+    if (far_node > 0)
+        producer_nodes.push_back(far_node);
+    else
+        std::cout << "numa_bench: only one NUMA node, cross-socket run skipped" << std::endl;
+    size_t thr_count = 4, msg_count = 2000000;
+    std::string msg(99, 'A');
+    for (int producer_node : producer_nodes) {
+        std::vector<int> cpus = ffengc_log::util::Numa::cpusOfNode(producer_node);
+        if (cpus.empty())
+            continue; // 没有CPU的内存节点
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+        builder->buildLoggerName("numa_bench");
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+        builder->buildEnableLockFreeLoop();
+        builder->buildFormatter("%m%n");
+        builder->buildWorkerNode(0);
+        builder->buildNodeLocalBuffers();
+        builder->buildSink<ffengc_log::fileSink>("/dev/null");
+        ffengc_log::logger::ptr obj = builder->build();
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> producers;
+        for (size_t t = 0; t < thr_count; ++t) {
+            producers.emplace_back([&]() {
+                ffengc_log::util::Numa::setAffinity(pthread_self(), cpus);
+                for (size_t i = 0; i < msg_count / thr_count; ++i)
+                    obj->info(__FILE__, __LINE__, "%s", msg.c_str());
+            });
+        }
+        for (auto& e : producers)
+            e.join();
+        obj.reset(); // 析构时落地剩余的数据
+        std::chrono::duration<double> cost = std::chrono::high_resolution_clock::now() - start;
+        std::cout << "numa_lockfree" << (producer_node == 0 ? " same-socket" : " cross-socket")
+                  << " message per sec: " << msg_count / cost.count() << std::endl;
+    }
+}
+
+// 结构化格式化器和 %m%n 的对比：只测格式化本身（单线程，不落地），以及转义时向量化查找和逐字节查找的速度
+void make_structured_bench() {
+    size_t count = 2000000;
+    std::string plain(99, 'A'), quoted = "user \"bob\" said: " + std::string(80, 'A');
+    std::vector<std::pair<std::string, ffengc_log::formatter::ptr>> formatters = {
+        { "pattern_%m%n", std::make_shared<ffengc_log::formatter>("%m%n") },
+        { "pattern_full", std::make_shared<ffengc_log::formatter>("[%d{%Y-%m-%d %H:%M:%S}][%t][%c][%f:%l][%p] %m%k%n") },
+        { "json", std::make_shared<ffengc_log::jsonFormatter>() },
+        { "logfmt", std::make_shared<ffengc_log::logfmtFormatter>() },
+    };
+    ffengc_log::logField fields[] = { { "user", 42 }, { "ip", "10.0.0.1" }, { "cost_ms", 1.5 } };
+    ffengc_log::logStream out;
+    for (const auto& e : formatters) {
+        for (bool with_fields : { false, true }) {
+            ffengc_log::logMessage msg(ffengc_log::logLevel::value::INFO, __LINE__, __FILE__, "structured_bench", plain);
+            if (with_fields) {
+                msg.__fields = fields;
+                msg.__field_cnt = sizeof(fields) / sizeof(fields[0]);
+            }
+            size_t bytes = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < count; ++i) {
+                out.clear();
+                e.second->format(out, msg);
+                bytes += out.size();
+            }
+            std::chrono::duration<double> cost = std::chrono::high_resolution_clock::now() - start;
+            std::cout << e.first << (with_fields ? " with 3 fields" : "") << " ns per record: " << cost.count() * 1e9 / count
+                      << " bytes per record: " << bytes / count << std::endl;
+        }
+    }
+    for (const std::string* str : { &plain, &quoted }) {
+        const char* end = str->data() + str->size();
+        size_t found = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < count; ++i)
+            found += ffengc_log::structured::findEscapeScalar(str->data() + i % 2, end) - str->data();
+        std::chrono::duration<double> scalar = std::chrono::high_resolution_clock::now() - start;
+        start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < count; ++i)
+            found += ffengc_log::structured::findEscape(str->data() + i % 2, end) - str->data();
+        std::chrono::duration<double> simd = std::chrono::high_resolution_clock::now() - start;
+        std::cout << (str == &plain ? "escape scan 99 bytes, nothing to escape" : "escape scan, quote at byte 5")
+                  << " scalar ns: " << scalar.count() * 1e9 / count << " simd ns: " << simd.count() * 1e9 / count
+                  << (found ? "" : " ") << std::endl;
+    }
+}
+
+class nullSink : public ffengc_log::logSink {
+public:
+    void log(const char* /*data*/, size_t /*len*/) { }
+};
+
+// 原来的查找方式：每次查找都加同一把锁并计算字符串的哈希值
+class mutexRegistry {
+private:
+    std::mutex __mtx;
+    std::unordered_map<std::string, ffengc_log::logger::ptr> __loggers; //
+public:
+    void add(const ffengc_log::logger::ptr& obj) {
+        std::unique_lock<std::mutex> lock(__mtx);
+        __loggers.insert({ obj->name(), obj });
+    }
+    ffengc_log::logger::ptr get(const std::string& name) {
+        std::unique_lock<std::mutex> lock(__mtx);
+        return __loggers.find(name)->second;
+    }
+};
+
+// 多个线程按名字向不同的日志器写日志，对比加锁查找、无锁快照查找和调用点缓存
+// 日志器等级设为 OFF，测到的只有查找的开销
+void make_lookup_bench() {
+    const size_t logger_count = 8, msg_per_thread = 1000000;
+    mutexRegistry registry;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < logger_count; ++i) {
+        names.push_back("lookup_" + std::to_string(i));
+        std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::globalLoggerBuilder());
+        builder->buildLoggerLevel(ffengc_log::logLevel::value::OFF);
+        builder->buildLoggerName(names.back());
+        builder->buildSink<nullSink>();
+        registry.add(builder->build());
+    }
+    std::vector<std::pair<std::string, std::function<void(const std::string&)>>> modes = {
+        { "mutex_lookup", [&](const std::string& name) { registry.get(name)->fatal("%d", 1); } },
+        { "snapshot_lookup", [](const std::string& name) { ffengc_log::getLogger(name)->fatal("%d", 1); } },
+        { "call_site_cache", [](const std::string& name) { LOG_FATAL(name, "%d", 1) } },
+    };
+    for (const auto& mode : modes) {
+        for (size_t thr_count : { 1, 4, 16 }) {
+            std::vector<std::thread> threads;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < thr_count; ++i) {
+                threads.emplace_back([&, i]() {
+                    const std::string& name = names[i % logger_count];
+                    for (size_t j = 0; j < msg_per_thread; ++j)
+                        mode.second(name);
+                });
+            }
+            for (auto& e : threads)
+                e.join();
+            std::chrono::duration<double> cost = std::chrono::high_resolution_clock::now() - start;
+            std::cout << mode.first << " threads: " << thr_count
+                      << " lookup per sec: " << thr_count * msg_per_thread / cost.count() << std::endl;
+        }
+    }
+}
+
+// 以被过滤掉的等级写日志：宏先检查等级，参数不会被计算
+void make_filtered_bench() {
+    std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::globalLoggerBuilder());
+    builder->buildLoggerLevel(ffengc_log::logLevel::value::WARNING);
+    builder->buildLoggerName("filtered_bench");
+    builder->buildSink<nullSink>();
+    ffengc_log::logger::ptr obj = builder->build();
+    const size_t count = 100000000;
+    std::string msg(100, 'A');
+    auto expensive = [&]() { return std::string(msg).size(); }; // 被过滤时不应该被调用
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < count; ++i)
+        LOG_DEBUG("filtered_bench", "%zu", expensive());
+    std::chrono::duration<double> macro_cost = std::chrono::high_resolution_clock::now() - start;
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < count / 10; ++i)
+        obj->debug("%zu", expensive()); // 直接调用成员函数，参数总是会被计算
+    std::chrono::duration<double> call_cost = std::chrono::high_resolution_clock::now() - start;
+    // 被调用点限流的日志：通过了等级检查，由限流器丢弃，同样不计算参数
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < count / 10; ++i)
+        LOG_WARNING_LIMIT("filtered_bench", ffengc_log::limitEveryN(1, 0), "%zu", expensive());
+    std::chrono::duration<double> limit_cost = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "filtered LOG_DEBUG ns per call: " << macro_cost.count() * 1e9 / count
+              << " filtered member call ns per call: " << call_cost.count() * 1e9 / (count / 10)
+              << " suppressed LOG_WARNING_LIMIT ns per call: " << limit_cost.count() * 1e9 / (count / 10) << std::endl;
+}
+
 int main() {
     make_bench();
+    make_scaling_bench();
+    make_time_bench();
+    make_thread_bench();
+    make_binary_bench();
+    make_sink_bench();
+    make_compress_bench();
+    make_flush_bench();
+    make_socket_bench();
+    make_pool_bench();
+    make_numa_bench();
+    make_structured_bench();
+    make_lookup_bench();
+    make_filtered_bench();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,267 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+// 单次调用延迟的基准测试
+// 对每种 日志器 x 落地方向 x 线程数 x 日志长度 x 格式 的组合，记录每一次调用的耗时，输出 p50/p99/p99.9/max
+// 结果可以同时写成 CSV 和 JSON，方便和历史结果对比
+// usage: ./latency.out [--count N] [--threads 1,4] [--sizes 32,256] [--loggers sync,async] [--sinks null,file] [--csv out.csv] [--json out.json]
+
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
+#define LATENCY_DIR "./logfile/latency/"
+#define LATENCY_BUCKETS 40 // 以2的幂划分的延迟区间，最后一个区间包含所有更大的值
+
+class nullSink : public ffengc_log::logSink {
+public:
+    void log(const char* /*data*/, size_t /*len*/) { }
+};
+
+struct benchCase {
+    std::string __logger; // sync / async / lazy / lockfree / binary
+    std::string __sink; // null / file / direct / mmap
+    std::string __pattern_name;
+    std::string __pattern;
+    size_t __threads;
+    size_t __msg_len;
+};
+
+struct benchResult {
+    benchCase __case;
+    size_t __samples;
+    double __mean_ns;
+    uint64_t __p50_ns;
+    uint64_t __p99_ns;
+    uint64_t __p999_ns;
+    uint64_t __max_ns;
+    double __msg_per_sec; // 所有线程写完所用的时间计算
+    double __drain_ms; // 日志器析构（所有数据落地）用的时间
+    std::vector<size_t> __histogram;
+};
+
+static std::vector<std::string> split(const std::string& str) {
+    std::vector<std::string> items;
+    std::stringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+static void cleanDir(const std::string& dir) {
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr)
+        return;
+    while (struct dirent* e = readdir(d))
+        if (e->d_name[0] != '.')
+            remove((dir + e->d_name).c_str());
+    closedir(d);
+}
+
+static ffengc_log::logSink::ptr makeSink(const std::string& kind) {
+    if (kind == "file")
+        return ffengc_log::sinkFactory::create<ffengc_log::fileSink>(LATENCY_DIR "file.log");
+    if (kind == "direct")
+        return ffengc_log::sinkFactory::create<ffengc_log::directFileSink>(LATENCY_DIR "direct.log");
+    if (kind == "mmap")
+        return ffengc_log::sinkFactory::create<ffengc_log::mmapRollSink>(LATENCY_DIR "mmap-", 64 * 1024 * 1024);
+    return ffengc_log::sinkFactory::create<nullSink>();
+}
+
+static ffengc_log::logger::ptr makeLogger(const benchCase& c) {
+    std::unique_ptr<ffengc_log::loggerBuilder> builder(new ffengc_log::localLoggerBuilder());
+    builder->buildLoggerName("latency_" + c.__logger);
+    builder->buildLoggerLevel(ffengc_log::logLevel::value::DEBUG);
+    builder->buildFormatter(c.__pattern);
+    if (c.__logger == "sync")
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_SYNC);
+    else if (c.__logger == "binary")
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_BINARY);
+    else
+        builder->buildLoggerType(ffengc_log::loggerType::LOGGER_ASYNC);
+    if (c.__logger == "lockfree" || c.__logger == "binary")
+        builder->buildEnableLockFreeLoop();
+    if (c.__logger == "lazy")
+        builder->buildEnableLazyFormat(); // 格式化在异步线程中完成
+    builder->buildSink(makeSink(c.__sink));
+    return builder->build();
+}
+
+static size_t bucketOf(uint64_t ns) {
+    size_t idx = 0;
+    while (ns > 1 && idx < LATENCY_BUCKETS - 1) {
+        ns >>= 1;
+        ++idx;
+    }
+    return idx;
+} // [2^idx, 2^(idx+1)) 纳秒
+
+static benchResult runCase(const benchCase& c, size_t msg_count) {
+    assert(c.__msg_len > 0 && c.__threads > 0 && msg_count >= c.__threads); // main 中已经检查过参数
+    cleanDir(LATENCY_DIR);
+    ffengc_log::util::File::createDirectory(LATENCY_DIR);
+    std::string msg(c.__msg_len - 1, 'A');
+    size_t msg_per_thread = msg_count / c.__threads;
+    size_t warmup = std::min<size_t>(msg_per_thread / 10, 1000); // 不计入统计
+    std::vector<std::vector<uint64_t>> samples(c.__threads);
+    std::chrono::duration<double> produce, drain;
+    {
+        ffengc_log::logger::ptr obj = makeLogger(c);
+        std::vector<std::thread> threads;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < c.__threads; ++i) {
+            threads.emplace_back([&, i]() {
+                std::vector<uint64_t>& lat = samples[i];
+                lat.reserve(msg_per_thread);
+                for (size_t j = 0; j < warmup + msg_per_thread; ++j) {
+                    auto t0 = std::chrono::steady_clock::now();
+                    obj->fatal("%s", msg.c_str());
+                    auto t1 = std::chrono::steady_clock::now();
+                    if (j >= warmup)
+                        lat.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+                }
+            });
+        }
+        for (auto& e : threads)
+            e.join();
+        auto end = std::chrono::steady_clock::now();
+        produce = end - start;
+        obj.reset(); // 析构时等待异步线程把数据全部落地
+        drain = std::chrono::steady_clock::now() - end;
+    }
+    // 合并所有线程的样本
+    std::vector<uint64_t> all;
+    for (auto& e : samples)
+        all.insert(all.end(), e.begin(), e.end());
+    std::sort(all.begin(), all.end());
+    benchResult r;
+    r.__case = c;
+    r.__samples = all.size();
+    auto at = [&](double q) { return all[std::min(all.size() - 1, (size_t)(q * all.size()))]; };
+    r.__mean_ns = std::accumulate(all.begin(), all.end(), 0.0) / all.size();
+    r.__p50_ns = at(0.5);
+    r.__p99_ns = at(0.99);
+    r.__p999_ns = at(0.999);
+    r.__max_ns = all.back();
+    r.__msg_per_sec = (c.__threads * (warmup + msg_per_thread)) / produce.count();
+    r.__drain_ms = drain.count() * 1000;
+    r.__histogram.assign(LATENCY_BUCKETS, 0);
+    for (auto e : all)
+        r.__histogram[bucketOf(e)]++;
+    cleanDir(LATENCY_DIR);
+    return r;
+}
+
+static void writeCsv(const std::string& path, const std::vector<benchResult>& results) {
+    std::ofstream ofs(path);
+    ofs << "logger,sink,pattern,threads,msg_len,samples,mean_ns,p50_ns,p99_ns,p999_ns,max_ns,msg_per_sec,drain_ms\n";
+    for (const auto& r : results) {
+        const benchCase& c = r.__case;
+        ofs << c.__logger << ',' << c.__sink << ',' << c.__pattern_name << ',' << c.__threads << ',' << c.__msg_len << ','
+            << r.__samples << ',' << r.__mean_ns << ',' << r.__p50_ns << ',' << r.__p99_ns << ',' << r.__p999_ns << ','
+            << r.__max_ns << ',' << r.__msg_per_sec << ',' << r.__drain_ms << '\n';
+    }
+}
+
+static void writeJson(const std::string& path, const std::vector<benchResult>& results) {
+    std::ofstream ofs(path);
+    ofs << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const benchResult& r = results[i];
+        const benchCase& c = r.__case;
+        ofs << "  {\"logger\": \"" << c.__logger << "\", \"sink\": \"" << c.__sink << "\", \"pattern\": \"" << c.__pattern_name
+            << "\", \"threads\": " << c.__threads << ", \"msg_len\": " << c.__msg_len
+            << ", \"samples\": " << r.__samples << ", \"mean_ns\": " << r.__mean_ns
+            << ", \"p50_ns\": " << r.__p50_ns << ", \"p99_ns\": " << r.__p99_ns << ", \"p999_ns\": " << r.__p999_ns
+            << ", \"max_ns\": " << r.__max_ns << ", \"msg_per_sec\": " << r.__msg_per_sec << ", \"drain_ms\": " << r.__drain_ms
+            << ", \"histogram_log2_ns\": [";
+        size_t last = r.__histogram.size();
+        while (last > 0 && r.__histogram[last - 1] == 0)
+            --last; // 省略末尾的空区间
+        for (size_t j = 0; j < last; ++j)
+            ofs << (j ? ", " : "") << r.__histogram[j];
+        ofs << "]}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    ofs << "]\n";
+}
+
+int main(int argc, char* argv[]) {
+    size_t msg_count = 200000;
+    std::vector<std::string> loggers = { "sync", "async", "lazy", "lockfree", "binary" };
+    std::vector<std::string> sinks = { "null", "file", "direct", "mmap" };
+    std::vector<size_t> threads = { 1, 4 };
+    std::vector<size_t> sizes = { 32, 256 };
+    std::vector<std::pair<std::string, std::string>> patterns = {
+        { "simple", "%m%n" },
+        { "full", "[%d{%Y-%m-%d %H:%M:%S.%6N}][%t][%c][%f:%l][%p]%T%m%n" },
+    };
+    std::string csv_path, json_path;
+    for (int i = 1; i < argc; i += 2) {
+        std::string key = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "missing value for option: " << key << std::endl;
+            return 1;
+        }
+        std::string value = argv[i + 1];
+        if (key == "--count")
+            msg_count = std::stoul(value);
+        else if (key == "--loggers")
+            loggers = split(value);
+        else if (key == "--sinks")
+            sinks = split(value);
+        else if (key == "--threads" || key == "--sizes") {
+            std::vector<size_t>& out = key == "--threads" ? threads : sizes;
+            out.clear();
+            for (const auto& e : split(value))
+                out.push_back(std::stoul(e));
+        } else if (key == "--csv")
+            csv_path = value;
+        else if (key == "--json")
+            json_path = value;
+        else {
+            std::cerr << "unknown option: " << key << std::endl;
+            return 1;
+        }
+    }
+    // 每条日志至少有换行符，每个线程至少要写一条，否则没有样本可以统计
+    for (size_t e : sizes) {
+        if (e == 0) {
+            std::cerr << "--sizes: message length must be at least 1" << std::endl;
+            return 1;
+        }
+    }
+    for (size_t e : threads) {
+        if (e == 0 || msg_count < e) {
+            std::cerr << "--threads: need 1 <= threads <= --count (" << msg_count << "), got " << e << std::endl;
+            return 1;
+        }
+    }
+    std::vector<benchResult> results;
+    for (const auto& lg : loggers)
+        for (const auto& sk : sinks)
+            for (const auto& pt : patterns)
+                for (size_t thr : threads)
+                    for (size_t len : sizes) {
+                        benchCase c { lg, sk, pt.first, pt.second, thr, len };
+                        benchResult r = runCase(c, msg_count);
+                        std::cout << lg << " " << sk << " " << pt.first << " threads: " << thr << " len: " << len
+                                  << " p50: " << r.__p50_ns << "ns p99: " << r.__p99_ns << "ns p99.9: " << r.__p999_ns
+                                  << "ns max: " << r.__max_ns << "ns msg/s: " << (size_t)r.__msg_per_sec
+                                  << " drain: " << r.__drain_ms << "ms" << std::endl;
+                        results.push_back(r);
+                    }
+    if (!csv_path.empty())
+        writeCsv(csv_path, results);
+    if (!json_path.empty())
+        writeJson(json_path, results);
+    return 0;
+}
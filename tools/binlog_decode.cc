@@ -0,0 +1,45 @@
+/*
+ * Write by Yufc
+ * See https://github.com/ffengc/Multi-Pattern-Logging-System
+ * please cite my project link: https://github.com/ffengc/Multi-Pattern-Logging-System when you use this code
+ */
+
+// 把 LOGGER_BINARY 在 dump 模式下输出的二进制日志文件转换成文本
+// usage: ./binlog_decode <binary log file> [pattern]
+
+#include "internal/binary.hpp"
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <binary log file> [pattern]" << std::endl;
+        return 1;
+    }
+    std::ifstream ifs(argv[1], std::ios::binary);
+    if (ifs.is_open() == false) {
+        std::cerr << "open file failed: " << argv[1] << std::endl;
+        return 1;
+    }
+    ffengc_log::formatter fmt(argc > 2 ? argv[2] : "[%d{%H:%M:%S.%6N}][%t][%c][%f:%l][%p] %m%n");
+    ffengc_log::binary::decoder dec;
+    ffengc_log::logStream text;
+    std::string data; // 上一次没有解码完的数据 + 本次读到的数据
+    char block[64 * 1024];
+    while (ifs.read(block, sizeof(block)) || ifs.gcount() > 0) {
+        data.append(block, ifs.gcount());
+        text.clear();
+        size_t used = dec.decode(data.data(), data.size(), fmt, text);
+        if (used == (size_t)-1) {
+            std::cerr << "corrupted binary log file" << std::endl;
+            return 1;
+        }
+        std::cout.write(text.data(), text.size());
+        data.erase(0, used);
+    }
+    if (!data.empty()) {
+        std::cerr << "binary log file is truncated, " << data.size() << " bytes left" << std::endl;
+        return 1;
+    }
+    return 0;
+}